@@ -0,0 +1,291 @@
+/*
+Benchmark and regression harness for the primality kernels in functions.h.
+
+Times each modular multiplication kernel and probable prime test over fixed
+seed random inputs at several bit sizes (staying inside each kernel's limit)
+and reports ns/op. The multiplication kernels are timed as a dependent chain
+since that is how the exponentiation loops use them, so the number measured
+is latency, not throughput.
+
+Usage:
+    ./bench                 run and print results
+    ./bench save <file>     run and store the results as a baseline
+    ./bench check <file>    run and compare against a stored baseline,
+                            exits 1 if any kernel regressed more than
+                            TOLERANCE (helps catch accidental slowdowns
+                            without burning a production run)
+
+Baseline files are plain text, one "<name> <ns_per_op>" per line, so they
+can be diffed and kept per machine. Comparisons on a loaded machine can
+fluctuate a few percent, the tolerance is sized for that.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include "functions.h"
+
+// inputs per bit size, reused across kernels so runs are comparable
+#define NINPUTS 4096
+// dependent multiplication chain length per measurement
+#define MULT_OPS 50000000uL
+// probable prime tests per measurement
+#define TEST_OPS 200000uL
+// acceptable slowdown against the baseline before check mode fails
+#define TOLERANCE 1.25
+
+uint64_t _inputs[NINPUTS];
+uint64_t _moduli[NINPUTS];
+
+// results collected for reporting and baseline comparison
+typedef struct
+{
+    char name[48];
+    double ns;
+} RESULT;
+RESULT _results[64];
+uint32_t _nresults = 0;
+
+// xorshift64 with a fixed seed so every run times identical inputs
+uint64_t _rng = 0x9e3779b97f4a7c15uL;
+static inline uint64_t rng_next(void)
+{
+    _rng ^= _rng << 13;
+    _rng ^= _rng >> 7;
+    _rng ^= _rng << 17;
+    return _rng;
+}
+
+// fill the input arrays with numbers of exactly the given bit size
+// moduli are odd (the kernels and tests are used with odd moduli)
+void gen_inputs(uint32_t bits)
+{
+    uint64_t lo = POW2(bits-1);
+    uint64_t mask = BIT_MASK(bits-1);
+    for (uint32_t i = 0; i < NINPUTS; ++i)
+    {
+        _moduli[i] = (lo | (rng_next() & mask)) | 1;
+        _inputs[i] = rng_next() % _moduli[i];
+    }
+}
+
+double _t0;
+static inline void timer_start(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    _t0 = t.tv_sec*1e9 + t.tv_nsec;
+}
+
+static inline double timer_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return t.tv_sec*1e9 + t.tv_nsec - _t0;
+}
+
+// record and print one measurement
+void report(const char *name, uint32_t bits, uint64_t ops, double ns)
+{
+    RESULT *r = _results + _nresults++;
+    assert(_nresults <= sizeof(_results)/sizeof(*_results));
+    sprintf(r->name,"%s_%ub",name,bits);
+    r->ns = ns/ops;
+    printf("%-32s %10.2f ns/op\n",r->name,r->ns);
+}
+
+// sink so the compiler cannot drop the measured work
+volatile uint64_t _sink;
+
+// time a modular multiplication kernel as a dependent chain
+void bench_mod_mult(const char *name, uint32_t bits,
+    uint64_t (*mod_mult)(uint64_t,uint64_t,uint64_t))
+{
+    gen_inputs(bits);
+    uint64_t x = _inputs[0];
+    timer_start();
+    for (uint64_t i = 0; i < MULT_OPS; ++i)
+    {
+        uint32_t j = i & (NINPUTS-1);
+        x = mod_mult(x,_inputs[j],_moduli[j]);
+    }
+    double ns = timer_ns();
+    _sink = x;
+    report(name,bits,MULT_OPS,ns);
+}
+
+// time the Montgomery multiplication as a dependent chain
+// conversion constants are precomputed, matching the exponentiation loops
+void bench_mont63_mult(uint32_t bits)
+{
+    gen_inputs(bits);
+    MONT63 m[64];
+    for (uint32_t i = 0; i < 64; ++i)
+        mont63_init(m+i,_moduli[i]);
+    uint64_t x = _inputs[0];
+    timer_start();
+    for (uint64_t i = 0; i < MULT_OPS; ++i)
+    {
+        uint32_t j = i & 63;
+        x = mont63_mult(x,_inputs[j],m+j);
+    }
+    double ns = timer_ns();
+    _sink = x;
+    report("mont63_mult",bits,MULT_OPS,ns);
+}
+
+// time a probable prime test taking a mod_mult function pointer
+void bench_pp(const char *name, uint32_t bits,
+    bool (*test)(uint64_t,uint64_t,uint64_t(*)(uint64_t,uint64_t,uint64_t)),
+    uint64_t (*mod_mult)(uint64_t,uint64_t,uint64_t))
+{
+    gen_inputs(bits);
+    uint64_t count = 0;
+    timer_start();
+    for (uint64_t i = 0; i < TEST_OPS; ++i)
+        count += test(_moduli[i & (NINPUTS-1)],3,mod_mult);
+    double ns = timer_ns();
+    _sink = count;
+    report(name,bits,TEST_OPS,ns);
+}
+
+// time a Montgomery form probable prime test
+void bench_pp_mont(const char *name, uint32_t bits,
+    bool (*test)(uint64_t,uint64_t))
+{
+    gen_inputs(bits);
+    uint64_t count = 0;
+    timer_start();
+    for (uint64_t i = 0; i < TEST_OPS; ++i)
+        count += test(_moduli[i & (NINPUTS-1)],3);
+    double ns = timer_ns();
+    _sink = count;
+    report(name,bits,TEST_OPS,ns);
+}
+
+// time the deterministic 64 bit primality test
+void bench_is_prime64(uint32_t bits)
+{
+    gen_inputs(bits);
+    uint64_t count = 0;
+    timer_start();
+    for (uint64_t i = 0; i < TEST_OPS; ++i)
+        count += is_prime64(_moduli[i & (NINPUTS-1)]);
+    double ns = timer_ns();
+    _sink = count;
+    report("is_prime64",bits,TEST_OPS,ns);
+}
+
+void run_benchmarks(void)
+{
+    // multiplication kernels inside their modulus limits
+    bench_mod_mult("mod_mult32",30,mod_mult32);
+    bench_mod_mult("mod_mult42",30,mod_mult42);
+    bench_mod_mult("mod_mult42",40,mod_mult42);
+    bench_mod_mult("mod_mult63",40,mod_mult63);
+    bench_mod_mult("mod_mult63",50,mod_mult63);
+    bench_mod_mult("mod_mult63",62,mod_mult63);
+    bench_mont63_mult(50);
+    bench_mont63_mult(62);
+    // probable prime tests, the 42 bit kernel in its range and the
+    // Montgomery forms where pp.c switches to them
+    bench_pp("fermat_pp",40,fermat_pp,mod_mult42);
+    bench_pp("euler_jacobi_pp",40,euler_jacobi_pp,mod_mult42);
+    bench_pp("strong_fermat_pp",40,strong_fermat_pp,mod_mult42);
+    bench_pp_mont("fermat_pp_mont",50,fermat_pp_mont);
+    bench_pp_mont("fermat_pp_mont",62,fermat_pp_mont);
+    bench_pp_mont("euler_jacobi_pp_mont",50,euler_jacobi_pp_mont);
+    bench_pp_mont("strong_fermat_pp_mont",50,strong_fermat_pp_mont);
+    bench_pp_mont("strong_fermat_pp_mont",62,strong_fermat_pp_mont);
+    bench_is_prime64(50);
+    bench_is_prime64(62);
+}
+
+// write the collected results as a baseline file
+void save_baseline(const char *path)
+{
+    FILE *f = fopen(path,"w");
+    if (!f)
+    {
+        fprintf(stderr,"unable to write baseline file\n");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < _nresults; ++i)
+        fprintf(f,"%s %f\n",_results[i].name,_results[i].ns);
+    fclose(f);
+    printf("baseline saved to %s\n",path);
+}
+
+// compare against a stored baseline, returns false on regression
+bool check_baseline(const char *path)
+{
+    FILE *f = fopen(path,"r");
+    if (!f)
+    {
+        fprintf(stderr,"unable to open baseline file\n");
+        exit(1);
+    }
+    bool ok = true;
+    char name[48];
+    double base;
+    uint32_t checked = 0;
+    printf("\n%-32s %10s %10s %8s\n","kernel","base","now","delta");
+    while (fscanf(f,"%47s %lf",name,&base) == 2)
+    {
+        RESULT *r = NULL;
+        for (uint32_t i = 0; i < _nresults; ++i)
+            if (strcmp(_results[i].name,name) == 0)
+                r = _results + i;
+        if (!r)
+        {
+            printf("%-32s missing from this run\n",name);
+            ok = false;
+            continue;
+        }
+        ++checked;
+        double ratio = r->ns/base;
+        printf("%-32s %10.2f %10.2f %+7.1f%%%s\n",name,base,r->ns,
+            100.0*(ratio-1.0),ratio > TOLERANCE ? " REGRESSED" : "");
+        if (ratio > TOLERANCE)
+            ok = false;
+    }
+    fclose(f);
+    if (checked < _nresults)
+        printf("note: %u results have no baseline entry\n",
+            _nresults-checked);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 1 && argc != 3)
+    {
+        fprintf(stderr,"./bench [save|check <baseline_file>]\n");
+        return 0;
+    }
+    run_benchmarks();
+    if (argc == 3)
+    {
+        if (!strcmp("save",argv[1]))
+            save_baseline(argv[2]);
+        else if (!strcmp("check",argv[1]))
+        {
+            if (!check_baseline(argv[2]))
+            {
+                printf("REGRESSION against %s\n",argv[2]);
+                return 1;
+            }
+            printf("no regression against %s\n",argv[2]);
+        }
+        else
+        {
+            fprintf(stderr,"./bench [save|check <baseline_file>]\n");
+            return 0;
+        }
+    }
+    return 0;
+}
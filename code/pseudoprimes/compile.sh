@@ -1,6 +1,11 @@
 #!/bin/bash
-g++ -O3 -Wall -Werror pp.c -o pp
+g++ -O3 -Wall -Werror -pthread pp.c -o pp
 g++ -O3 -Wall -Werror sorted_diff.c -o sorted_diff
+g++ -O3 -Wall -Werror fpp_multi.c -o fpp_multi
+g++ -O3 -Wall -Werror -pthread pp_coord.c -o pp_coord
+g++ -O3 -Wall -Werror pp_worker.c -o pp_worker
+g++ -O3 -Wall -Werror pp_store.c -o pp_store
+g++ -O3 -Wall -Werror bench.c -o bench
 mkdir fpp_tmp
 parallel g++ -O3 -Wall -Werror fpp_tmp.cpp -o ./fpp_tmp/fpp_{} \
     -ftemplate-depth=1100 -DBASE={} ::: $(seq 2 1023)
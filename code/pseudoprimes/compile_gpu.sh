@@ -0,0 +1,4 @@
+#!/bin/bash
+# optional GPU build, needs the CUDA toolkit; the CPU tools build with
+# compile.sh and are unaffected
+nvcc -O3 -arch=native fpp_gpu.cu -o fpp_gpu
@@ -0,0 +1,289 @@
+/*
+    Fermat Probable Prime finder on the GPU. The workload is millions of
+    independent modular exponentiations with a tiny result payload, which is
+    exactly what a GPU is good at: one consumer card replaces a rack of CPU
+    nodes for the exhaustive per base catalog.
+
+    The host walks the range with the same segmented largest factor sieve as
+    pp.c, so most composites are rejected before they ever cross the PCIe
+    bus. Survivors are collected into large batches and tested on the device
+    with Montgomery exponentiation (a port of fermat_pp_mont from
+    functions.h using __umul64hi since device code has no __uint128_t).
+    Batches are flushed in range order and survivors printed in order at
+    flush time, so the output contract is identical to fpp_tmp: numbers in
+    base 10, 1 per line, increasing, then a line containing "done" (or raw
+    little endian uint64 values and a 0xffffffffffffffff sentinel with
+    --binary). find_pp.sh and sorted_diff work unchanged.
+
+    Unlike fpp_tmp the base is a runtime argument: the device does not need
+    compile time specialization to keep the exponentiation loop tight, so
+    one binary covers every base instead of 1022 per base builds.
+
+    Build with compile_gpu.sh (needs the CUDA toolkit); the CPU tools are
+    unaffected and still build with compile.sh.
+
+    TODO overlap sieving with device work using two buffers and a cudaStream
+    per buffer; the sieve is fast enough that this is not the bottleneck yet.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <cuda_runtime.h>
+#include "functions.h"
+
+// repo convention: runtime errors print to stderr and exit(1)
+#define CUDA_CHECK(call) \
+    do { cudaError_t _e = (call); if (_e != cudaSuccess) { \
+        fprintf(stderr,"cuda error: %s\n",cudaGetErrorString(_e)); \
+        exit(1); } } while (0)
+
+#define LIMIT (POW2(63)-1)
+
+#ifndef BATCH_SIZE
+#define BATCH_SIZE POW2(20) // candidates per device batch
+#endif
+#define THREADS_PER_BLOCK 256
+
+/*
+    Device Montgomery arithmetic, kept in sync with the MONT63 functions in
+    functions.h. The 128 bit products are formed from __umul64hi and the low
+    64 bit half; in REDC the low halves of t and k*n cancel to 0 mod 2^64 by
+    construction so only the carry out of their sum survives.
+*/
+
+__device__ static uint64_t dev_mont63_mult(uint64_t a, uint64_t b,
+    uint64_t n, uint64_t ninv)
+{
+    uint64_t tl = a*b;
+    uint64_t th = __umul64hi(a,b);
+    uint64_t k = tl*ninv;
+    uint64_t cl = k*n;
+    uint64_t ch = __umul64hi(k,n);
+    uint64_t lo = tl+cl;
+    uint64_t r = th+ch+(lo < tl);
+    return r < n ? r : r-n;
+}
+
+/*
+    Fermat probable prime test on the device, a port of fermat_pp_mont. The
+    conversion of b into Montgomery form is done by 64 modular doublings
+    (b*2^64 mod n) instead of precomputing R^2, which avoids needing a 128
+    bit remainder on the device.
+*/
+__device__ static bool dev_fermat_pp(uint64_t n, uint64_t b)
+{
+    uint64_t e = n-1;
+    if (!(n&1)) // split even n = 2^s * q like fermat_pp_mont
+    {
+        uint32_t s = 0;
+        while (!(n&1)) ++s, n >>= 1;
+        uint64_t mask = BIT_MASK(s);
+        uint64_t mb2 = b & mask, r2 = mb2; // e = original n-1 is odd
+        uint64_t e2 = e;
+        while (e2 >>= 1)
+        {
+            mb2 = (mb2*mb2) & mask;
+            if (e2&1) r2 = (r2*mb2) & mask;
+        }
+        if (r2 != 1) return false; // b^(n-1) != 1 (mod 2^s)
+        if (n == 1) return true; // original n was a power of 2
+    }
+    // newton iteration for -n^-1 (mod 2^64), see mont63_init
+    uint64_t x = n;
+    x *= 2 - n*x;
+    x *= 2 - n*x;
+    x *= 2 - n*x;
+    x *= 2 - n*x;
+    x *= 2 - n*x;
+    uint64_t ninv = -x;
+    uint64_t r1 = (UINT64_MAX % n) + 1; // 2^64 (mod n)
+    uint64_t mb = b % n;
+    for (uint32_t i = 0; i < 64; ++i) // mb = b * 2^64 (mod n), n < 2^63
+    {
+        mb += mb;
+        if (mb >= n) mb -= n;
+    }
+    uint64_t r = (e&1) ? mb : r1;
+    while (e >>= 1) // r = b^(n-1) in Montgomery form
+    {
+        mb = dev_mont63_mult(mb,mb,n,ninv);
+        if (e&1) r = dev_mont63_mult(r,mb,n,ninv);
+    }
+    return r == r1;
+}
+
+__global__ void fermat_kernel(const uint64_t *cand, uint8_t *pass,
+    uint32_t count, uint64_t base)
+{
+    uint32_t i = blockIdx.x*blockDim.x + threadIdx.x;
+    if (i < count)
+        pass[i] = dev_fermat_pp(cand[i],base);
+}
+
+/*
+    Prefilter stage, same as pp.c: a segmented largest factor sieve plus
+    fermat_small_factor_check on the host reject most composites cheaply so
+    the device batches are mostly primes and hard composites.
+*/
+#ifndef SIEVE_LIMIT
+#define SIEVE_LIMIT POW2(16) // sieve primes are below this
+#endif
+#ifndef SEG_SIZE
+#define SEG_SIZE POW2(15) // numbers per sieve segment
+#endif
+
+uint32_t *_sieve_primes;
+uint32_t _nsieve;
+uint16_t _spf[SEG_SIZE]; // index of the largest sieve prime factor, or 0xffff
+
+// simple sieve for the prefilter primes
+void sieve_init(void)
+{
+    bool *composite = (bool*)calloc(SIEVE_LIMIT,sizeof(*composite));
+    uint32_t i, j, count = 0;
+    for (i = 2; i < SIEVE_LIMIT; ++i)
+        if (!composite[i])
+        {
+            ++count;
+            for (j = i; (uint64_t)j*i < SIEVE_LIMIT; ++j)
+                composite[j*i] = true;
+        }
+    _sieve_primes = (uint32_t*)malloc(count*sizeof(*_sieve_primes));
+    _nsieve = 0;
+    for (i = 2; i < SIEVE_LIMIT; ++i)
+        if (!composite[i])
+            _sieve_primes[_nsieve++] = i;
+    free(composite);
+}
+
+// mark [lo,lo+len) with the largest sieve prime factor of each number
+void sieve_segment(uint64_t lo, uint64_t len)
+{
+    memset(_spf,0xff,sizeof(_spf));
+    uint32_t i;
+    for (i = 0; i < _nsieve; ++i)
+    {
+        uint64_t p = _sieve_primes[i];
+        uint64_t m = ((lo+p-1)/p)*p; // first multiple of p at or above lo
+        for (; m < lo+len; m += p)
+            _spf[m-lo] = i; // later primes overwrite, keeping the largest
+    }
+}
+
+/*
+    Output stage, same as pp.c: text by default, raw little endian uint64
+    values with --binary, block buffered.
+*/
+#define OUT_VALUES 8192
+bool _out_binary = false;
+uint64_t _out_buf[OUT_VALUES];
+uint32_t _out_len = 0;
+
+static inline void out_value(uint64_t n)
+{
+    if (!_out_binary)
+    {
+        printf("%lu\n",n);
+        return;
+    }
+    _out_buf[_out_len] = n;
+    if (++_out_len == OUT_VALUES)
+    {
+        fwrite(_out_buf,sizeof(uint64_t),_out_len,stdout);
+        _out_len = 0;
+    }
+}
+
+static inline void out_done(void)
+{
+    if (!_out_binary)
+    {
+        printf("done\n");
+        return;
+    }
+    _out_buf[_out_len++] = UINT64_MAX;
+    fwrite(_out_buf,sizeof(uint64_t),_out_len,stdout);
+    _out_len = 0;
+}
+
+// batch state, pinned host memory for fast transfers
+uint64_t *_batch_n; // host candidates
+uint8_t *_batch_pass; // host results
+uint64_t *_dev_n;
+uint8_t *_dev_pass;
+uint32_t _batch_count = 0;
+uint64_t _base;
+
+// run the batch on the device and print survivors, in order, before any
+// later candidate is collected so the output order is unchanged
+void batch_flush(void)
+{
+    uint32_t count = _batch_count;
+    _batch_count = 0;
+    if (!count)
+        return;
+    CUDA_CHECK(cudaMemcpy(_dev_n,_batch_n,count*sizeof(*_dev_n),
+        cudaMemcpyHostToDevice));
+    uint32_t blocks = (count+THREADS_PER_BLOCK-1)/THREADS_PER_BLOCK;
+    fermat_kernel<<<blocks,THREADS_PER_BLOCK>>>(_dev_n,_dev_pass,count,_base);
+    CUDA_CHECK(cudaGetLastError());
+    CUDA_CHECK(cudaMemcpy(_batch_pass,_dev_pass,count*sizeof(*_dev_pass),
+        cudaMemcpyDeviceToHost));
+    for (uint32_t i = 0; i < count; ++i)
+        if (_batch_pass[i])
+            out_value(_batch_n[i]);
+}
+
+static inline void batch_push(uint64_t n)
+{
+    _batch_n[_batch_count] = n;
+    if (++_batch_count == BATCH_SIZE)
+        batch_flush();
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        fprintf(stderr,"./a.out <min> <max> <base> [--binary]\n");
+        return 0;
+    }
+    _out_binary = argc > 4 && !strcmp(argv[4],"--binary");
+    uint64_t min = strtoul(argv[1],NULL,10);
+    uint64_t max = strtoul(argv[2],NULL,10);
+    _base = strtoul(argv[3],NULL,10);
+    if (min < 2 || min > max || max > LIMIT ||
+        _base < 2 || _base >= POW2(32))
+    {
+        fprintf(stderr,"need 2 <= min <= max < 2^63, 2 <= base < 2^32\n");
+        return 0;
+    }
+    sieve_init();
+    CUDA_CHECK(cudaMallocHost(&_batch_n,BATCH_SIZE*sizeof(*_batch_n)));
+    CUDA_CHECK(cudaMallocHost(&_batch_pass,BATCH_SIZE*sizeof(*_batch_pass)));
+    CUDA_CHECK(cudaMalloc(&_dev_n,BATCH_SIZE*sizeof(*_dev_n)));
+    CUDA_CHECK(cudaMalloc(&_dev_pass,BATCH_SIZE*sizeof(*_dev_pass)));
+    uint64_t lo, i;
+    for (lo = min; lo <= max; lo += SEG_SIZE)
+    {
+        uint64_t len = max-lo+1 < SEG_SIZE ? max-lo+1 : SEG_SIZE;
+        sieve_segment(lo,len);
+        for (i = 0; i < len; ++i)
+        {
+            uint64_t n = lo+i;
+            if (gcd32((uint32_t)_base,(uint32_t)(n%_base)) != 1)
+                continue; // not coprime to the base
+            if (_spf[i] != 0xffff &&
+                !fermat_small_factor_check(n,_base,_sieve_primes[_spf[i]]))
+                continue; // proven composite by the small factor
+            batch_push(n);
+        }
+    }
+    batch_flush();
+    out_done();
+    return 0;
+}
@@ -0,0 +1,291 @@
+/*
+
+Program to enumerate Fermat probable primes for a whole range of bases in a
+single pass over the numbers. Running the per base programs reads through the
+same range once per base, but almost all of the per candidate work (Montgomery
+setup for n, the exponent n-1, the even n splitting) is identical across
+bases, so one pass can share it.
+
+The key observation is that b^(n-1) (mod n) is multiplicative in b: factoring
+b into primes, b^(n-1) is the product of p^(n-1) over the prime factors. So
+for each n only the primes up to the largest base get a full exponentiation
+(about bhi/ln(bhi) of them instead of bhi-1 bases) and every composite base is
+combined from those residues with a few multiplications. Bases sharing a prime
+factor with n are skipped, matching the gcd check in pp.c.
+
+usage: ./fpp_multi <min> <max> <base_lo> <base_hi> <outdir>
+
+One output stream per base is written to <outdir>/fpp_<base> in the same
+format as the per base programs: probable primes in base 10, 1 per line, then
+a line containing "done". The directory must already exist.
+
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "functions.h"
+
+// number of interleaved exponentiation lanes, they share the modulus and the
+// exponent so this just hides multiply latency (see fpp_tmp.cpp)
+#define LANES 8
+
+uint32_t *_primes; // primes up to base_hi
+uint32_t _nprimes;
+bool *_pdiv; // per prime, does it divide the current n
+uint64_t *_rq; // per prime, p^(n-1) (mod q) in Montgomery form (n = 2^s * q)
+uint64_t *_r2; // per prime, p^(n-1) (mod 2^s)
+
+// factorization of each base as indexes into _primes with exponents
+// base b uses entries [_fstart[b-blo],_fstart[b-blo+1])
+uint32_t *_fstart;
+uint32_t *_fprime;
+uint32_t *_fexp;
+
+// sieve primes up to base_hi and factor all the bases
+void setup_bases(uint32_t blo, uint32_t bhi)
+{
+    bool *composite = (bool*)calloc(bhi+1,sizeof(*composite));
+    uint32_t i, j;
+    _nprimes = 0;
+    for (i = 2; i <= bhi; ++i)
+        if (!composite[i])
+        {
+            ++_nprimes;
+            for (j = i; (uint64_t)j*i <= bhi; ++j)
+                composite[j*i] = true;
+        }
+    _primes = (uint32_t*)malloc(_nprimes*sizeof(*_primes));
+    _nprimes = 0;
+    for (i = 2; i <= bhi; ++i)
+        if (!composite[i])
+            _primes[_nprimes++] = i;
+    free(composite);
+    _pdiv = (bool*)malloc(_nprimes*sizeof(*_pdiv));
+    _rq = (uint64_t*)malloc(_nprimes*sizeof(*_rq));
+    _r2 = (uint64_t*)malloc(_nprimes*sizeof(*_r2));
+    // factor the bases by trial division over the prime list
+    _fstart = (uint32_t*)malloc((bhi-blo+2)*sizeof(*_fstart));
+    uint32_t cap = 16*(bhi-blo+1), len = 0;
+    _fprime = (uint32_t*)malloc(cap*sizeof(*_fprime));
+    _fexp = (uint32_t*)malloc(cap*sizeof(*_fexp));
+    for (i = 0; i <= bhi-blo; ++i)
+    {
+        _fstart[i] = len;
+        uint32_t b = blo+i;
+        for (j = 0; _primes[j]*(uint64_t)_primes[j] <= b; ++j)
+            if (b % _primes[j] == 0)
+            {
+                _fprime[len] = j;
+                _fexp[len] = 0;
+                while (b % _primes[j] == 0)
+                    ++_fexp[len], b /= _primes[j];
+                ++len;
+            }
+        if (b > 1) // remaining prime factor, find its index
+        {
+            uint32_t lo = 0, hi = _nprimes;
+            while (lo+1 < hi) // binary search, b is prime so it is in the list
+            {
+                uint32_t mid = (lo+hi)/2;
+                if (_primes[mid] <= b) lo = mid;
+                else hi = mid;
+            }
+            _fprime[len] = lo;
+            _fexp[len] = 1;
+            ++len;
+        }
+    }
+    _fstart[bhi-blo+1] = len;
+}
+
+// exponentiations p^e for a group of primes sharing the modulus, results in
+// Montgomery form in _rq, the lanes advance together since e is shared
+static inline void run_lanes(const uint32_t *idx, uint32_t cnt, uint64_t e,
+    const MONT63 *m)
+{
+    uint64_t mb[LANES], r[LANES];
+    uint32_t i;
+    for (i = 0; i < cnt; ++i)
+    {
+        mb[i] = mont63_in(_primes[idx[i]] % m->n,m);
+        r[i] = (e&1) ? mb[i] : m->r1;
+    }
+    while (e >>= 1)
+    {
+        for (i = 0; i < cnt; ++i)
+            mb[i] = mont63_mult(mb[i],mb[i],m);
+        if (e&1)
+            for (i = 0; i < cnt; ++i)
+                r[i] = mont63_mult(r[i],mb[i],m);
+    }
+    for (i = 0; i < cnt; ++i)
+        _rq[idx[i]] = r[i];
+}
+
+// main loop, tests every n in [min,max] against every base in [blo,bhi]
+void loop(uint64_t min, uint64_t max, uint32_t blo, uint32_t bhi, FILE **files)
+{
+    uint64_t n;
+    uint32_t i, j, k;
+    for (n = min; n <= max; ++n)
+    {
+        // split even n = 2^s * q like fermat_pp_mont
+        uint32_t s = 0;
+        uint64_t q = n;
+        while (!(q&1)) ++s, q >>= 1;
+        uint64_t mask = BIT_MASK(s);
+        uint64_t e = n-1;
+        MONT63 m;
+        mont63_init(&m,q); // harmless when q == 1 (n a power of 2)
+        // per prime residues, skipping primes that divide n
+        uint32_t active[LANES], cnt = 0;
+        for (i = 0; i < _nprimes; ++i)
+        {
+            _pdiv[i] = (n % _primes[i] == 0);
+            if (_pdiv[i])
+                continue;
+            if (q > 1)
+            {
+                active[cnt++] = i;
+                if (cnt == LANES)
+                {
+                    run_lanes(active,cnt,e,&m);
+                    cnt = 0;
+                }
+            }
+            if (s) // p^(n-1) (mod 2^s), multiplication is just a mask
+            {
+                uint64_t mb = _primes[i] & mask, r = mb, e2 = e; // e is odd
+                while (e2 >>= 1)
+                {
+                    mb = (mb*mb) & mask;
+                    if (e2&1) r = (r*mb) & mask;
+                }
+                _r2[i] = r;
+            }
+        }
+        if (cnt)
+            run_lanes(active,cnt,e,&m);
+        // combine the per prime residues for each base
+        for (i = 0; i <= bhi-blo; ++i)
+        {
+            uint32_t f = _fstart[i], fe = _fstart[i+1];
+            bool skip = false;
+            for (j = f; j < fe; ++j)
+                if (_pdiv[_fprime[j]]) // gcd(base,n) > 1
+                {
+                    skip = true;
+                    break;
+                }
+            if (skip)
+                continue;
+            bool pass = true;
+            if (q > 1) // b^(n-1) (mod q) as a product in Montgomery form
+            {
+                uint64_t r = m.r1;
+                for (j = f; j < fe; ++j)
+                    for (k = 0; k < _fexp[j]; ++k)
+                        r = mont63_mult(r,_rq[_fprime[j]],&m);
+                pass = (r == m.r1);
+            }
+            if (pass && s) // b^(n-1) (mod 2^s)
+            {
+                uint64_t r = 1;
+                for (j = f; j < fe; ++j)
+                    for (k = 0; k < _fexp[j]; ++k)
+                        r = (r*_r2[_fprime[j]]) & mask;
+                pass = (r == 1);
+            }
+            if (pass)
+                fprintf(files[i],"%lu\n",n);
+        }
+    }
+}
+
+void check_inputs(uint64_t min, uint64_t max, uint64_t blo, uint64_t bhi)
+{
+    if (min < 2)
+    {
+        fprintf(stderr,"min number must be >= 2\n");
+        exit(0);
+    }
+    if (max >= POW2(63))
+    {
+        fprintf(stderr,"max number is > 63 bits\n");
+        exit(0);
+    }
+    if (min > max)
+    {
+        fprintf(stderr,"must have min <= max\n");
+        exit(0);
+    }
+    if (blo < 2)
+    {
+        fprintf(stderr,"base range must start >= 2\n");
+        exit(0);
+    }
+    if (bhi >= POW2(16))
+    {
+        fprintf(stderr,"base range is limited to 16 bits\n");
+        exit(0);
+    }
+    if (blo > bhi)
+    {
+        fprintf(stderr,"must have base_lo <= base_hi\n");
+        exit(0);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 6)
+    {
+        fprintf(stderr,"./a.out <min> <max> <base_lo> <base_hi> <outdir>\n");
+        return 0;
+    }
+    uint64_t min = strtoul(argv[1],NULL,10);
+    uint64_t max = strtoul(argv[2],NULL,10);
+    uint64_t blo = strtoul(argv[3],NULL,10);
+    uint64_t bhi = strtoul(argv[4],NULL,10);
+    check_inputs(min,max,blo,bhi);
+    // 1 file per base can exceed the default open file limit
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE,&rl) == 0 && rl.rlim_cur < bhi-blo+16)
+    {
+        rl.rlim_cur = rl.rlim_max < bhi-blo+16 ? rl.rlim_max : bhi-blo+16;
+        setrlimit(RLIMIT_NOFILE,&rl);
+    }
+    FILE **files = (FILE**)malloc((bhi-blo+1)*sizeof(*files));
+    char fname[4096];
+    uint32_t i;
+    for (i = 0; i <= bhi-blo; ++i)
+    {
+        snprintf(fname,sizeof(fname),"%s/fpp_%lu",argv[5],blo+i);
+        files[i] = fopen(fname,"w");
+        if (!files[i])
+        {
+            fprintf(stderr,"unable to open %s\n",fname);
+            return 1;
+        }
+    }
+    setup_bases(blo,bhi);
+    loop(min,max,blo,bhi,files);
+    for (i = 0; i <= bhi-blo; ++i)
+    {
+        fprintf(files[i],"done\n");
+        fclose(files[i]);
+    }
+    free(files);
+    free(_primes);
+    free(_pdiv);
+    free(_rq);
+    free(_r2);
+    free(_fstart);
+    free(_fprime);
+    free(_fexp);
+    return 0;
+}
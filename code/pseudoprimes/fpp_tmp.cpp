@@ -2,15 +2,24 @@
     Fermat Probable Prime finder, using template metaprogramming to compile
     efficient code for any base. The base is limited to [2,1023] to keep code
     size reasonable with the template metaprograming. Numbers are written to
-    stdout, 1 per line, in base 10. This uses the 42 bit version for modular
-    multiplication, capping to about 4.4 trillion. Once complete, a line
-    containing "done" is written.
+    stdout, 1 per line, in base 10. The limit is kept at 42 bits, capping to
+    about 4.4 trillion. The mid range runs the exponentiations as interleaved
+    Montgomery lanes (see batch_flush) which is much faster than testing the
+    candidates one at a time. Once complete, a line containing "done" is
+    written.
+
+    With --binary the numbers are written as raw little endian uint64 values
+    instead, terminated by a 0xffffffffffffffff sentinel in place of the
+    "done" line (the format sorted_diff -b consumes).
 */
 
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
 #include <assert.h>
 #include "functions.h"
 #include "templates.hpp"
@@ -28,19 +37,230 @@
 // Limit determined by choice of modular multiplication function
 #define LIMIT (POW2(42)-1)
 
+/*
+    Batched Fermat test. A single exponentiation is a serial chain of dependent
+    multiplications so it stalls on multiply latency. The mid range loop
+    collects BATCH_LANES candidates and runs their exponentiations as
+    interleaved Montgomery form lanes, giving the processor independent work to
+    overlap. Montgomery (REDC) is used because it needs only multiplications,
+    which pipeline, instead of the divisions in mod_mult42 which do not.
+    Candidates arrive in increasing order and survivors are printed at flush
+    time, before any later candidate is collected, so the output order is
+    unchanged.
+*/
+
+#define BATCH_LANES 8
+
+uint64_t _batch_n[BATCH_LANES];
+uint32_t _batch_count = 0;
+
+/*
+    Output stage, same as pp.c: text by default, raw little endian uint64
+    values with --binary, block buffered so writing never throttles the
+    lanes. The binary stream ends with a UINT64_MAX sentinel.
+*/
+#define OUT_VALUES 8192
+bool _out_binary = false;
+uint64_t _out_buf[OUT_VALUES];
+uint32_t _out_len = 0;
+
+static inline void out_value(uint64_t n)
+{
+    if (!_out_binary)
+    {
+        printf("%lu\n",n);
+        return;
+    }
+    _out_buf[_out_len] = n;
+    if (++_out_len == OUT_VALUES)
+    {
+        fwrite(_out_buf,sizeof(uint64_t),_out_len,stdout);
+        _out_len = 0;
+    }
+}
+
+static inline void out_done(void)
+{
+    if (!_out_binary)
+    {
+        printf("done\n");
+        return;
+    }
+    _out_buf[_out_len++] = UINT64_MAX;
+    fwrite(_out_buf,sizeof(uint64_t),_out_len,stdout);
+    _out_len = 0;
+}
+
+/*
+    Prefilter stage, same idea as in pp.c: a segmented largest factor sieve
+    plus fermat_small_factor_check reject most composites before they reach
+    the exponentiation lanes. The window rolls forward with the candidates,
+    which arrive in increasing order. Constants can be overridden from the
+    compile line; SIEVE_LIMIT must keep the prime count below 0xffff.
+*/
+#ifndef SIEVE_LIMIT
+#define SIEVE_LIMIT POW2(16) // sieve primes are below this
+#endif
+#ifndef SEG_SIZE
+#define SEG_SIZE POW2(15) // numbers per sieve segment
+#endif
+
+uint32_t *_sieve_primes;
+uint32_t _nsieve;
+uint16_t _spf[SEG_SIZE]; // index of the largest sieve prime factor, or 0xffff
+uint64_t _seg_lo = 0, _seg_hi = 0; // current sieved window [lo,hi)
+
+/*
+    Progress reporting on SIGUSR1 (same surface as pp.c and the tp_tree -d
+    dumps). The flag is checked when the sieve window rolls forward so the
+    batching hot path stays untouched; the dump is one stderr line.
+*/
+volatile sig_atomic_t _prog_flag;
+uint64_t _prog_tested; // full Fermat tests run (batched and edge range)
+uint64_t _prog_found; // probable primes printed
+uint64_t _prog_start; // min of the scan, for numbers/sec
+time_t _prog_time; // start time of the scan
+
+void prog_signal(int sig)
+{
+    (void)sig;
+    _prog_flag = 1;
+}
+
+// count an edge range Fermat test and its result on the way through
+static inline bool prog_count(bool pass)
+{
+    ++_prog_tested;
+    if (pass)
+        ++_prog_found;
+    return pass;
+}
+
+static inline void prog_check(uint64_t lo)
+{
+    if (!_prog_flag)
+        return;
+    _prog_flag = 0;
+    time_t now = time(NULL);
+    uint64_t rate = now > _prog_time ? (lo-_prog_start)/(now-_prog_time) : 0;
+    fprintf(stderr,"# progress n=%lu tested=%lu found=%lu "
+        "numbers_per_sec=%lu\n",lo,_prog_tested,_prog_found,rate);
+}
+
+// simple sieve for the prefilter primes
+void sieve_init(void)
+{
+    bool *composite = (bool*)calloc(SIEVE_LIMIT,sizeof(*composite));
+    uint32_t i, j, count = 0;
+    for (i = 2; i < SIEVE_LIMIT; ++i)
+        if (!composite[i])
+        {
+            ++count;
+            for (j = i; (uint64_t)j*i < SIEVE_LIMIT; ++j)
+                composite[j*i] = true;
+        }
+    _sieve_primes = (uint32_t*)malloc(count*sizeof(*_sieve_primes));
+    _nsieve = 0;
+    for (i = 2; i < SIEVE_LIMIT; ++i)
+        if (!composite[i])
+            _sieve_primes[_nsieve++] = i;
+    free(composite);
+}
+
+// mark [lo,lo+SEG_SIZE) with the largest sieve prime factor of each number
+void sieve_segment(uint64_t lo)
+{
+    memset(_spf,0xff,sizeof(_spf));
+    prog_check(lo);
+    _seg_lo = lo;
+    _seg_hi = lo + SEG_SIZE;
+    for (uint32_t i = 0; i < _nsieve; ++i)
+    {
+        uint64_t p = _sieve_primes[i];
+        uint64_t m = ((lo+p-1)/p)*p; // first multiple of p at or above lo
+        for (; m < _seg_hi; m += p)
+            _spf[m-lo] = i; // later primes overwrite, keeping the largest
+    }
+}
+
+static void batch_flush(void)
+{
+    MONT63 m[BATCH_LANES];
+    uint64_t e[BATCH_LANES], mb[BATCH_LANES], r[BATCH_LANES];
+    bool ok[BATCH_LANES];
+    uint32_t i, count = _batch_count;
+    _batch_count = 0;
+    _prog_tested += count;
+    for (i = 0; i < count; ++i)
+    {
+        uint64_t n = _batch_n[i];
+        e[i] = n-1;
+        ok[i] = true;
+        if (!(n&1)) // split even n = 2^s * q like fermat_pp_mont
+        {
+            uint32_t s = 0;
+            while (!(n&1)) ++s, n >>= 1;
+            uint64_t mask = BIT_MASK(s);
+            uint64_t b2 = BASE & mask, r2 = b2, e2 = e[i]; // e[i] is odd
+            while (e2 >>= 1)
+            {
+                b2 = (b2*b2) & mask;
+                if (e2&1) r2 = (r2*b2) & mask;
+            }
+            ok[i] = (r2 == 1); // b^(n-1) = 1 (mod 2^s)
+            // the lane continues with the odd part q (harmless when q == 1)
+        }
+        mont63_init(m+i,n);
+        mb[i] = mont63_in(BASE%n,m+i);
+        r[i] = (e[i]&1) ? mb[i] : m[i].r1;
+    }
+    // all lanes advance together, exponents have the same bit length pattern
+    bool any = true;
+    while (any)
+    {
+        any = false;
+        for (i = 0; i < count; ++i)
+            if (e[i] >>= 1)
+            {
+                any = true;
+                mb[i] = mont63_mult(mb[i],mb[i],m+i);
+                if (e[i]&1) r[i] = mont63_mult(r[i],mb[i],m+i);
+            }
+    }
+    for (i = 0; i < count; ++i)
+        if (ok[i] && (m[i].n == 1 || r[i] == m[i].r1))
+        {
+            ++_prog_found;
+            out_value(_batch_n[i]);
+        }
+}
+
+static inline void batch_push(uint64_t n)
+{
+    if (n >= _seg_hi) // roll the sieve window forward
+        sieve_segment(n);
+    uint16_t f = _spf[n-_seg_lo];
+    if (f != 0xffff && !fermat_small_factor_check(n,BASE,_sieve_primes[f]))
+        return; // proven composite by the small factor
+    _batch_n[_batch_count] = n;
+    if (++_batch_count == BATCH_LANES)
+        batch_flush();
+}
+
 // Main loop in the mid range, assume midlo and midhi are divisible by BASE
 // Each iteration handles integers coprime to BASE in (n,n+BASE)
 static inline void loop_mid(uint64_t midlo, uint64_t midhi)
 {
     uint64_t n;
     // Increment by distinct prime factor product as required for the loop
-    // unrolling done by META_LOOP<>
+    // unrolling done by META_LOOP_BATCH<>
     for (n = midlo; n != midhi; n += META_DPF_PROD<BASE>::result)
     {
         // Unroll a loop with length of the distinct prime factor product.
-        // The numbers tested are coprime to the base.
-        META_LOOP<BASE>::function(n);
+        // The numbers collected are coprime to the base.
+        META_LOOP_BATCH<BASE>::function(n);
     }
+    batch_flush(); // finish the partial batch before the range above midhi
 }
 
 // Split main loop. Must be adjusted according to the base (by metaprogramming).
@@ -53,8 +273,8 @@ static inline void loop(uint64_t min, uint64_t max)
     if (max-min < BASE)
     {
         for (n = min; n <= max; ++n)
-            if (fermat_pp(n,BASE,mod_mult42))
-                printf("%lu\n",n);
+            if (prog_count(fermat_pp(n,BASE,mod_mult42)))
+                out_value(n);
         return;
     }
     // Compute [midlo,midhi] range inside [min,max], endpoints divisible by base
@@ -64,30 +284,41 @@ static inline void loop(uint64_t min, uint64_t max)
     midhi -= midhi%BASE;
     // Below midlo, [min,midlo)
     for (n = min; n < midlo; ++n)
-        if (fermat_pp(n,BASE,mod_mult42))
-            printf("%lu\n",n);
+        if (prog_count(fermat_pp(n,BASE,mod_mult42)))
+            out_value(n);
     // Mid range, [midlo,midhi]
     assert(midlo <= midhi);
     loop_mid(midlo,midhi);
     // Above midhi, (midhi,max]
     for (n = midhi+1; n <= max; ++n)
-        if (fermat_pp(n,BASE,mod_mult42))
-            printf("%lu\n",n);
+        if (prog_count(fermat_pp(n,BASE,mod_mult42)))
+            out_value(n);
 }
 
 int main(int argc, char **argv)
 {
     if (argc < 3)
     {
-        fprintf(stderr,"./a.out <min> <max>\n");
+        fprintf(stderr,"./a.out <min> <max> [--binary]\n");
         return 0;
     }
+    _out_binary = argc > 3 && !strcmp(argv[3],"--binary");
     uint64_t min = strtoul(argv[1],NULL,10);
     uint64_t max = strtoul(argv[2],NULL,10);
     assert(2 <= min);
     assert(min <= max);
     assert(max <= LIMIT);
+    sieve_init();
+    // progress dumps on SIGUSR1, SA_RESTART so a dump does not interrupt
+    // the stdout writes with EINTR
+    struct sigaction sa;
+    memset(&sa,0,sizeof(sa));
+    sa.sa_handler = prog_signal;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1,&sa,NULL);
+    _prog_start = min;
+    _prog_time = time(NULL);
     loop(min,max);
-    printf("done\n");
+    out_done();
     return 0;
 }
@@ -25,11 +25,10 @@ static inline uint64_t mod_mult42(uint64_t a, uint64_t b, uint64_t n)
     return r % n;
 }
 
-// TODO add more versions for bit sizes between 42 and 63
-
 // a full loop on individual bits
 // a should be the smaller number to use fewer loop iterations
-// this could probably be done faster with more than 64 bits
+// for many multiplications with the same odd modulus (like the probable prime
+// tests) the Montgomery form functions below are much faster in this range
 static inline uint64_t mod_mult63(uint64_t a, uint64_t b, uint64_t n)
 {
     uint64_t r = 0;
@@ -44,6 +43,64 @@ static inline uint64_t mod_mult63(uint64_t a, uint64_t b, uint64_t n)
     return r;
 }
 
+/*
+    Montgomery multiplication for odd moduli up to 63 bits. Numbers are kept in
+    Montgomery form a*R (mod n) with R = 2^64 so the expensive reduction step
+    becomes a multiplication by the precomputed -n^-1 (mod 2^64) and a shift
+    (REDC). The constants are computed once per modulus which is quickly repaid
+    because an exponentiation does 1 multiplication per exponent bit.
+*/
+
+typedef struct
+{
+    uint64_t n; // odd modulus, n > 1
+    uint64_t ninv; // -n^-1 (mod 2^64)
+    uint64_t r1; // R (mod n), which is 1 in Montgomery form
+    uint64_t r2; // R^2 (mod n), for conversion into Montgomery form
+}
+MONT63;
+
+static inline void mont63_init(MONT63 *m, uint64_t n)
+{
+    // newton iteration for the inverse of n (mod 2^64)
+    // x = n is correct to 3 bits (n*n = 1 (mod 8) for odd n)
+    // each iteration doubles the number of correct bits
+    uint64_t x = n;
+    x *= 2 - n*x; // 6 bits
+    x *= 2 - n*x; // 12 bits
+    x *= 2 - n*x; // 24 bits
+    x *= 2 - n*x; // 48 bits
+    x *= 2 - n*x; // 96 > 64 bits
+    m->n = n;
+    m->ninv = -x;
+    // 2^64 (mod n), cannot be 0 since n is odd
+    m->r1 = (UINT64_MAX % n) + 1;
+    m->r2 = ((__uint128_t)m->r1 * m->r1) % n;
+}
+
+// multiplication of numbers in Montgomery form, result in Montgomery form
+// (t + ((t * -n^-1) % 2^64) * n) / 2^64 = t*R^-1 (mod n), then 1 subtraction
+// is enough because the result is below 2n when a,b < n < 2^63
+static inline uint64_t mont63_mult(uint64_t a, uint64_t b, const MONT63 *m)
+{
+    __uint128_t t = (__uint128_t)a * b;
+    uint64_t k = (uint64_t)t * m->ninv;
+    uint64_t r = (t + (__uint128_t)k * m->n) >> 64;
+    return r < m->n ? r : r - m->n;
+}
+
+// convert into Montgomery form, a*R = a * R^2 * R^-1 (mod n)
+static inline uint64_t mont63_in(uint64_t a, const MONT63 *m)
+{
+    return mont63_mult(a,m->r2,m);
+}
+
+// convert out of Montgomery form, a*R * 1 * R^-1 = a (mod n)
+static inline uint64_t mont63_out(uint64_t a, const MONT63 *m)
+{
+    return mont63_mult(a,1,m);
+}
+
 /*
     GCD functions. Both inputs cannot be zero.
 */
@@ -216,3 +273,266 @@ static inline bool strong_fermat_pp(uint64_t n, uint64_t b,
             return true;
     return false;
 }
+
+/*
+    Cheap rejection for the Fermat condition when a small prime factor p of n
+    is known (from a sieve). If p | n then b^(n-1) = 1 (mod n) implies
+    b^(n-1) = 1 (mod p), and by Fermat's little theorem that reduces to
+    b^((n-1) mod (p-1)) = 1 (mod p), a tiny exponentiation. Returning false
+    proves n fails the Fermat test for base b. Since the Euler, Euler-Jacobi
+    and strong tests all imply the Fermat condition, this rejection is sound
+    for every test in this file. Note this cannot just discard any n with a
+    small factor: pseudoprimes usually have small factors (341 = 11*31,
+    561 = 3*11*17) and must survive, which they do because the congruence
+    holds mod each of their prime factors. The caller must ensure p is prime
+    and p divides n; p need not be coprime to b (p = 2 gives no information
+    since the reduced exponent is 0, but is handled).
+*/
+static inline bool fermat_small_factor_check(uint64_t n, uint64_t b, uint64_t p)
+{
+    uint64_t e = (n-1) % (p-1);
+    uint64_t mb = b % p, r = 1;
+    while (e) // r = b^((n-1) mod (p-1)) (mod p), exponent below 16 bits
+    {
+        if (e&1) r = (r*mb)%p;
+        mb = (mb*mb)%p;
+        e >>= 1;
+    }
+    return r == 1;
+}
+
+/*
+    Montgomery form versions of the probable prime tests, covering the full
+    63 bit range with no function pointer parameter needed. The exponentiation
+    loops stay in Montgomery form end to end, converting b in once and
+    comparing the result against 1 and -1 in Montgomery form (r1 and n-r1)
+    instead of converting back out. These give exactly the same results as the
+    mod_mult versions, just faster above 42 bits.
+*/
+
+/*
+    Fermat probable prime test in Montgomery form. The caller must guarantee
+    n >= 2. Even n (allowed by the mod_mult version) cannot use Montgomery
+    directly, so write n = 2^s * q with q odd and use that b^(n-1) = 1 (mod n)
+    iff it is 1 mod both 2^s and q. The 2^s part is cheap (multiplication is
+    just a mask) and the odd part falls through to the normal computation.
+*/
+static inline bool fermat_pp_mont(uint64_t n, uint64_t b)
+{
+    uint64_t e = n-1;
+    if (!(n&1))
+    {
+        uint32_t s = 0;
+        while (!(n&1)) ++s, n >>= 1;
+        uint64_t mask = BIT_MASK(s);
+        uint64_t mb = b & mask, r = mb; // e = original n-1 is odd
+        uint64_t e2 = e;
+        while (e2 >>= 1)
+        {
+            mb = (mb*mb) & mask;
+            if (e2&1) r = (r*mb) & mask;
+        }
+        if (r != 1) return false; // b^(n-1) != 1 (mod 2^s)
+        if (n == 1) return true; // original n was a power of 2
+    }
+    MONT63 m;
+    mont63_init(&m,n);
+    uint64_t mb = mont63_in(b%n,&m);
+    uint64_t r = (e&1) ? mb : m.r1;
+    while (e >>= 1) // r = b^(n-1) in Montgomery form
+    {
+        mb = mont63_mult(mb,mb,&m);
+        if (e&1) r = mont63_mult(r,mb,&m);
+    }
+    return r == m.r1;
+}
+
+// Euler probable prime test in Montgomery form, caller ensures n > 2 is odd
+static inline bool euler_pp_mont(uint64_t n, uint64_t b)
+{
+    MONT63 m;
+    mont63_init(&m,n);
+    uint64_t e = n>>1, mb = mont63_in(b%n,&m);
+    uint64_t r = (e&1) ? mb : m.r1;
+    while (e >>= 1) // r = b^((n-1)/2) in Montgomery form
+    {
+        mb = mont63_mult(mb,mb,&m);
+        if (e&1) r = mont63_mult(r,mb,&m);
+    }
+    return r == m.r1 || r == m.n - m.r1;
+}
+
+// Euler-Jacobi probable prime test in Montgomery form, n > 2 odd
+static inline bool euler_jacobi_pp_mont(uint64_t n, uint64_t b)
+{
+    MONT63 m;
+    mont63_init(&m,n);
+    uint64_t e = n>>1, mb = mont63_in(b%n,&m);
+    uint64_t r = (e&1) ? mb : m.r1;
+    while (e >>= 1) // r = b^((n-1)/2) in Montgomery form
+    {
+        mb = mont63_mult(mb,mb,&m);
+        if (e&1) r = mont63_mult(r,mb,&m);
+    }
+    int8_t j = jacobi(b,n);
+    return (r == m.r1 && j == 1) || (r == m.n - m.r1 && j == -1);
+}
+
+// Strong Fermat probable prime test in Montgomery form, n > 2 odd
+static inline bool strong_fermat_pp_mont(uint64_t n, uint64_t b)
+{
+    MONT63 m;
+    mont63_init(&m,n);
+    uint32_t s = 0;
+    uint64_t d = (n-1)>>1;
+    while (!(d&1)) ++s, d >>= 1;
+    uint64_t mb = mont63_in(b%n,&m);
+    uint64_t r = mb; // d is odd
+    while (d >>= 1) // r = b^d in Montgomery form
+    {
+        mb = mont63_mult(mb,mb,&m);
+        if (d&1) r = mont63_mult(r,mb,&m);
+    }
+    if (r == m.r1 || r == m.n - m.r1) return true;
+    while (s--)
+        if ((r = mont63_mult(r,r,&m)) == m.n - m.r1)
+            return true;
+    return false;
+}
+
+// modular addition, subtraction and halving for the Lucas sequence math,
+// inputs below the odd modulus n < 2^63 so the intermediate sums cannot
+// overflow and halving an odd value can add n first
+static inline uint64_t mod_add63(uint64_t a, uint64_t b, uint64_t n)
+{
+    uint64_t r = a+b;
+    return r < n ? r : r-n;
+}
+
+static inline uint64_t mod_sub63(uint64_t a, uint64_t b, uint64_t n)
+{
+    return a >= b ? a-b : a+n-b;
+}
+
+static inline uint64_t mod_half63(uint64_t a, uint64_t n)
+{
+    return (a&1) ? (a+n)>>1 : a>>1;
+}
+
+/*
+    Strong Lucas probable prime test with the Selfridge (method A) parameters:
+    D is the first of 5,-7,9,-11,... with (D|n) = -1, P = 1, Q = (1-D)/4.
+    Write n+1 = q*2^s with q odd; n passes if U_q = 0 or V_(q*2^r) = 0
+    (mod n) for some 0 <= r < s. Every D candidate has (D|square) != -1, so
+    if the search runs past |D| = 21 a perfect square check settles it (a
+    square is composite here, the caller rejected everything below 67^2).
+    The sequences are computed in Montgomery form by the binary ladder
+    U_2k = U_k*V_k, V_2k = V_k^2 - 2Q^k and (with P = 1)
+    U_2k+1 = (U_2k + V_2k)/2, V_2k+1 = (D*U_2k + V_2k)/2, halving mod n
+    works on Montgomery residues like on anything else. The caller must
+    guarantee n is odd, n >= 67 and n has no prime factor below 64 (so a
+    Jacobi symbol of 0 proves a shared factor with the small D).
+*/
+static inline bool strong_lucas_pp(uint64_t n)
+{
+    int64_t d = 5;
+    uint64_t dm; // d (mod n)
+    for (;;)
+    {
+        dm = d < 0 ? n - (uint64_t)(-d)%n : (uint64_t)d%n;
+        int8_t j = jacobi(dm,n);
+        if (j == -1) break;
+        if (j == 0) return false; // gcd(|d|,n) > 1 with |d| < 64
+        d = d < 0 ? -d+2 : -(d+2); // 5,-7,9,-11,...
+        if (d == 23) // past |d| = 21, check for a perfect square
+        {
+            uint64_t r = n, x = (n>>1)+1; // newton iteration for isqrt
+            while (x < r)
+            {
+                r = x;
+                x = (x + n/x)>>1;
+            }
+            if (r*r == n) return false;
+        }
+    }
+    int64_t q = (1-d)/4; // d = 1 (mod 4) along the search sequence
+    MONT63 m;
+    mont63_init(&m,n);
+    uint64_t mq = mont63_in(q < 0 ? n - (uint64_t)(-q)%n : (uint64_t)q%n,&m);
+    uint64_t md = mont63_in(dm,&m);
+    uint64_t e = n+1; // n < 2^63 so this cannot overflow
+    uint32_t s = 0;
+    while (!(e&1)) ++s, e >>= 1;
+    uint64_t hb = e; // highest set bit of the odd part
+    while (hb & (hb-1)) hb &= hb-1;
+    uint64_t mu = m.r1, mv = m.r1, mqk = mq; // U_1, V_1 = P = 1, Q^1
+    for (uint64_t bit = hb>>1; bit; bit >>= 1)
+    {
+        // index doubling k -> 2k
+        mu = mont63_mult(mu,mv,&m);
+        mv = mod_sub63(mont63_mult(mv,mv,&m),mod_add63(mqk,mqk,m.n),m.n);
+        mqk = mont63_mult(mqk,mqk,&m);
+        if (e & bit) // 2k -> 2k+1
+        {
+            uint64_t t = mod_add63(mu,mv,m.n);
+            mv = mod_add63(mont63_mult(md,mu,&m),mv,m.n);
+            mu = mod_half63(t,m.n);
+            mv = mod_half63(mv,m.n);
+            mqk = mont63_mult(mqk,mq,&m);
+        }
+    }
+    if (mu == 0 || mv == 0) // U_q = 0 or V_q = 0
+        return true;
+    while (--s) // V_(q*2^r) for 1 <= r < s
+    {
+        mv = mod_sub63(mont63_mult(mv,mv,&m),mod_add63(mqk,mqk,m.n),m.n);
+        if (mv == 0)
+            return true;
+        mqk = mont63_mult(mqk,mqk,&m);
+    }
+    return false;
+}
+
+/*
+    Hashed single base strong Fermat test for odd n < 2^32 with no prime
+    factor below 64. The base table (sprp32_bases.h) was built so that every
+    such composite fails its bucket's base and every prime passes, verified
+    exhaustively against the deterministic {2,7,61} base set, so one
+    exponentiation replaces three. See the generator notes in the table
+    header for the construction.
+*/
+#include "sprp32_bases.h"
+
+#define SPRP32_HASH(n) ((uint32_t)((uint32_t)(n)*2654435761u) >> 20)
+
+/*
+    Deterministic primality test for inputs up to 63 bits (the limit of the
+    multiplication kernels). Small inputs use a bit mask
+    of the primes below 64. Larger inputs are first filtered by trial division
+    (the compiler turns the divisions by constants into multiplications so this
+    cheaply rejects most composites). Below 2^32 a single strong Fermat test
+    with a hashed base decides (see above). Above that BPSW decides: a strong
+    Fermat test to base 2 composed with the strong Lucas test. BPSW has been
+    verified exhaustively to have no composite survivor below 2^64 (Feitsma's
+    base 2 pseudoprime list), which covers the whole input range here. The
+    mod_mult version is chosen from the size of n, above 42 bits the
+    Montgomery form test is used.
+*/
+static inline bool is_prime64(uint64_t n)
+{
+    if (n < 64) // bits are set at the prime positions
+        return (2891462833508853932uL >> n) & 1;
+    if (!(n&1))
+        return false;
+    // n >= 64 so a small factor always means composite
+    if (n%3 == 0 || n%5 == 0 || n%7 == 0 || n%11 == 0 || n%13 == 0
+     || n%17 == 0 || n%19 == 0 || n%23 == 0 || n%29 == 0 || n%31 == 0
+     || n%37 == 0 || n%41 == 0 || n%43 == 0 || n%47 == 0 || n%53 == 0
+     || n%59 == 0 || n%61 == 0)
+        return false;
+    if (n < POW2(32))
+        return strong_fermat_pp(n,_sprp32_bases[SPRP32_HASH(n)],mod_mult32);
+    if (n < POW2(42))
+        return strong_fermat_pp(n,2,mod_mult42) && strong_lucas_pp(n);
+    return strong_fermat_pp_mont(n,2) && strong_lucas_pp(n);
+}
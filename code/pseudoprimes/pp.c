@@ -3,7 +3,19 @@
 Program to enumerate probable primes. The numbers are written to stdout in base
 10, 1 per line. Once the end is reached, it prints a line with "done".
 
-TODO This can be better optimized for inputs larger than 42 bits.
+With --binary the numbers are written as raw little endian uint64 values
+instead, terminated by a 0xffffffffffffffff sentinel (values are below 2^63
+so the sentinel is unambiguous). This is the format sorted_diff -b consumes;
+text output parses at well under disk bandwidth on the comparison side.
+
+With -t N the range is split into chunks handled by a pool of N threads,
+each running the same segmented scan over its chunk. The modular
+multiplication variant is chosen per chunk, so the part of a run below
+2^32 uses mod_mult32 even when max is above it instead of the whole run
+paying for the worst case. Finished chunks are emitted in ascending chunk
+order (buffered until their turn), so the output is identical to a serial
+run and downstream sorted_diff works unchanged.
+
 TODO Base is limited to 32 bits to simplify some of the code for now (since it
 will work with all the mod_mult functions). Expanding this to support 63 bit
 bases is not very important for now.
@@ -18,36 +30,383 @@ coprime to base without the need to compute gcd().
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
 #include <assert.h>
 #include "functions.h"
 
+/*
+    Prefilter stage. Most candidates have a small prime factor and almost all
+    of those provably fail the Fermat condition by the much cheaper
+    fermat_small_factor_check, so the full exponentiation runs only for
+    numbers with no small factor (primes and the hard composites) plus the
+    rare small factor survivors. A segmented sieve marks each number in the
+    scan window with its largest sieve prime, staying in L2. The largest
+    factor gives the strongest congruence (3 can never reject an odd
+    candidate since every unit mod 3 has order dividing 2). Both constants
+    can be overridden from the compile line; SIEVE_LIMIT must keep the prime
+    count below 0xffff so the indexes fit in the uint16_t marks.
+*/
+#ifndef SIEVE_LIMIT
+#define SIEVE_LIMIT POW2(16) // sieve primes are below this
+#endif
+#ifndef SEG_SIZE
+#define SEG_SIZE POW2(15) // numbers per sieve segment
+#endif
+
+uint32_t *_sieve_primes;
+uint32_t _nsieve;
+// thread local so every pool thread sieves its own window
+__thread uint16_t _spf[SEG_SIZE]; // largest sieve prime factor index, 0xffff
+
+/*
+    Output stage. Text by default (1 number per line, then "done"), raw
+    little endian uint64 values with --binary, block buffered so writing
+    never throttles the scan. The binary stream ends with a UINT64_MAX
+    sentinel in place of the "done" line.
+*/
+#define OUT_VALUES 8192
+bool _out_binary = false;
+uint64_t _out_buf[OUT_VALUES];
+uint32_t _out_len = 0;
+
+// pool threads collect survivors here instead of writing, so the ordered
+// writer can emit whole chunks in ascending order (see scan_thread)
+__thread bool _out_collect = false;
+__thread uint64_t *_out_vec;
+__thread uint64_t _out_vec_len, _out_vec_cap;
+
+// direct output path, only the thread holding the write turn (or the
+// single serial thread) may call this
+static inline void emit_value(uint64_t n)
+{
+    if (!_out_binary)
+    {
+        printf("%lu\n",n);
+        return;
+    }
+    _out_buf[_out_len] = n;
+    if (++_out_len == OUT_VALUES)
+    {
+        fwrite(_out_buf,sizeof(uint64_t),_out_len,stdout);
+        _out_len = 0;
+    }
+}
+
+static inline void out_value(uint64_t n)
+{
+    if (!_out_collect)
+    {
+        emit_value(n);
+        return;
+    }
+    if (_out_vec_len == _out_vec_cap)
+    {
+        _out_vec_cap = _out_vec_cap ? 2*_out_vec_cap : 1024;
+        _out_vec = (uint64_t*)realloc(_out_vec,
+            _out_vec_cap*sizeof(*_out_vec));
+    }
+    _out_vec[_out_vec_len++] = n;
+}
+
+static inline void out_done(void)
+{
+    if (!_out_binary)
+    {
+        printf("done\n");
+        return;
+    }
+    _out_buf[_out_len++] = UINT64_MAX;
+    fwrite(_out_buf,sizeof(uint64_t),_out_len,stdout);
+    _out_len = 0;
+}
+
+// simple sieve for the prefilter primes
+void sieve_init(void)
+{
+    bool *composite = (bool*)calloc(SIEVE_LIMIT,sizeof(*composite));
+    uint32_t i, j, count = 0;
+    for (i = 2; i < SIEVE_LIMIT; ++i)
+        if (!composite[i])
+        {
+            ++count;
+            for (j = i; (uint64_t)j*i < SIEVE_LIMIT; ++j)
+                composite[j*i] = true;
+        }
+    _sieve_primes = (uint32_t*)malloc(count*sizeof(*_sieve_primes));
+    _nsieve = 0;
+    for (i = 2; i < SIEVE_LIMIT; ++i)
+        if (!composite[i])
+            _sieve_primes[_nsieve++] = i;
+    free(composite);
+}
+
+// mark [lo,lo+len) with the largest sieve prime factor of each number
+void sieve_segment(uint64_t lo, uint64_t len)
+{
+    memset(_spf,0xff,sizeof(_spf));
+    uint32_t i;
+    for (i = 0; i < _nsieve; ++i)
+    {
+        uint64_t p = _sieve_primes[i];
+        uint64_t m = ((lo+p-1)/p)*p; // first multiple of p at or above lo
+        for (; m < lo+len; m += p)
+            _spf[m-lo] = i; // later primes overwrite, keeping the largest
+    }
+}
+
+// prefilter a candidate at segment offset i
+// false proves n is not a (Fermat or stronger) probable prime for the base
+static inline bool prefilter(uint64_t n, uint64_t i, uint64_t base)
+{
+    return _spf[i] == 0xffff
+        || fermat_small_factor_check(n,base,_sieve_primes[_spf[i]]);
+}
+
+/*
+    Progress reporting on SIGUSR1 (same surface as the tp_tree -d dumps).
+    The flag is checked once per sieve segment so the candidate loop stays
+    untouched; the dump is one stderr line with the current position, the
+    full test and survivor counts, and the scan rate since the start. Pool
+    threads bump the counters without synchronization, the lost updates are
+    harmless for an advisory dump (and the position is wherever the thread
+    that rolled its window happens to be).
+*/
+volatile sig_atomic_t _prog_flag;
+uint64_t _prog_tested; // full probable prime tests run
+uint64_t _prog_found; // probable primes printed
+uint64_t _prog_start; // min of the scan, for numbers/sec
+time_t _prog_time; // start time of the scan
+
+void prog_signal(int sig)
+{
+    (void)sig;
+    _prog_flag = 1;
+}
+
+// count a full probable prime test and its result on the way through
+static inline bool prog_count(bool pass)
+{
+    ++_prog_tested;
+    if (pass)
+        ++_prog_found;
+    return pass;
+}
+
+static inline void prog_check(uint64_t lo)
+{
+    if (!_prog_flag)
+        return;
+    _prog_flag = 0;
+    time_t now = time(NULL);
+    uint64_t rate = now > _prog_time ? (lo-_prog_start)/(now-_prog_time) : 0;
+    fprintf(stderr,"# progress n=%lu tested=%lu found=%lu "
+        "numbers_per_sec=%lu\n",lo,_prog_tested,_prog_found,rate);
+}
+
 static inline void loop_all(uint64_t min, uint64_t max, uint64_t base,
     uint64_t (*mod_mult)(uint64_t,uint64_t,uint64_t),
     bool (*test)(uint64_t,uint64_t,uint64_t(*)(uint64_t,uint64_t,uint64_t)))
 {
-    while (min <= max)
+    uint64_t lo, i;
+    for (lo = min; lo <= max; lo += SEG_SIZE)
     {
-        if (gcd32((uint32_t)base,(uint32_t)(min%base)) == 1 &&
-            test(min,base,mod_mult))
-            printf("%lu\n",min);
-        ++min;
+        uint64_t len = max-lo+1 < SEG_SIZE ? max-lo+1 : SEG_SIZE;
+        sieve_segment(lo,len);
+        prog_check(lo);
+        for (i = 0; i < len; ++i)
+        {
+            uint64_t n = lo+i;
+            if (gcd32((uint32_t)base,(uint32_t)(n%base)) == 1 &&
+                prefilter(n,i,base) && prog_count(test(n,base,mod_mult)))
+                out_value(n);
+        }
     }
-    printf("done\n");
 }
 
 static inline void loop_odd(uint64_t min, uint64_t max, uint64_t base,
     uint64_t (*mod_mult)(uint64_t,uint64_t,uint64_t),
     bool (*test)(uint64_t,uint64_t,uint64_t(*)(uint64_t,uint64_t,uint64_t)))
 {
-    if (!(min&1)) ++min; // start at odd
-    while (min <= max)
+    uint64_t lo, i;
+    for (lo = min; lo <= max; lo += SEG_SIZE)
+    {
+        uint64_t len = max-lo+1 < SEG_SIZE ? max-lo+1 : SEG_SIZE;
+        sieve_segment(lo,len);
+        prog_check(lo);
+        for (i = (lo&1) ? 0 : 1; i < len; i += 2) // odd n only
+        {
+            uint64_t n = lo+i;
+            if (gcd32((uint32_t)base,(uint32_t)(n%base)) == 1 &&
+                prefilter(n,i,base) && prog_count(test(n,base,mod_mult)))
+                out_value(n);
+        }
+    }
+}
+
+// same loops for the Montgomery form tests, which precompute constants per
+// candidate instead of taking a mod_mult function pointer
+static inline void loop_all_mont(uint64_t min, uint64_t max, uint64_t base,
+    bool (*test)(uint64_t,uint64_t))
+{
+    uint64_t lo, i;
+    for (lo = min; lo <= max; lo += SEG_SIZE)
+    {
+        uint64_t len = max-lo+1 < SEG_SIZE ? max-lo+1 : SEG_SIZE;
+        sieve_segment(lo,len);
+        prog_check(lo);
+        for (i = 0; i < len; ++i)
+        {
+            uint64_t n = lo+i;
+            if (gcd32((uint32_t)base,(uint32_t)(n%base)) == 1 &&
+                prefilter(n,i,base) && prog_count(test(n,base)))
+                out_value(n);
+        }
+    }
+}
+
+static inline void loop_odd_mont(uint64_t min, uint64_t max, uint64_t base,
+    bool (*test)(uint64_t,uint64_t))
+{
+    uint64_t lo, i;
+    for (lo = min; lo <= max; lo += SEG_SIZE)
     {
-        if (gcd32((uint32_t)base,(uint32_t)(min%base)) == 1 &&
-            test(min,base,mod_mult))
-            printf("%lu\n",min);
-        min += 2;
+        uint64_t len = max-lo+1 < SEG_SIZE ? max-lo+1 : SEG_SIZE;
+        sieve_segment(lo,len);
+        prog_check(lo);
+        for (i = (lo&1) ? 0 : 1; i < len; i += 2) // odd n only
+        {
+            uint64_t n = lo+i;
+            if (gcd32((uint32_t)base,(uint32_t)(n%base)) == 1 &&
+                prefilter(n,i,base) && prog_count(test(n,base)))
+                out_value(n);
+        }
     }
-    printf("done\n");
+}
+
+// probable prime test types
+#define TYPE_FPP 0
+#define TYPE_EPP 1
+#define TYPE_EJPP 2
+#define TYPE_SFPP 3
+
+// scan [min,max] with the mod_mult variant chosen by this range's own upper
+// end, so a chunk entirely below 2^32 runs with mod_mult32 even when the
+// full scan reaches higher
+static void scan_range(uint64_t min, uint64_t max, uint64_t base, int type)
+{
+    switch (type)
+    {
+    case TYPE_FPP:
+        if (max < POW2(32))
+            loop_all(min,max,base,mod_mult32,fermat_pp);
+        else if (max < POW2(42))
+            loop_all(min,max,base,mod_mult42,fermat_pp);
+        else
+            loop_all_mont(min,max,base,fermat_pp_mont);
+        break;
+    case TYPE_EPP:
+        if (max < POW2(32))
+            loop_odd(min,max,base,mod_mult32,euler_pp);
+        else if (max < POW2(42))
+            loop_odd(min,max,base,mod_mult42,euler_pp);
+        else
+            loop_odd_mont(min,max,base,euler_pp_mont);
+        break;
+    case TYPE_EJPP:
+        if (max < POW2(32))
+            loop_odd(min,max,base,mod_mult32,euler_jacobi_pp);
+        else if (max < POW2(42))
+            loop_odd(min,max,base,mod_mult42,euler_jacobi_pp);
+        else
+            loop_odd_mont(min,max,base,euler_jacobi_pp_mont);
+        break;
+    case TYPE_SFPP:
+        if (max < POW2(32))
+            loop_odd(min,max,base,mod_mult32,strong_fermat_pp);
+        else if (max < POW2(42))
+            loop_odd(min,max,base,mod_mult42,strong_fermat_pp);
+        else
+            loop_odd_mont(min,max,base,strong_fermat_pp_mont);
+        break;
+    }
+}
+
+/*
+    Threaded driver (-t N). The range is cut into CHUNK_SIZE chunks (a
+    multiple of SEG_SIZE so the sieve windows fall on the same boundaries as
+    a serial run). Threads claim chunks in order from a shared counter and
+    scan them independently, collecting survivors in a thread local vector;
+    a finished chunk then waits for its turn and is emitted under the lock,
+    so the merged output is in ascending order and byte identical to the
+    serial scan. At most one in flight chunk per thread is ever buffered.
+*/
+#ifndef CHUNK_SIZE
+#define CHUNK_SIZE (64*SEG_SIZE) // numbers per chunk
+#endif
+
+uint64_t _scan_min, _scan_max, _scan_base;
+int _scan_type;
+uint64_t _nchunks;
+uint64_t _next_chunk; // next chunk to claim
+uint64_t _write_chunk; // next chunk to emit
+pthread_mutex_t _chunk_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t _chunk_cond = PTHREAD_COND_INITIALIZER;
+
+void *scan_thread(void *arg)
+{
+    (void)arg;
+    _out_collect = true;
+    _out_vec = NULL;
+    _out_vec_len = _out_vec_cap = 0;
+    for (;;)
+    {
+        pthread_mutex_lock(&_chunk_lock);
+        uint64_t c = _next_chunk++;
+        pthread_mutex_unlock(&_chunk_lock);
+        if (c >= _nchunks)
+            break;
+        uint64_t lo = _scan_min + c*CHUNK_SIZE;
+        uint64_t hi = _scan_max-lo < CHUNK_SIZE-1 ? _scan_max
+                                                  : lo + (CHUNK_SIZE-1);
+        _out_vec_len = 0;
+        scan_range(lo,hi,_scan_base,_scan_type);
+        // emit in chunk order, every claimed chunk is eventually written so
+        // the turn always comes
+        pthread_mutex_lock(&_chunk_lock);
+        while (_write_chunk != c)
+            pthread_cond_wait(&_chunk_cond,&_chunk_lock);
+        for (uint64_t i = 0; i < _out_vec_len; ++i)
+            emit_value(_out_vec[i]);
+        ++_write_chunk;
+        pthread_cond_broadcast(&_chunk_cond);
+        pthread_mutex_unlock(&_chunk_lock);
+    }
+    free(_out_vec);
+    return NULL;
+}
+
+void run_threads(uint64_t min, uint64_t max, uint64_t base, int type,
+    uint32_t threads)
+{
+    _scan_min = min;
+    _scan_max = max;
+    _scan_base = base;
+    _scan_type = type;
+    _nchunks = (max-min)/CHUNK_SIZE + 1;
+    _next_chunk = _write_chunk = 0;
+    pthread_t *tids = (pthread_t*)malloc(threads*sizeof(*tids));
+    uint32_t t;
+    for (t = 0; t < threads; ++t)
+        if (pthread_create(tids+t,NULL,scan_thread,NULL))
+        {
+            fprintf(stderr,"unable to create threads\n");
+            exit(1);
+        }
+    for (t = 0; t < threads; ++t)
+        pthread_join(tids[t],NULL);
+    free(tids);
 }
 
 void check_inputs(uint64_t min, uint64_t max, uint64_t base)
@@ -84,52 +443,59 @@ int main(int argc, char **argv)
 {
     if (argc < 5)
     {
-        fprintf(stderr,"./a.out <min> <max> <base> <fpp|epp|ejpp|sfpp>\n");
+        fprintf(stderr,"./a.out <min> <max> <base> <fpp|epp|ejpp|sfpp> "
+            "[--binary] [-t <threads>]\n");
         return 0;
     }
+    uint32_t threads = 1;
+    for (int i = 5; i < argc; ++i)
+    {
+        if (!strcmp(argv[i],"--binary"))
+            _out_binary = true;
+        else if (!strcmp(argv[i],"-t") && i+1 < argc)
+            threads = strtoul(argv[++i],NULL,10);
+        else
+        {
+            fprintf(stderr,"invalid argument: %s\n",argv[i]);
+            return 0;
+        }
+    }
+    if (threads < 1)
+        threads = 1;
     // parse inputs
     uint64_t min = strtoul(argv[1],NULL,10);
     uint64_t max = strtoul(argv[2],NULL,10);
     uint64_t base = strtoul(argv[3],NULL,10);
     check_inputs(min,max,base);
+    sieve_init();
+    // progress dumps on SIGUSR1, SA_RESTART so a dump does not interrupt
+    // the stdout writes with EINTR
+    struct sigaction sa;
+    memset(&sa,0,sizeof(sa));
+    sa.sa_handler = prog_signal;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1,&sa,NULL);
+    _prog_start = min;
+    _prog_time = time(NULL);
 //    fprintf(stderr,"type=%s\n",argv[4]);
+    int type;
     if (!strcmp("fpp",argv[4]))
-    {
-        if (max < POW2(32))
-            loop_all(min,max,base,mod_mult32,fermat_pp);
-        else if (max < POW2(42))
-            loop_all(min,max,base,mod_mult42,fermat_pp);
-        else
-            loop_all(min,max,base,mod_mult63,fermat_pp);
-    }
+        type = TYPE_FPP;
     else if (!strcmp("epp",argv[4]))
-    {
-        if (max < POW2(32))
-            loop_odd(min,max,base,mod_mult32,euler_pp);
-        else if (max < POW2(42))
-            loop_odd(min,max,base,mod_mult42,euler_pp);
-        else
-            loop_odd(min,max,base,mod_mult63,euler_pp);
-    }
+        type = TYPE_EPP;
     else if (!strcmp("ejpp",argv[4]))
-    {
-        if (max < POW2(32))
-            loop_odd(min,max,base,mod_mult32,euler_jacobi_pp);
-        else if (max < POW2(42))
-            loop_odd(min,max,base,mod_mult42,euler_jacobi_pp);
-        else
-            loop_odd(min,max,base,mod_mult63,euler_jacobi_pp);
-    }
+        type = TYPE_EJPP;
     else if (!strcmp("sfpp",argv[4]))
+        type = TYPE_SFPP;
+    else
     {
-        if (max < POW2(32))
-            loop_odd(min,max,base,mod_mult32,strong_fermat_pp);
-        else if (max < POW2(42))
-            loop_odd(min,max,base,mod_mult42,strong_fermat_pp);
-        else
-            loop_odd(min,max,base,mod_mult63,strong_fermat_pp);
+        fprintf(stderr,"invalid type\n");
+        return 0;
     }
+    if (threads == 1)
+        scan_range(min,max,base,type);
     else
-        fprintf(stderr,"invalid type\n");
+        run_threads(min,max,base,type,threads);
+    out_done();
     return 0;
 }
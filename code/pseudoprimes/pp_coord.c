@@ -0,0 +1,311 @@
+/*
+    Coordinator for distributed pseudoprime scans, replacing the static
+    pre sharding of job_generator.py. Leases of (base, range chunk) are
+    handed out over TCP to pp_worker processes; workers stream back the
+    --binary result records of pp with a completion acknowledgment. A lease
+    whose worker disconnects goes back in the queue, and once the queue is
+    empty idle workers are handed still outstanding leases (stealing work
+    from stragglers — the first finished copy wins, duplicates are
+    discarded), so a dozen heterogeneous machines finish a catalog run
+    together instead of waiting for the slowest shard.
+
+    usage: ./pp_coord <port> <min> <max> <base_lo> <base_hi> <type>
+        <out_prefix> [chunk_size]
+
+    One lease per chunk_size numbers (default 2^30) per base. Completed
+    chunks are staged in <out_prefix><base>.c<index> files and concatenated
+    in range order into <out_prefix><base> when a base completes, giving
+    the same sorted binary stream (values then the end sentinel) as a
+    single pp --binary run, so sorted_diff -b works unchanged.
+
+    protocol (control is line based text, results are raw bytes):
+    worker: next\n
+    coord:  lease <id> <base> <min> <max> <type>\n
+            | wait\n (nothing to hand out right now)
+            | shutdown\n (everything is done)
+    worker: result <id> <nbytes>\n then nbytes of values (no sentinel,
+            the worker verified and stripped it)
+    coord:  ack <id>\n
+*/
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define QUEUED 0
+#define ISSUED 1
+#define DONE 2
+
+typedef struct
+{
+    uint64_t min, max;
+    uint32_t base;
+    uint32_t index; // chunk index within the base, for ordered assembly
+    int state;
+}
+LEASE;
+
+LEASE *_leases;
+uint64_t _nleases, _ndone;
+uint64_t *_base_left; // outstanding chunks per base
+uint32_t _base_lo, _base_hi;
+const char *_type;
+const char *_prefix;
+uint64_t _steal_cursor; // rotates re-issues over outstanding leases
+pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+
+char *chunk_name(uint32_t base, uint32_t index)
+{
+    char *name = (char*)malloc(strlen(_prefix)+32);
+    sprintf(name,"%s%u.c%u",_prefix,base,index);
+    return name;
+}
+
+// all chunks of a base are done, concatenate them in range order and
+// append the stream end sentinel
+void assemble_base(uint32_t base)
+{
+    char *outname = (char*)malloc(strlen(_prefix)+16);
+    sprintf(outname,"%s%u",_prefix,base);
+    FILE *out = fopen(outname,"wb");
+    if (!out)
+    {
+        fprintf(stderr,"error opening output file %s\n",outname);
+        exit(1);
+    }
+    char buf[1<<16];
+    for (uint64_t i = 0; i < _nleases; ++i)
+    {
+        if (_leases[i].base != base)
+            continue;
+        char *name = chunk_name(base,_leases[i].index);
+        FILE *in = fopen(name,"rb");
+        if (!in)
+        {
+            fprintf(stderr,"error opening chunk file %s\n",name);
+            exit(1);
+        }
+        size_t len;
+        while ((len = fread(buf,1,sizeof(buf),in)))
+            fwrite(buf,1,len,out);
+        fclose(in);
+        remove(name);
+        free(name);
+    }
+    uint64_t end = UINT64_MAX;
+    fwrite(&end,sizeof(end),1,out);
+    if (fclose(out) != 0)
+    {
+        fprintf(stderr,"error writing output file %s\n",outname);
+        exit(1);
+    }
+    fprintf(stderr,"# base %u complete -> %s\n",base,outname);
+    free(outname);
+}
+
+// pick a lease for an idle worker, fresh ones first, then steal an
+// outstanding one, -1 when everything is done, -2 when there is nothing
+// to hand out but results are still pending
+int64_t pick_lease(void)
+{
+    if (_ndone == _nleases)
+        return -1;
+    for (uint64_t i = 0; i < _nleases; ++i)
+        if (_leases[i].state == QUEUED)
+        {
+            _leases[i].state = ISSUED;
+            return i;
+        }
+    // work stealing: rotate over the outstanding leases so concurrent idle
+    // workers duplicate different stragglers
+    for (uint64_t k = 0; k < _nleases; ++k)
+    {
+        uint64_t i = _steal_cursor++ % _nleases;
+        if (_leases[i].state == ISSUED)
+            return i;
+    }
+    return -2;
+}
+
+void *serve(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+    FILE *in = fdopen(fd,"r");
+    FILE *out = fdopen(dup(fd),"w");
+    if (!in || !out)
+        exit(1);
+    char line[256];
+    int64_t held = -1; // lease this connection is working on
+    while (fgets(line,sizeof(line),in))
+    {
+        if (strcmp(line,"next\n") == 0)
+        {
+            pthread_mutex_lock(&_lock);
+            held = pick_lease();
+            pthread_mutex_unlock(&_lock);
+            if (held == -1)
+            {
+                fprintf(out,"shutdown\n");
+                fflush(out);
+                break;
+            }
+            if (held == -2)
+                fprintf(out,"wait\n");
+            else
+            {
+                LEASE *l = _leases+held;
+                fprintf(out,"lease %ld %u %lu %lu %s\n",
+                    held,l->base,l->min,l->max,_type);
+            }
+            fflush(out);
+            continue;
+        }
+        int64_t id;
+        uint64_t nbytes;
+        if (sscanf(line,"result %ld %lu",&id,&nbytes) == 2
+            && id >= 0 && (uint64_t)id < _nleases && nbytes%8 == 0)
+        {
+            char *data = (char*)malloc(nbytes ? nbytes : 1);
+            if (fread(data,1,nbytes,in) != nbytes)
+            {
+                free(data);
+                break; // connection died mid upload, lease is re-queued
+            }
+            pthread_mutex_lock(&_lock);
+            LEASE *l = _leases+id;
+            if (l->state != DONE) // first finished copy wins
+            {
+                char *name = chunk_name(l->base,l->index);
+                FILE *f = fopen(name,"wb");
+                if (!f || fwrite(data,1,nbytes,f) != nbytes
+                    || fclose(f) != 0)
+                {
+                    fprintf(stderr,"error writing chunk file %s\n",name);
+                    exit(1);
+                }
+                free(name);
+                l->state = DONE;
+                ++_ndone;
+                if (--_base_left[l->base-_base_lo] == 0)
+                    assemble_base(l->base);
+                fprintf(stderr,"# lease %ld done (%lu/%lu)\n",
+                    id,_ndone,_nleases);
+            }
+            pthread_mutex_unlock(&_lock);
+            free(data);
+            if (held == id)
+                held = -1;
+            fprintf(out,"ack %ld\n",id);
+            fflush(out);
+            continue;
+        }
+        break; // unknown request
+    }
+    // a lease lost to a dead or disconnected worker goes back in the queue
+    pthread_mutex_lock(&_lock);
+    if (held >= 0 && _leases[held].state == ISSUED)
+        _leases[held].state = QUEUED;
+    pthread_mutex_unlock(&_lock);
+    if (in)
+        fclose(in);
+    if (out)
+        fclose(out);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 8)
+    {
+        fprintf(stderr,"./pp_coord <port> <min> <max> <base_lo> <base_hi> "
+            "<fpp|epp|ejpp|sfpp> <out_prefix> [chunk_size]\n");
+        return 0;
+    }
+    int port = atoi(argv[1]);
+    uint64_t min = strtoul(argv[2],NULL,10);
+    uint64_t max = strtoul(argv[3],NULL,10);
+    _base_lo = atoi(argv[4]);
+    _base_hi = atoi(argv[5]);
+    _type = argv[6];
+    _prefix = argv[7];
+    uint64_t chunk = argc > 8 ? strtoul(argv[8],NULL,10) : 1uL<<30;
+    if (min < 2 || min > max || _base_lo < 2 || _base_lo > _base_hi
+        || chunk < 1)
+    {
+        fprintf(stderr,"invalid arguments\n");
+        return 0;
+    }
+    if (strcmp(_type,"fpp") && strcmp(_type,"epp") && strcmp(_type,"ejpp")
+        && strcmp(_type,"sfpp"))
+    {
+        fprintf(stderr,"invalid type\n");
+        return 0;
+    }
+    // build the lease list, chunks per base in range order
+    uint64_t per_base = (max-min)/chunk + 1;
+    _nleases = per_base*(_base_hi-_base_lo+1);
+    _leases = (LEASE*)malloc(_nleases*sizeof(*_leases));
+    _base_left = (uint64_t*)malloc((_base_hi-_base_lo+1)*sizeof(*_base_left));
+    uint64_t i = 0;
+    for (uint32_t base = _base_lo; base <= _base_hi; ++base)
+    {
+        _base_left[base-_base_lo] = per_base;
+        for (uint64_t c = 0; c < per_base; ++c, ++i)
+        {
+            _leases[i].base = base;
+            _leases[i].index = c;
+            _leases[i].min = min + c*chunk;
+            _leases[i].max = max-_leases[i].min < chunk-1
+                ? max : _leases[i].min + (chunk-1);
+            _leases[i].state = QUEUED;
+        }
+    }
+    signal(SIGPIPE,SIG_IGN); // broken worker pipes are handled per call
+    int sock = socket(AF_INET,SOCK_STREAM,0);
+    int one = 1;
+    setsockopt(sock,SOL_SOCKET,SO_REUSEADDR,&one,sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    if (bind(sock,(struct sockaddr*)&addr,sizeof(addr)) != 0
+        || listen(sock,64) != 0)
+    {
+        fprintf(stderr,"unable to listen on port %d\n",port);
+        exit(1);
+    }
+    fprintf(stderr,"# %lu leases over bases %u-%u\n",
+        _nleases,_base_lo,_base_hi);
+    for (;;)
+    {
+        int fd = accept(sock,NULL,NULL);
+        if (fd < 0)
+            continue;
+        pthread_mutex_lock(&_lock);
+        bool finished = _ndone == _nleases;
+        pthread_mutex_unlock(&_lock);
+        if (finished)
+        {
+            close(fd);
+            break;
+        }
+        pthread_t t;
+        if (pthread_create(&t,NULL,serve,(void*)(intptr_t)fd) == 0)
+            pthread_detach(t);
+        else
+            close(fd);
+    }
+    // note: the loop above exits after the connection that completed the
+    // final lease closes and one more connection arrives; workers asking
+    // for work after completion are told to shut down first
+    return 0;
+}
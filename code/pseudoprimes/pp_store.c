@@ -0,0 +1,603 @@
+/*
+    Indexed binary store for the pseudoprime catalog. The per base outputs
+    of pp/fpp are sorted runs of 63 bit values; as text they can only be
+    grepped. This packs a run into delta encoded blocks with a block index
+    so queries memory map the file and decode one small block per lookup
+    instead of a whole file.
+
+    ./pp_store build <store> <base> <input> [-b]
+        import one sorted run (use "-" for stdin). Text input is one value
+        per line ending with a "done" line, -b is the binary stream of
+        pp/sorted_diff (raw little endian uint64 terminated by the
+        0xffffffffffffffff sentinel). Values must be strictly increasing.
+    ./pp_store info <store> [store...]
+        print base, value count and size of each store
+    ./pp_store lookup <n> <store>
+        exit 0 and print n if present, exit 1 otherwise
+    ./pp_store range <min> <max> <store>
+        print the values in [min,max] one per line
+    ./pp_store bases <n> <store> [store...]
+        print the base of every store containing n (which bases n fools)
+    ./pp_store intersect <k> <store> [store...]
+        k-way merge all stores and print every value present in at least
+        k of them as "<value> <count> <base> <base> ...", the actual
+        research target (numbers pseudoprime to many bases). Streams block
+        by block, nothing is decompressed whole.
+
+    File layout (little endian):
+        0   8 byte magic "PPSTORE1"
+        8   uint32 base
+        12  uint32 values per block
+        16  uint64 value count
+        24  uint64 block count
+        32  uint64 index offset
+        40  block data, per block the deltas to the previous value as
+            LEB128 varints (the block's first value lives in the index)
+        index: per block uint64 first value, uint64 data offset
+
+    A point lookup is a binary search of the index plus one block decode
+    (256 varints), a few hundred ns from page cache, so scattered lookups
+    run at millions per second without touching the rest of the file.
+*/
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAGIC "PPSTORE1"
+#define BLOCK_VALUES 256 // values per block, small so lookups decode little
+#define RBUF_VALUES 8192 // values per read block (64 KiB)
+#define BIN_END UINT64_MAX // sentinel ending a binary stream
+
+/*
+    Input stream for build, same framing as sorted_diff
+*/
+
+typedef struct
+{
+    FILE *stream;
+    uint64_t next;
+    bool has_next;
+    bool binary;
+    bool ended; // the sentinel or "done" line was seen
+    uint32_t pos, len; // binary read buffer position
+    uint64_t buf[RBUF_VALUES];
+}
+STREAM_STATE;
+
+static inline void advance(STREAM_STATE *ss)
+{
+    assert(ss->has_next);
+    if (!ss->binary)
+    {
+        ss->has_next = fscanf(ss->stream,"%lu",&(ss->next)) == 1;
+        return;
+    }
+    if (ss->pos == ss->len)
+    {
+        ss->len = fread(ss->buf,sizeof(uint64_t),RBUF_VALUES,ss->stream);
+        ss->pos = 0;
+        if (ss->len == 0)
+        {
+            ss->has_next = false; // ended stays false, missing sentinel
+            return;
+        }
+    }
+    uint64_t v = ss->buf[ss->pos++];
+    if (v == BIN_END)
+    {
+        ss->has_next = false;
+        ss->ended = true;
+    }
+    else
+        ss->next = v;
+}
+
+static bool stream_open(STREAM_STATE *ss, const char *name, bool binary)
+{
+    if (!strcmp(name,"-"))
+        ss->stream = stdin;
+    else
+        ss->stream = fopen(name,binary ? "rb" : "r");
+    if (!ss->stream)
+        return false;
+    ss->binary = binary;
+    ss->ended = false;
+    ss->pos = ss->len = 0;
+    ss->has_next = true;
+    advance(ss);
+    return true;
+}
+
+// check the end of stream marker after the values ran out
+static bool check_done(STREAM_STATE *ss)
+{
+    if (ss->binary)
+        return ss->ended;
+    char *line = NULL;
+    size_t len = 0;
+    bool ret = getline(&line,&len,ss->stream) != -1
+        && !strcmp(line,"done\n");
+    free(line);
+    return ret;
+}
+
+/*
+    Store build
+*/
+
+// little endian field writers for the header and index
+static void put32(unsigned char *p, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i)
+        p[i] = v >> (8*i);
+}
+
+static void put64(unsigned char *p, uint64_t v)
+{
+    for (int i = 0; i < 8; ++i)
+        p[i] = v >> (8*i);
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i)
+        v |= (uint32_t)p[i] << (8*i);
+    return v;
+}
+
+static uint64_t get64(const unsigned char *p)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i)
+        v |= (uint64_t)p[i] << (8*i);
+    return v;
+}
+
+#define HEADER_BYTES 40
+#define INDEX_ENTRY 16
+
+static int run_build(const char *store, uint32_t base, const char *input,
+        bool binary)
+{
+    STREAM_STATE ss;
+    if (!stream_open(&ss,input,binary))
+    {
+        fprintf(stderr,"error opening: %s\n",input);
+        return 1;
+    }
+    FILE *f = fopen(store,"wb");
+    if (!f)
+    {
+        fprintf(stderr,"error creating: %s\n",store);
+        return 1;
+    }
+    unsigned char header[HEADER_BYTES];
+    memcpy(header,MAGIC,8);
+    put32(header+8,base);
+    put32(header+12,BLOCK_VALUES);
+    fwrite(header,1,HEADER_BYTES,f); // rewritten with the counts at the end
+    // block data, the index entries accumulate in memory (16 bytes per 256
+    // values, a 100 GB catalog's index is a few hundred MB)
+    uint64_t ialloc = 64, nblocks = 0;
+    unsigned char *index = (unsigned char*)malloc(ialloc*INDEX_ENTRY);
+    unsigned char vbuf[10];
+    uint64_t count = 0, prev = 0, off = HEADER_BYTES;
+    while (ss.has_next)
+    {
+        uint64_t v = ss.next;
+        if (count && v <= prev)
+        {
+            fprintf(stderr,"input not strictly increasing at %lu\n",v);
+            return 1;
+        }
+        if (count % BLOCK_VALUES == 0) // new block, value goes in the index
+        {
+            if (nblocks == ialloc)
+            {
+                ialloc *= 2;
+                index = (unsigned char*)realloc(index,ialloc*INDEX_ENTRY);
+            }
+            put64(index+nblocks*INDEX_ENTRY,v);
+            put64(index+nblocks*INDEX_ENTRY+8,off);
+            ++nblocks;
+        }
+        else // delta to the previous value as a varint
+        {
+            uint64_t d = v - prev;
+            uint32_t l = 0;
+            while (d >= 128)
+            {
+                vbuf[l++] = 128 | (d & 127);
+                d >>= 7;
+            }
+            vbuf[l++] = d;
+            fwrite(vbuf,1,l,f);
+            off += l;
+        }
+        prev = v;
+        ++count;
+        advance(&ss);
+    }
+    if (!check_done(&ss))
+    {
+        fprintf(stderr,"input missing end marker\n");
+        return 1;
+    }
+    fclose(ss.stream);
+    fwrite(index,INDEX_ENTRY,nblocks,f);
+    put64(header+16,count);
+    put64(header+24,nblocks);
+    put64(header+32,off);
+    fseek(f,0,SEEK_SET);
+    fwrite(header,1,HEADER_BYTES,f);
+    if (fclose(f) != 0)
+    {
+        fprintf(stderr,"error writing: %s\n",store);
+        return 1;
+    }
+    free(index);
+    return 0;
+}
+
+/*
+    Memory mapped store for queries
+*/
+
+typedef struct
+{
+    const unsigned char *data;
+    uint64_t size;
+    uint32_t base;
+    uint32_t bvalues; // values per block
+    uint64_t count;
+    uint64_t nblocks;
+    const unsigned char *index;
+}
+STORE;
+
+static void store_open(STORE *s, const char *path)
+{
+    int fd = open(path,O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd,&st) != 0)
+    {
+        fprintf(stderr,"error opening: %s\n",path);
+        exit(1);
+    }
+    s->size = st.st_size;
+    s->data = (const unsigned char*)
+        mmap(NULL,s->size,PROT_READ,MAP_SHARED,fd,0);
+    close(fd);
+    if (s->data == MAP_FAILED || s->size < HEADER_BYTES
+     || memcmp(s->data,MAGIC,8) != 0)
+    {
+        fprintf(stderr,"not a pp_store file: %s\n",path);
+        exit(1);
+    }
+    s->base = get32(s->data+8);
+    s->bvalues = get32(s->data+12);
+    s->count = get64(s->data+16);
+    s->nblocks = get64(s->data+24);
+    uint64_t ioff = get64(s->data+32);
+    if (ioff + s->nblocks*INDEX_ENTRY > s->size)
+    {
+        fprintf(stderr,"truncated pp_store file: %s\n",path);
+        exit(1);
+    }
+    s->index = s->data + ioff;
+}
+
+static void store_close(STORE *s)
+{
+    munmap((void*)s->data,s->size);
+}
+
+// index entry accessors
+#define BLOCK_FIRST(s,b) get64((s)->index+(b)*INDEX_ENTRY)
+#define BLOCK_OFF(s,b) get64((s)->index+(b)*INDEX_ENTRY+8)
+
+// number of values in block b (the last block is usually partial)
+static inline uint64_t block_count(const STORE *s, uint64_t b)
+{
+    uint64_t left = s->count - b*s->bvalues;
+    return left < s->bvalues ? left : s->bvalues;
+}
+
+// sequential decoder over a store from a block boundary
+typedef struct
+{
+    const STORE *s;
+    uint64_t block;
+    uint64_t i; // values consumed from the block
+    const unsigned char *p; // next varint
+    uint64_t value;
+    bool has_value;
+}
+CURSOR;
+
+static void cursor_block(CURSOR *c, uint64_t block)
+{
+    c->block = block;
+    c->i = 0;
+    if (block >= c->s->nblocks)
+    {
+        c->has_value = false;
+        return;
+    }
+    c->value = BLOCK_FIRST(c->s,block);
+    c->p = c->s->data + BLOCK_OFF(c->s,block);
+    c->i = 1;
+    c->has_value = true;
+}
+
+static inline void cursor_advance(CURSOR *c)
+{
+    assert(c->has_value);
+    if (c->i == block_count(c->s,c->block))
+    {
+        cursor_block(c,c->block+1);
+        return;
+    }
+    uint64_t d = 0;
+    uint32_t shift = 0;
+    unsigned char byte;
+    do
+    {
+        byte = *(c->p)++;
+        d |= (uint64_t)(byte & 127) << shift;
+        shift += 7;
+    }
+    while (byte & 128);
+    c->value += d;
+    ++(c->i);
+}
+
+// last block whose first value is <= n, the block n would live in
+// (0 if n is below the whole store, callers check the values)
+static uint64_t find_block(const STORE *s, uint64_t n)
+{
+    uint64_t lo = 0, hi = s->nblocks;
+    while (hi - lo > 1) // invariant: answer in [lo,hi)
+    {
+        uint64_t mid = lo + (hi-lo)/2;
+        if (BLOCK_FIRST(s,mid) <= n)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// position a cursor at the first value >= n
+static void cursor_seek(CURSOR *c, const STORE *s, uint64_t n)
+{
+    c->s = s;
+    if (s->nblocks == 0)
+    {
+        c->has_value = false;
+        return;
+    }
+    cursor_block(c,find_block(s,n));
+    while (c->has_value && c->value < n)
+        cursor_advance(c);
+}
+
+static bool store_contains(const STORE *s, uint64_t n)
+{
+    CURSOR c;
+    cursor_seek(&c,s,n);
+    return c.has_value && c.value == n;
+}
+
+/*
+    Queries
+*/
+
+static int run_info(const char **files, uint32_t nfiles)
+{
+    for (uint32_t i = 0; i < nfiles; ++i)
+    {
+        STORE s;
+        store_open(&s,files[i]);
+        printf("%s: base %u, %lu values, %lu blocks, %lu bytes\n",
+            files[i],s.base,s.count,s.nblocks,s.size);
+        store_close(&s);
+    }
+    return 0;
+}
+
+static int run_lookup(uint64_t n, const char *file)
+{
+    STORE s;
+    store_open(&s,file);
+    bool found = store_contains(&s,n);
+    store_close(&s);
+    if (found)
+        printf("%lu\n",n);
+    return found ? 0 : 1;
+}
+
+static int run_range(uint64_t min, uint64_t max, const char *file)
+{
+    STORE s;
+    store_open(&s,file);
+    CURSOR c;
+    cursor_seek(&c,&s,min);
+    while (c.has_value && c.value <= max)
+    {
+        printf("%lu\n",c.value);
+        cursor_advance(&c);
+    }
+    store_close(&s);
+    return 0;
+}
+
+static int run_bases(uint64_t n, const char **files, uint32_t nfiles)
+{
+    for (uint32_t i = 0; i < nfiles; ++i)
+    {
+        STORE s;
+        store_open(&s,files[i]);
+        if (store_contains(&s,n))
+            printf("%u\n",s.base);
+        store_close(&s);
+    }
+    return 0;
+}
+
+/*
+    Intersection, a k-way merge heap over cursors like the one in
+    sorted_diff, counting the length of each run of equal values
+*/
+
+CURSOR *_cur;
+uint32_t *_heap;
+uint32_t _hsize = 0;
+
+static void heap_push(uint32_t i)
+{
+    uint32_t c = _hsize++, p;
+    _heap[c] = i;
+    while (c && _cur[_heap[p = (c-1)/2]].value > _cur[_heap[c]].value)
+    {
+        uint32_t t = _heap[p];
+        _heap[p] = _heap[c];
+        _heap[c] = t;
+        c = p;
+    }
+}
+
+static void heap_sift(void)
+{
+    uint32_t p = 0;
+    for (;;)
+    {
+        uint32_t c = 2*p+1;
+        if (c >= _hsize)
+            break;
+        if (c+1 < _hsize && _cur[_heap[c+1]].value < _cur[_heap[c]].value)
+            ++c;
+        if (_cur[_heap[p]].value <= _cur[_heap[c]].value)
+            break;
+        uint32_t t = _heap[p];
+        _heap[p] = _heap[c];
+        _heap[c] = t;
+        p = c;
+    }
+}
+
+static int run_intersect(uint32_t k, const char **files, uint32_t nfiles)
+{
+    STORE *stores = (STORE*)malloc(nfiles*sizeof(*stores));
+    _cur = (CURSOR*)malloc(nfiles*sizeof(*_cur));
+    _heap = (uint32_t*)malloc(nfiles*sizeof(*_heap));
+    uint32_t *run = (uint32_t*)malloc(nfiles*sizeof(*run));
+    for (uint32_t i = 0; i < nfiles; ++i)
+    {
+        store_open(stores+i,files[i]);
+        _cur[i].s = stores+i;
+        cursor_block(_cur+i,0);
+        if (_cur[i].has_value)
+            heap_push(i);
+    }
+    while (_hsize)
+    {
+        // pop the whole run of the smallest value, remembering its stores
+        uint64_t v = _cur[_heap[0]].value;
+        uint32_t n = 0;
+        while (_hsize && _cur[_heap[0]].value == v)
+        {
+            uint32_t i = _heap[0];
+            run[n++] = i;
+            cursor_advance(_cur+i);
+            if (!_cur[i].has_value)
+                _heap[0] = _heap[--_hsize];
+            heap_sift();
+        }
+        if (n >= k)
+        {
+            // bases ascending, the heap pops ties in arbitrary order
+            for (uint32_t j = 1; j < n; ++j)
+                for (uint32_t l = j; l
+                  && stores[run[l]].base < stores[run[l-1]].base; --l)
+                {
+                    uint32_t t = run[l];
+                    run[l] = run[l-1];
+                    run[l-1] = t;
+                }
+            printf("%lu %u",v,n);
+            for (uint32_t j = 0; j < n; ++j)
+                printf(" %u",stores[run[j]].base);
+            printf("\n");
+        }
+    }
+    for (uint32_t i = 0; i < nfiles; ++i)
+        store_close(stores+i);
+    free(stores);
+    free(_cur);
+    free(_heap);
+    free(run);
+    return 0;
+}
+
+void usage()
+{
+    fprintf(stderr,"./pp_store build <store> <base> <input> [-b]\n");
+    fprintf(stderr,"./pp_store info <store> [store...]\n");
+    fprintf(stderr,"./pp_store lookup <n> <store>\n");
+    fprintf(stderr,"./pp_store range <min> <max> <store>\n");
+    fprintf(stderr,"./pp_store bases <n> <store> [store...]\n");
+    fprintf(stderr,"./pp_store intersect <k> <store> [store...]\n");
+}
+
+int main(int argc, char **argv)
+{
+    bool binary = false;
+    const char **args = (const char**)malloc(argc*sizeof(*args));
+    uint32_t nargs = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i],"-b"))
+            binary = true;
+        else
+            args[nargs++] = argv[i];
+    }
+    if (nargs == 0)
+    {
+        usage();
+        return 0;
+    }
+    const char *cmd = args[0];
+    if (!strcmp(cmd,"build") && nargs == 4)
+    {
+        uint32_t base = atoi(args[2]);
+        if (base < 2)
+        {
+            fprintf(stderr,"invalid base %s\n",args[2]);
+            return 1;
+        }
+        return run_build(args[1],base,args[3],binary);
+    }
+    if (!strcmp(cmd,"info") && nargs >= 2)
+        return run_info(args+1,nargs-1);
+    if (!strcmp(cmd,"lookup") && nargs == 3)
+        return run_lookup(strtoul(args[1],NULL,10),args[2]);
+    if (!strcmp(cmd,"range") && nargs == 4)
+        return run_range(strtoul(args[1],NULL,10),
+            strtoul(args[2],NULL,10),args[3]);
+    if (!strcmp(cmd,"bases") && nargs >= 3)
+        return run_bases(strtoul(args[1],NULL,10),args+2,nargs-2);
+    if (!strcmp(cmd,"intersect") && nargs >= 3)
+        return run_intersect(atoi(args[1]),args+2,nargs-2);
+    usage();
+    return 0;
+}
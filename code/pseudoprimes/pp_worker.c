@@ -0,0 +1,151 @@
+/*
+    Worker for distributed pseudoprime scans, the other half of pp_coord.
+    Connects to the coordinator, requests (base, range) leases, runs the
+    local pp binary in --binary mode for each lease and streams the result
+    values back with a completion acknowledgment. Exits when the
+    coordinator reports the run complete. Losing a worker only loses its
+    current lease, which the coordinator re-issues.
+
+    usage: ./pp_worker <host> <port> [pp_path]
+
+    pp_path defaults to ./pp and may include extra leading arguments since
+    the command is run through the shell, so "./pp_worker host 5077
+    'nice ./pp'" or a wrapper adding -t works. The pp output is buffered
+    in memory per lease and the trailing end sentinel is verified before
+    upload, so a crashed or truncated scan never acks its lease.
+*/
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// read all of a pp --binary run into a growable buffer, returns the byte
+// length including the end sentinel, exits on scan failure
+size_t run_scan(const char *pp_path, uint64_t base, uint64_t min,
+                uint64_t max, const char *type, char **data_out)
+{
+    char cmd[1024];
+    snprintf(cmd,sizeof(cmd),"%s %lu %lu %lu %s --binary",
+        pp_path,min,max,base,type);
+    FILE *p = popen(cmd,"r");
+    if (!p)
+    {
+        fprintf(stderr,"error running %s\n",cmd);
+        exit(1);
+    }
+    size_t len = 0, alloc = 1<<16;
+    char *data = (char*)malloc(alloc);
+    size_t r;
+    while ((r = fread(data+len,1,alloc-len,p)))
+    {
+        len += r;
+        if (len == alloc)
+        {
+            alloc *= 2;
+            data = (char*)realloc(data,alloc);
+        }
+    }
+    if (pclose(p) != 0)
+    {
+        fprintf(stderr,"scan failed: %s\n",cmd);
+        exit(1);
+    }
+    uint64_t end;
+    if (len < 8 || len%8 != 0
+        || (memcpy(&end,data+len-8,8), end != UINT64_MAX))
+    {
+        fprintf(stderr,"truncated scan output: %s\n",cmd);
+        exit(1);
+    }
+    *data_out = data;
+    return len;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr,"./pp_worker <host> <port> [pp_path]\n");
+        return 0;
+    }
+    const char *host = argv[1];
+    int port = atoi(argv[2]);
+    const char *pp_path = argc > 3 ? argv[3] : "./pp";
+    signal(SIGPIPE,SIG_IGN);
+    struct hostent *he = gethostbyname(host);
+    if (!he)
+    {
+        fprintf(stderr,"unknown host %s\n",host);
+        exit(1);
+    }
+    struct sockaddr_in addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sin_family = AF_INET;
+    memcpy(&addr.sin_addr,he->h_addr_list[0],he->h_length);
+    addr.sin_port = htons(port);
+    int fd = socket(AF_INET,SOCK_STREAM,0);
+    if (connect(fd,(struct sockaddr*)&addr,sizeof(addr)) != 0)
+    {
+        fprintf(stderr,"unable to connect to %s:%d\n",host,port);
+        exit(1);
+    }
+    FILE *in = fdopen(fd,"r");
+    FILE *out = fdopen(dup(fd),"w");
+    char line[256];
+    for (;;)
+    {
+        fprintf(out,"next\n");
+        fflush(out);
+        if (!fgets(line,sizeof(line),in))
+        {
+            fprintf(stderr,"lost connection to coordinator\n");
+            exit(1);
+        }
+        if (strcmp(line,"shutdown\n") == 0)
+            break;
+        if (strcmp(line,"wait\n") == 0)
+        {
+            sleep(5);
+            continue;
+        }
+        int64_t id;
+        uint64_t base, min, max;
+        char type[16];
+        if (sscanf(line,"lease %ld %lu %lu %lu %15s",
+                &id,&base,&min,&max,type) != 5)
+        {
+            fprintf(stderr,"bad coordinator message: %s",line);
+            exit(1);
+        }
+        fprintf(stderr,"# lease %ld: base %lu range %lu-%lu %s\n",
+            id,base,min,max,type);
+        char *data;
+        size_t len = run_scan(pp_path,base,min,max,type,&data);
+        // the coordinator stores values only, drop the verified sentinel
+        fprintf(out,"result %ld %lu\n",id,len-8);
+        fwrite(data,1,len-8,out);
+        fflush(out);
+        free(data);
+        if (!fgets(line,sizeof(line),in))
+        {
+            fprintf(stderr,"lost connection to coordinator\n");
+            exit(1);
+        }
+        int64_t ackid;
+        if (sscanf(line,"ack %ld",&ackid) != 1 || ackid != id)
+        {
+            fprintf(stderr,"bad coordinator message: %s",line);
+            exit(1);
+        }
+    }
+    fclose(in);
+    fclose(out);
+    return 0;
+}
@@ -3,9 +3,21 @@
     Output consists of "<%lu" lines for left stream and ">%lu" lines for right
     stream. The "<" or ">" indicates which stream it came from and %lu is the
     number.
-    
+
     This program is slightly modified for the Fermat pseudoprimes use case. It
     expects both streams to end with a line containing "done".
+
+    Modes (flags may appear anywhere on the command line):
+    -b  streams are binary: raw little endian uint64 values terminated by a
+        0xffffffffffffffff sentinel (the --binary output of pp/fpp). The
+        readers are block buffered, fscanf text parsing tops out well below
+        disk bandwidth and was the bottleneck of the comparison pipeline.
+    -m  k-way merge instead of diff: any number of input files are merged
+        into one sorted stream on stdout (duplicates collapse), binary in
+        and out with -b, text in and out otherwise. This reconciles a full
+        catalog of per base runs against one prime list in a single pass.
+    Diff output stays text either way so the downstream scripts are
+    unchanged.
 */
 
 #include <assert.h>
@@ -15,11 +27,19 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define RBUF_VALUES 8192 // values per read block (64 KiB per stream)
+#define WBUF_VALUES 8192
+#define BIN_END UINT64_MAX // sentinel ending a binary stream, values are 63 bit
+
 typedef struct
 {
     FILE *stream;
     uint64_t next;
     bool has_next;
+    bool binary;
+    bool ended; // binary only, the sentinel was seen
+    uint32_t pos, len; // binary read buffer position
+    uint64_t buf[RBUF_VALUES];
 }
 STREAM_STATE;
 
@@ -27,33 +47,219 @@ STREAM_STATE;
 static inline void advance(STREAM_STATE *ss)
 {
     assert(ss->has_next);
-    ss->has_next = fscanf(ss->stream,"%lu",&(ss->next)) == 1;
+    if (!ss->binary)
+    {
+        ss->has_next = fscanf(ss->stream,"%lu",&(ss->next)) == 1;
+        return;
+    }
+    if (ss->pos == ss->len)
+    {
+        ss->len = fread(ss->buf,sizeof(uint64_t),RBUF_VALUES,ss->stream);
+        ss->pos = 0;
+        if (ss->len == 0)
+        {
+            ss->has_next = false; // ended stays false, missing sentinel
+            return;
+        }
+    }
+    uint64_t v = ss->buf[ss->pos++];
+    if (v == BIN_END)
+    {
+        ss->has_next = false;
+        ss->ended = true;
+    }
+    else
+        ss->next = v;
+}
+
+// open a stream ("-" for stdin) and read its first value
+static bool stream_open(STREAM_STATE *ss, const char *name, bool binary)
+{
+    if (!strcmp(name,"-"))
+        ss->stream = stdin;
+    else
+        ss->stream = fopen(name,binary ? "rb" : "r");
+    if (!ss->stream)
+        return false;
+    ss->binary = binary;
+    ss->ended = false;
+    ss->pos = ss->len = 0;
+    ss->has_next = true;
+    advance(ss);
+    return true;
+}
+
+// check the end of stream marker, 0 = ok, 1 = read error, 2 = wrong value
+static int check_done(STREAM_STATE *ss)
+{
+    if (ss->binary)
+        return ss->ended ? 0 : 2;
+    char *line = NULL;
+    size_t len = 0;
+    int ret;
+    if (getline(&line,&len,ss->stream) == -1)
+        ret = 1;
+    else
+        ret = strcmp(line,"done\n") ? 2 : 0;
+    free(line);
+    return ret;
+}
+
+// buffered binary output for merge mode
+uint64_t _wbuf[WBUF_VALUES];
+uint32_t _wlen = 0;
+
+static inline void wflush(void)
+{
+    fwrite(_wbuf,sizeof(uint64_t),_wlen,stdout);
+    _wlen = 0;
+}
+
+static inline void wvalue(uint64_t v)
+{
+    _wbuf[_wlen] = v;
+    if (++_wlen == WBUF_VALUES)
+        wflush();
+}
+
+/*
+    k-way merge heap, a min heap of stream indexes keyed by the next value.
+    Ties between streams can pop in either order since equal values collapse
+    to one output value anyway.
+*/
+STREAM_STATE *_ss;
+uint32_t *_heap;
+uint32_t _hsize = 0;
+
+static void heap_push(uint32_t i)
+{
+    uint32_t c = _hsize++, p;
+    _heap[c] = i;
+    while (c && _ss[_heap[p = (c-1)/2]].next > _ss[_heap[c]].next)
+    {
+        uint32_t t = _heap[p];
+        _heap[p] = _heap[c];
+        _heap[c] = t;
+        c = p;
+    }
+}
+
+// restore the heap after the root's next value grew (or after the root was
+// replaced by the last element because its stream ran out)
+static void heap_sift(void)
+{
+    uint32_t p = 0;
+    for (;;)
+    {
+        uint32_t c = 2*p+1;
+        if (c >= _hsize)
+            break;
+        if (c+1 < _hsize && _ss[_heap[c+1]].next < _ss[_heap[c]].next)
+            ++c;
+        if (_ss[_heap[p]].next <= _ss[_heap[c]].next)
+            break;
+        uint32_t t = _heap[p];
+        _heap[p] = _heap[c];
+        _heap[c] = t;
+        p = c;
+    }
+}
+
+static int run_merge(const char **files, uint32_t nfiles, bool binary)
+{
+    _ss = (STREAM_STATE*)malloc(nfiles*sizeof(*_ss));
+    _heap = (uint32_t*)malloc(nfiles*sizeof(*_heap));
+    for (uint32_t i = 0; i < nfiles; ++i)
+    {
+        if (!stream_open(_ss+i,files[i],binary))
+        {
+            fprintf(stderr,"error opening: %s\n",files[i]);
+            return 1;
+        }
+        if (_ss[i].has_next)
+            heap_push(i);
+    }
+    uint64_t last = 0;
+    bool first = true;
+    while (_hsize)
+    {
+        uint32_t i = _heap[0];
+        uint64_t v = _ss[i].next;
+        if (first || v != last) // duplicates collapse
+        {
+            if (binary)
+                wvalue(v);
+            else
+                printf("%lu\n",v);
+            last = v;
+            first = false;
+        }
+        advance(_ss+i);
+        if (!_ss[i].has_next)
+            _heap[0] = _heap[--_hsize];
+        heap_sift();
+    }
+    // all inputs must have ended with their marker
+    int status = 0;
+    for (uint32_t i = 0; i < nfiles; ++i)
+    {
+        int d = check_done(_ss+i);
+        if (d > status)
+            status = d;
+        fclose(_ss[i].stream);
+    }
+    if (binary)
+    {
+        // the sentinel is only written for a clean merge so a truncated or
+        // markerless input is visible downstream
+        if (status == 0)
+            wvalue(BIN_END);
+        wflush();
+        if (status != 0)
+            fprintf(stderr,"merge input missing end marker\n");
+        return status != 0;
+    }
+    if (status == 0)
+        printf("done\n");
+    else if (status == 1)
+        printf("error(reading)\n");
+    else
+        printf("error(values)\n");
+    return 0;
 }
 
 int main(int argc, char **argv)
 {
-    if (argc < 3)
+    bool binary = false, merge = false;
+    const char **files = (const char**)malloc(argc*sizeof(*files));
+    uint32_t nfiles = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i],"-b"))
+            binary = true;
+        else if (!strcmp(argv[i],"-m"))
+            merge = true;
+        else
+            files[nfiles++] = argv[i];
+    }
+    if (merge ? nfiles < 1 : nfiles != 2)
     {
-        fprintf(stderr,"./a.out <left> <right>\n");
+        fprintf(stderr,"./a.out [-b] <left> <right>\n");
+        fprintf(stderr,"./a.out -m [-b] <file> [file...]\n");
         fprintf(stderr,"use \"-\" for stdin\n");
         return 0;
     }
-    if (!strcmp(argv[1],argv[2])) return 0; // same file
+    if (merge)
+        return run_merge(files,nfiles,binary);
+    if (!strcmp(files[0],files[1])) return 0; // same file
     STREAM_STATE L, R;
     L.stream = R.stream = NULL;
-    if (!strcmp(argv[1],"-")) L.stream = stdin;
-    else L.stream = fopen(argv[1],"r");
-    if (!strcmp(argv[2],"-")) R.stream = stdin;
-    else R.stream = fopen(argv[2],"r");
-    if (!L.stream || !R.stream)
+    if (!stream_open(&L,files[0],binary) | !stream_open(&R,files[1],binary))
     {
-        if (!L.stream) fprintf(stderr,"error opening: %s\n",argv[1]);
-        if (!R.stream) fprintf(stderr,"error opening: %s\n",argv[2]);
+        if (!L.stream) fprintf(stderr,"error opening: %s\n",files[0]);
+        if (!R.stream) fprintf(stderr,"error opening: %s\n",files[1]);
         return 1;
     }
-    // setup stream initial states
-    L.has_next = fscanf(L.stream,"%lu",&L.next) == 1;
-    R.has_next = fscanf(R.stream,"%lu",&R.next) == 1;
     while (L.has_next && R.has_next)
     {
         if (L.next < R.next)
@@ -83,18 +289,14 @@ int main(int argc, char **argv)
         printf(">%lu\n",R.next);
         advance(&R);
     }
-    char *doneL = NULL, *doneR = NULL;
-    size_t lenL = 0, lenR = 0;
-    // check for last line with "done"
-    if (getline(&doneL,&lenL,L.stream) == -1
-        || getline(&doneR,&lenR,R.stream) == -1)
+    // check for the end markers ("done" line or binary sentinel)
+    int dl = check_done(&L), dr = check_done(&R);
+    if (dl == 1 || dr == 1)
         printf("error(reading)\n");
-    else if (!strcmp(doneL,"done\n") && !strcmp(doneR,"done\n"))
+    else if (dl == 0 && dr == 0)
         printf("done\n");
     else
         printf("error(values)\n");
-    if (doneL) free(doneL);
-    if (doneR) free(doneR);
     fclose(L.stream);
     fclose(R.stream);
     return 0;
@@ -0,0 +1,220 @@
+/*
+    Base table for the hashed single test 32 bit primality path in
+    functions.h. The bucket of n is SPRP32_HASH(n) (top 12 bits of a Knuth
+    multiplicative hash) and the property is: every odd n < 2^32 with no
+    prime factor below 64 is classified correctly by one strong Fermat test
+    to its bucket's base. Built by iterating over all such n: misclassified
+    numbers (against the deterministic {2,7,61} ground truth) are recorded
+    and their bucket's base is bumped to the smallest one classifying all
+    recorded violators, until a full rescan of the changed buckets finds no
+    new violators (7 passes, 2101 violators after the initial all base 2
+    table, largest base needed 20). Do not edit by hand.
+*/
+static const uint16_t _sprp32_bases[4096] =
+{
+    3,5,5,2,2,6,2,3,3,3,7,2,2,5,2,2,2,2,2,2,
+    3,2,2,6,2,2,2,2,2,6,5,3,2,3,3,3,6,2,5,2,
+    2,5,2,2,2,2,2,2,2,3,2,2,3,3,2,2,2,2,3,3,
+    3,2,2,2,3,2,3,2,2,2,3,3,7,2,5,2,5,2,5,2,
+    2,5,2,6,2,2,3,5,2,3,3,2,3,2,3,2,2,5,5,2,
+    3,5,2,2,2,6,3,2,2,2,2,3,2,2,2,5,2,5,3,5,
+    2,2,5,5,5,2,2,2,2,6,2,3,5,2,2,2,5,5,2,2,
+    3,3,2,5,3,2,2,2,5,3,3,5,2,3,2,3,2,2,2,2,
+    3,2,2,3,2,6,3,6,3,2,5,3,2,2,3,2,2,3,2,2,
+    2,5,2,3,3,11,2,2,6,2,2,3,12,3,2,3,2,3,2,2,
+    2,6,2,6,2,3,2,2,11,2,2,2,2,7,2,3,2,2,2,2,
+    2,5,2,2,5,2,2,3,5,2,3,2,7,3,3,5,2,3,2,2,
+    2,3,3,2,7,5,3,5,2,3,5,2,2,2,2,2,2,2,2,2,
+    6,2,5,2,2,2,2,3,2,2,2,5,2,2,2,2,2,3,2,5,
+    2,6,2,5,2,2,3,5,6,2,5,2,3,2,2,2,2,5,2,2,
+    3,2,3,2,7,3,7,3,2,2,3,3,2,5,5,2,3,2,2,2,
+    2,3,3,2,2,2,2,3,2,3,6,2,3,2,2,2,3,5,2,6,
+    2,2,2,3,2,2,6,2,2,2,2,3,3,3,2,2,2,2,2,2,
+    2,6,2,2,2,2,2,2,2,2,2,2,2,2,5,6,5,3,2,3,
+    2,2,3,2,2,2,2,5,3,2,2,3,3,2,2,2,3,6,2,2,
+    6,2,5,2,5,5,2,2,7,2,2,2,2,2,2,2,3,10,2,3,
+    3,2,2,2,5,2,2,5,5,5,2,2,2,6,2,2,5,2,2,2,
+    2,11,2,2,3,6,2,3,3,2,2,2,5,3,3,2,6,2,2,3,
+    3,2,3,7,2,3,2,3,3,3,2,3,2,2,5,3,6,3,2,2,
+    2,3,2,2,7,2,2,2,2,2,7,2,2,5,2,2,6,2,3,2,
+    3,2,2,3,5,2,2,2,2,2,5,2,12,2,2,2,2,2,2,3,
+    3,3,3,2,2,2,2,2,2,2,2,5,3,2,3,2,2,6,2,2,
+    2,3,2,2,2,7,2,2,2,2,2,2,2,2,3,2,2,2,2,3,
+    3,2,2,6,3,2,2,5,3,2,3,2,2,5,2,2,5,2,2,2,
+    5,5,2,2,3,5,5,10,6,3,3,3,2,2,2,5,11,2,3,5,
+    2,2,3,5,2,2,2,2,3,3,2,2,5,2,2,3,2,5,2,2,
+    3,2,3,2,3,2,2,2,3,2,2,2,2,2,5,3,3,2,2,2,
+    2,3,3,2,7,2,3,6,3,5,3,2,2,2,3,2,3,2,3,3,
+    2,2,2,2,5,2,5,2,5,2,5,6,2,7,2,2,5,2,2,2,
+    2,2,2,2,2,2,2,3,2,2,2,3,2,2,3,2,3,2,6,2,
+    2,2,2,3,3,2,5,3,3,2,2,5,2,2,2,3,6,5,3,7,
+    3,5,3,3,2,3,5,2,2,2,3,2,3,2,2,2,2,6,3,2,
+    3,2,2,3,2,10,10,2,2,3,5,2,2,2,5,2,2,3,2,3,
+    3,2,2,2,5,2,2,2,5,6,2,6,3,3,3,3,5,3,3,5,
+    2,2,2,2,2,2,2,2,2,3,2,5,3,2,2,2,5,2,3,2,
+    6,10,2,2,2,3,3,10,2,3,2,3,2,2,3,2,2,2,2,2,
+    2,2,2,2,2,7,6,5,3,5,2,2,2,2,2,2,2,3,2,2,
+    3,2,2,3,2,3,3,3,2,5,2,5,3,3,2,5,2,3,2,7,
+    2,2,2,2,3,10,3,2,2,2,2,6,2,2,2,2,2,2,3,3,
+    2,2,2,2,7,2,2,2,2,3,2,2,5,5,3,2,2,2,2,2,
+    2,2,2,2,2,2,2,3,2,2,2,2,2,2,2,2,2,3,2,2,
+    2,2,2,2,2,3,10,2,2,2,2,5,2,2,2,3,2,3,3,5,
+    2,5,2,2,2,2,2,2,2,6,2,2,6,3,2,2,2,2,3,2,
+    7,5,2,2,3,2,6,5,3,3,5,2,3,2,2,2,3,5,2,3,
+    2,2,2,7,2,3,2,2,6,2,2,3,5,3,2,5,2,3,2,2,
+    2,3,2,7,2,2,5,3,2,2,5,2,3,2,3,2,2,2,3,2,
+    3,3,2,2,2,2,2,2,2,3,2,2,10,2,3,2,2,5,2,6,
+    2,2,2,2,2,5,2,2,5,2,3,2,2,2,2,2,3,2,2,2,
+    2,5,3,5,2,5,3,2,2,2,3,6,2,2,6,2,3,10,2,2,
+    5,2,2,2,2,3,7,3,2,5,2,3,2,2,2,2,2,2,3,2,
+    2,5,2,2,11,2,3,2,5,2,5,3,2,2,2,2,2,2,5,2,
+    7,2,5,3,2,2,3,2,2,2,3,3,2,2,2,2,3,2,5,6,
+    7,2,2,2,2,2,2,2,2,3,3,2,2,2,3,3,2,3,5,2,
+    10,6,2,5,2,2,2,5,2,2,2,3,2,2,2,3,3,3,3,2,
+    2,3,6,2,2,2,2,2,2,2,3,3,2,2,2,3,6,3,3,3,
+    2,2,3,2,10,5,2,2,3,2,2,2,2,2,3,5,2,2,2,20,
+    2,2,2,3,5,2,2,2,2,3,5,2,2,2,3,2,3,3,2,2,
+    2,2,2,2,3,10,3,3,2,5,2,5,3,2,2,5,12,2,2,2,
+    3,3,7,6,3,2,2,2,6,2,3,2,2,2,2,3,2,3,2,2,
+    2,2,2,3,2,2,2,3,2,2,2,6,3,3,2,2,5,2,2,5,
+    2,5,2,2,2,3,3,2,5,2,2,2,2,2,5,10,2,2,2,6,
+    2,2,3,2,2,3,2,7,2,2,3,2,2,7,2,2,3,3,2,5,
+    2,2,5,5,2,2,2,2,2,2,2,2,5,2,5,6,2,2,5,2,
+    2,5,2,2,2,3,6,3,5,2,2,2,2,2,5,5,7,5,6,3,
+    3,2,2,3,3,2,2,2,5,2,2,2,2,2,3,2,2,2,2,2,
+    3,5,3,5,2,2,6,2,2,2,3,2,2,2,2,2,10,2,2,2,
+    2,2,5,2,2,3,5,6,3,2,2,2,2,6,6,2,2,10,5,3,
+    2,2,6,2,5,3,3,2,2,2,2,10,3,2,2,2,2,2,3,2,
+    3,5,2,2,3,2,3,2,2,2,2,2,2,2,3,3,2,2,3,2,
+    2,5,5,2,3,2,6,3,2,3,5,2,2,2,2,2,5,7,7,6,
+    2,2,7,11,5,2,3,5,2,7,2,2,2,7,2,5,5,10,2,7,
+    2,2,3,2,7,3,2,3,2,5,6,5,6,2,3,3,2,2,2,5,
+    2,2,2,2,3,2,2,3,2,2,5,5,3,2,2,2,5,7,3,6,
+    5,3,3,6,3,6,3,2,2,3,2,3,2,3,2,3,3,3,2,3,
+    2,3,2,2,2,2,2,2,2,2,2,2,2,2,3,2,5,5,2,3,
+    2,2,2,3,2,5,2,7,2,2,2,2,2,2,6,5,2,5,2,5,
+    3,2,2,2,2,2,2,3,2,2,2,2,2,2,2,5,5,6,2,2,
+    2,10,5,3,2,5,3,2,2,5,2,2,2,5,3,2,2,3,2,3,
+    2,2,2,3,2,6,2,3,2,2,3,2,3,2,5,2,3,2,2,2,
+    5,3,2,3,5,2,6,2,2,2,2,2,2,5,6,3,2,2,6,2,
+    3,2,2,2,2,2,2,5,2,3,2,2,3,2,2,2,2,3,2,6,
+    7,2,3,2,2,2,6,2,2,3,3,2,2,3,2,6,5,2,2,3,
+    2,2,2,2,2,3,5,5,3,2,2,3,2,2,2,2,2,2,2,5,
+    5,2,2,2,5,3,2,3,3,2,3,2,3,3,2,2,5,2,2,2,
+    2,5,2,2,5,3,2,2,7,2,2,2,2,2,2,2,3,5,6,6,
+    2,2,3,2,2,3,2,2,5,2,2,5,2,5,7,2,2,3,2,2,
+    2,3,2,2,2,2,2,2,2,2,2,3,5,2,2,2,3,5,2,2,
+    2,2,2,2,7,2,2,11,3,2,2,2,2,6,2,3,3,2,2,2,
+    2,2,2,6,2,2,3,2,5,2,3,2,7,2,2,5,2,5,2,3,
+    2,2,2,3,3,3,2,6,2,2,7,3,2,2,2,2,2,5,2,3,
+    5,2,3,2,3,5,2,5,3,2,6,2,5,2,3,2,2,3,2,5,
+    5,11,3,5,3,2,2,3,2,2,6,2,3,5,2,3,2,2,2,3,
+    2,3,2,3,2,3,2,5,3,3,2,2,2,2,2,2,2,2,3,2,
+    2,3,5,2,2,11,3,2,2,2,12,3,2,2,2,3,2,5,2,2,
+    2,3,2,2,2,2,2,2,5,2,2,3,2,2,3,2,2,2,2,2,
+    2,2,5,5,5,5,2,5,3,3,3,5,2,2,3,2,2,2,2,3,
+    2,2,2,2,2,3,2,5,6,6,2,5,2,7,2,3,3,3,7,3,
+    2,6,2,3,2,2,2,2,2,3,2,2,3,2,2,2,2,2,3,2,
+    2,2,2,5,6,2,3,2,3,3,2,2,2,2,2,2,6,3,2,5,
+    3,5,5,3,2,2,2,3,2,3,5,5,3,2,3,2,2,2,2,5,
+    5,3,3,5,2,3,2,3,11,2,6,2,3,2,2,3,6,2,3,2,
+    2,2,5,2,3,6,3,2,2,2,2,2,2,2,10,2,5,2,3,2,
+    2,3,2,3,2,2,3,2,2,5,2,2,3,3,7,2,2,3,2,7,
+    3,2,2,5,2,2,3,6,2,2,2,3,2,2,2,2,3,6,2,2,
+    3,2,2,2,2,2,6,6,2,7,2,7,2,2,3,2,3,3,3,2,
+    2,5,2,2,5,2,7,7,3,2,2,2,2,2,2,2,2,2,2,2,
+    5,2,12,5,7,6,2,2,2,3,5,3,2,2,2,3,2,3,2,2,
+    2,2,2,2,2,3,3,2,2,3,3,2,6,2,2,3,2,2,2,2,
+    5,6,3,2,2,2,2,2,6,2,2,5,3,2,2,2,5,2,2,2,
+    2,2,6,2,2,2,2,2,2,2,2,2,5,2,2,2,2,2,2,2,
+    3,2,2,3,2,5,2,2,3,2,3,2,2,2,2,5,3,2,2,2,
+    2,3,3,2,2,2,2,2,2,2,2,2,2,3,3,3,3,3,2,6,
+    2,2,2,3,5,2,7,2,2,5,3,3,2,5,10,2,2,2,5,2,
+    2,2,2,10,7,2,3,2,3,2,5,7,2,2,7,2,2,2,2,2,
+    2,2,10,2,6,2,2,2,2,2,2,2,2,2,3,2,6,2,3,2,
+    2,2,2,7,2,3,2,3,2,2,2,3,5,7,3,2,2,2,2,3,
+    3,5,2,3,2,3,6,6,2,3,2,2,2,2,2,2,6,5,2,2,
+    2,2,3,3,3,3,3,6,3,5,2,3,2,2,2,2,5,3,3,2,
+    3,3,2,5,2,2,2,2,2,2,2,2,2,2,2,2,5,2,7,6,
+    2,2,3,2,2,2,2,2,2,2,2,3,2,2,2,3,3,2,2,2,
+    3,6,2,6,5,2,2,2,5,2,2,3,2,2,2,3,2,5,2,2,
+    3,2,2,5,3,5,2,6,2,2,3,2,2,3,6,2,2,6,2,2,
+    5,2,3,2,2,3,2,2,3,3,5,2,2,2,2,2,2,2,2,2,
+    3,6,5,2,3,3,2,2,2,2,2,2,2,5,5,2,5,2,2,2,
+    5,2,2,2,2,3,2,2,5,2,2,2,2,2,3,3,2,5,2,5,
+    3,2,10,3,2,6,2,2,5,3,2,3,2,2,3,3,3,2,2,2,
+    3,3,6,2,2,2,2,2,2,2,2,5,3,3,5,2,5,2,5,2,
+    2,2,2,2,2,2,2,2,7,2,2,2,2,6,3,2,3,7,6,2,
+    2,2,2,2,2,2,2,2,2,2,2,2,3,3,3,2,5,5,3,2,
+    2,3,2,2,5,5,5,2,6,2,2,2,2,3,5,2,7,2,3,3,
+    2,2,2,5,2,2,2,2,5,2,5,3,5,2,5,2,2,10,2,2,
+    2,3,2,6,2,2,5,2,2,2,2,2,2,17,3,2,7,2,3,2,
+    6,3,3,3,2,2,2,2,2,2,2,3,2,3,2,3,5,2,3,5,
+    2,3,3,3,2,6,3,2,3,5,3,3,2,2,2,2,3,2,5,3,
+    2,2,2,2,5,5,5,11,2,2,2,2,2,5,3,5,2,2,7,6,
+    3,2,3,3,3,2,2,3,2,6,2,2,3,2,3,2,2,5,2,2,
+    3,5,2,2,2,2,2,2,2,2,5,2,2,2,2,3,2,2,2,3,
+    2,2,5,2,2,2,3,2,5,3,5,2,3,2,7,2,2,3,2,3,
+    2,2,2,3,2,3,6,2,2,10,3,2,2,3,2,2,2,2,2,2,
+    2,2,2,2,3,3,3,3,2,6,2,6,2,7,2,2,2,2,3,2,
+    2,2,12,2,2,2,2,2,2,2,2,2,2,2,2,2,2,6,2,2,
+    2,10,3,2,2,3,2,5,2,2,11,5,2,2,2,2,3,5,3,2,
+    2,5,2,2,2,3,3,2,3,2,2,11,2,2,3,2,3,2,2,3,
+    2,2,3,2,5,2,3,2,2,3,7,2,3,2,2,2,3,3,3,3,
+    5,2,2,2,2,2,2,7,2,2,2,3,6,2,3,2,3,2,2,2,
+    5,2,2,3,3,3,2,2,6,2,2,2,5,6,2,3,2,2,5,2,
+    2,6,3,2,2,5,2,2,2,2,2,5,6,2,2,2,2,5,2,2,
+    5,3,3,3,2,2,2,3,2,3,2,3,3,2,3,2,3,2,2,3,
+    5,2,2,2,2,2,3,3,3,2,3,2,2,2,2,3,5,2,2,2,
+    2,5,6,2,2,2,3,6,6,2,2,2,2,5,3,6,2,2,3,5,
+    5,2,3,2,3,5,3,2,2,2,2,2,3,2,5,2,7,2,7,11,
+    5,2,6,2,3,2,5,3,5,2,6,2,3,2,10,2,2,6,3,2,
+    2,2,6,2,3,7,2,2,2,3,3,5,2,6,2,5,5,2,2,3,
+    3,2,3,5,2,3,2,3,10,3,2,2,3,2,2,2,2,2,2,2,
+    6,2,3,2,2,2,2,3,2,7,2,2,2,2,2,10,3,2,7,2,
+    2,3,3,3,2,3,2,2,2,2,2,2,3,2,2,2,3,2,2,2,
+    5,2,2,2,2,5,2,2,6,2,5,2,2,2,5,5,2,5,2,3,
+    2,2,2,2,5,5,2,2,6,2,2,2,2,2,2,3,3,2,2,2,
+    3,3,5,2,2,2,2,2,2,2,2,2,5,3,3,6,2,2,2,2,
+    2,3,5,3,2,5,3,2,2,2,2,3,3,2,2,2,2,2,2,2,
+    2,2,2,2,2,2,2,2,3,2,3,2,6,2,2,2,5,7,3,2,
+    3,2,3,2,2,2,3,2,2,2,2,2,2,3,7,2,2,3,2,2,
+    5,5,2,5,3,3,3,2,3,2,2,3,2,2,2,3,5,2,5,7,
+    6,3,2,2,5,2,3,6,3,5,2,2,5,2,2,2,5,2,2,3,
+    2,2,2,5,5,5,2,3,2,2,2,2,2,2,2,2,2,2,2,2,
+    2,3,6,2,3,3,2,2,3,3,6,2,2,2,3,2,11,3,3,2,
+    2,2,2,2,5,2,2,3,3,5,3,3,5,5,2,2,2,2,5,12,
+    2,2,2,2,7,2,5,2,3,3,2,2,2,2,2,3,2,2,5,5,
+    2,3,2,2,2,2,2,5,2,2,5,3,2,3,2,6,2,2,3,2,
+    2,3,2,2,2,2,2,5,2,2,5,5,5,2,2,2,11,3,3,3,
+    3,2,5,2,5,2,3,2,2,3,5,2,15,5,5,2,3,5,2,3,
+    2,7,2,7,5,3,5,2,2,2,2,2,2,2,2,2,5,3,3,2,
+    2,2,5,3,2,2,3,2,5,2,2,2,3,2,2,3,2,2,6,5,
+    5,2,3,2,2,2,2,2,2,2,2,2,2,6,2,2,2,5,2,2,
+    2,2,3,6,3,2,3,2,3,2,3,3,5,2,2,2,2,2,2,6,
+    10,2,3,2,3,2,5,2,5,2,2,5,3,5,2,2,2,2,2,2,
+    2,2,2,2,2,7,2,2,3,2,6,2,6,5,2,2,3,2,2,2,
+    3,3,2,2,2,2,5,2,3,3,2,6,2,3,2,2,2,2,2,2,
+    5,2,5,2,2,2,2,2,6,10,2,5,3,2,2,3,2,2,7,2,
+    2,2,2,3,2,2,2,3,3,3,3,2,3,2,2,5,2,3,6,2,
+    3,2,2,6,6,2,3,2,2,2,2,2,2,3,2,2,5,3,2,3,
+    2,2,2,2,10,3,3,3,2,2,3,5,2,6,2,2,2,2,2,2,
+    2,2,7,3,3,2,2,5,2,2,2,2,2,3,3,6,5,3,2,3,
+    2,5,5,2,5,3,2,2,2,3,2,2,2,2,2,2,3,5,5,5,
+    3,2,2,3,3,2,3,2,2,2,2,2,2,2,2,3,2,3,3,2,
+    3,2,2,2,5,2,3,5,2,2,5,3,3,6,2,2,2,2,5,2,
+    7,2,5,3,2,2,2,2,3,2,5,2,2,2,2,2,2,7,2,2,
+    6,2,2,5,3,2,5,3,2,2,3,2,5,3,2,2,3,2,2,2,
+    3,2,3,2,2,2,2,2,2,2,5,2,2,5,2,2,2,2,3,2,
+    3,2,2,2,2,6,2,2,2,2,3,3,2,7,2,2,2,3,2,3,
+    2,3,2,6,2,3,2,2,5,2,3,5,2,5,2,2,2,6,6,2,
+    5,2,2,7,2,3,2,2,2,2,2,5,5,2,5,7,3,2,2,2,
+    5,2,5,5,3,5,5,2,2,2,2,2,5,2,2,2,2,2,3,3,
+    5,2,2,6,3,3,6,2,11,2,2,5,2,2,2,2,2,3,3,2,
+    2,2,7,2,5,3,2,5,2,2,3,3,3,3,2,2,2,3,2,5,
+    2,2,2,3,7,6,5,10,3,3,2,2,2,5,2,3,6,6,2,3,
+    5,11,5,2,2,3,2,2,2,3,3,2,2,3,2,3,2,2,2,2,
+    2,2,3,2,5,2,3,5,2,5,5,2,2,2,3,6,2,3,2,2,
+    3,2,5,2,3,2,6,2,2,2,3,2,2,3,7,2,2,3,3,5,
+    2,3,10,2,3,2,5,2,5,3,2,7,2,2,3,2
+};
@@ -130,3 +130,42 @@ struct META_LOOP // abstract away boolean parameter from the client
     }
 };
 
+// Same loop unrolling but collecting the coprime candidates into a batch
+// instead of testing them one at a time. The including file must define
+// batch_push(). Use with META_LOOP_BATCH<base>::function(n)
+static inline void batch_push(uint64_t n);
+template <uint64_t i, uint64_t base, bool b> // line inclusion for i
+struct META_LINE_BATCH
+{
+    static inline void function(uint64_t n)
+    {
+        batch_push(n+i);
+    }
+};
+template <uint64_t i, uint64_t base>
+struct META_LINE_BATCH<i,base,false> // do not inline line for value i
+{
+    static inline void function(uint64_t){}
+};
+template <uint64_t i, uint64_t iters, uint64_t base, bool end>
+struct META_LOOP_BATCH_H
+{
+    static inline void function(uint64_t n)
+    {
+        META_LINE_BATCH<i, base, META_GCD<base,i>::result == 1>::function(n);
+        META_LOOP_BATCH_H<i+1,iters,base,i+1==iters>::function(n);
+    }
+};
+template <uint64_t i, uint64_t iters, uint64_t base>
+struct META_LOOP_BATCH_H<i,iters,base,true> // recursion base case
+{
+    static inline void function(uint64_t n){}
+};
+template <uint64_t base>
+struct META_LOOP_BATCH // abstract away boolean parameter from the client
+{
+    static inline void function(uint64_t n)
+    {
+        META_LOOP_BATCH_H<0,META_DPF_PROD<base>::result,base,false>::function(n);
+    }
+};
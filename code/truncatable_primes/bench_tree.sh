@@ -0,0 +1,85 @@
+#!/bin/bash
+
+# End to end benchmark and regression fixtures for tp_tree/tp_stats.
+# Each fixture is a small known tree whose stats hash is verified, so a
+# wrong hash fails immediately (correctness regression) and the timing
+# gives nodes/sec for comparing optimizations without a production run.
+#
+#   ./bench_tree.sh                 run fixtures and print nodes/sec
+#   ./bench_tree.sh save <file>     also store the results as a baseline
+#   ./bench_tree.sh check <file>    compare against a stored baseline,
+#                                   exits 1 on a hash mismatch or a
+#                                   fixture more than 25% slower
+
+MODE=$1
+BASELINE=$2
+
+if [ -n "$MODE" ] && { [ "$MODE" != save -a "$MODE" != check ] || [ -z "$BASELINE" ]; }
+then
+    echo "./bench_tree.sh [save|check <baseline_file>]"
+    exit 0
+fi
+
+# name;tp_stats arguments;expected hash;primes in the tree
+FIXTURES=(
+    "r_b10;-p r -b 10;11796264242578087336;83"
+    "l_b10_l20;-p l -b 10 -l 20;8681692192356973625;4247"
+    "lor_b10_l11;-p lor -b 10 -l 11;9684813412259190873;96852"
+    "lar_b14_l10;-p lar -b 14 -l 10;1431774264251551646;881793"
+)
+
+FAIL=0
+RESULTS=$(mktemp)
+
+for FIXTURE in "${FIXTURES[@]}"
+do
+    IFS=';' read -r NAME ARGS HASH PRIMES <<< "$FIXTURE"
+    T0=$(date +%s%N)
+    OUT=$(./tp_stats $ARGS)
+    T1=$(date +%s%N)
+    GOT=$(echo "$OUT" | grep '# hash' | awk '{print $4}')
+    if [ "$GOT" != "$HASH" ]
+    then
+        echo "$NAME HASH MISMATCH got $GOT expected $HASH"
+        FAIL=1
+        continue
+    fi
+    # nodes/sec from the known prime count of the fixture tree
+    RATE=$(echo "$PRIMES $T0 $T1" | awk '{printf "%.0f",$1/(($3-$2)/1e9)}')
+    printf '%-16s %12s nodes/sec (hash ok)\n' $NAME $RATE
+    echo "$NAME $RATE" >> $RESULTS
+done
+
+if [ $FAIL -ne 0 ]
+then
+    rm $RESULTS
+    echo HASH MISMATCH
+    exit 1
+fi
+
+if [ "$MODE" == save ]
+then
+    cp $RESULTS $BASELINE
+    echo baseline saved to $BASELINE
+elif [ "$MODE" == check ]
+then
+    # a fixture below 1/1.25 of its baseline rate counts as a regression
+    join $BASELINE $RESULTS | awk '
+    {
+        delta = 100*($3/$2 - 1)
+        tag = ($3 < $2/1.25) ? " REGRESSED" : ""
+        printf "%-16s %12s -> %12s %+6.1f%%%s\n",$1,$2,$3,delta,tag
+        if ($3 < $2/1.25) bad = 1
+    }
+    END { exit bad }'
+    if [ $? -ne 0 ]
+    then
+        rm $RESULTS
+        echo REGRESSION against $BASELINE
+        exit 1
+    fi
+    echo no regression against $BASELINE
+fi
+
+rm $RESULTS
+exit 0
@@ -1,7 +1,19 @@
 #!/bin/bash
 echo --- Compiling tp_tree \(-DWRITE_TREE\)
-gcc -Wall -Werror -g -O3 truncprimes.c tp_util.c -lgmp -o tp_tree -DWRITE_TREE
+gcc -Wall -Werror -g -O3 -pthread truncprimes.c tp_util.c -lgmp -o tp_tree -DWRITE_TREE
 echo --- Compiling tp_stats \(-DWRITE_STATS\)
-gcc -Wall -Werror -g -O3 truncprimes.c tp_util.c -lgmp -o tp_stats -DWRITE_STATS
+gcc -Wall -Werror -g -O3 -pthread truncprimes.c tp_util.c -lgmp -o tp_stats -DWRITE_STATS
 echo --- Compiling tree_convert
-gcc -Wall -Werror -g -O3 tree_convert.c -lgmp -o tree_convert
+gcc -Wall -Werror -g -O3 -pthread tree_convert.c -lgmp -o tree_convert
+echo --- Compiling tp_driver
+gcc -Wall -Werror -g -O3 -pthread tp_driver.c -lgmp -o tp_driver
+echo --- Compiling tree_query
+gcc -Wall -Werror -g -O3 tree_query.c tree_reader.c -o tree_query
+echo --- Compiling nums_decode
+gcc -Wall -Werror -g -O3 nums_decode.c -lgmp -o nums_decode
+echo --- Compiling stats_merge
+gcc -Wall -Werror -g -O3 -pthread stats_merge.c -lgmp -o stats_merge
+echo --- Compiling tp_verify
+gcc -Wall -Werror -g -O3 -pthread tp_verify.c tree_reader.c -lgmp -o tp_verify
+echo --- Compiling tp_hash
+gcc -Wall -Werror -g -O3 -pthread tp_hash.c tree_reader.c -lgmp -o tp_hash
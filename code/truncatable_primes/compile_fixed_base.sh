@@ -0,0 +1,14 @@
+#!/bin/bash
+# base specialized builds (-DFIXED_BASE=n), one tp_tree_b<n>/tp_stats_b<n>
+# pair per base with the digit loops unrolled at compile time
+# pass the bases as arguments, default is the ones run at scale
+BASES=${@:-10 12 16 24 36}
+for B in $BASES
+do
+    echo --- Compiling tp_tree_b$B \(-DWRITE_TREE -DFIXED_BASE=$B\)
+    gcc -Wall -Werror -g -O3 -pthread truncprimes.c tp_util.c -lgmp \
+        -o tp_tree_b$B -DWRITE_TREE -DFIXED_BASE=$B
+    echo --- Compiling tp_stats_b$B \(-DWRITE_STATS -DFIXED_BASE=$B\)
+    gcc -Wall -Werror -g -O3 -pthread truncprimes.c tp_util.c -lgmp \
+        -o tp_stats_b$B -DWRITE_STATS -DFIXED_BASE=$B
+done
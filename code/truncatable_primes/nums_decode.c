@@ -0,0 +1,195 @@
+/*
+Decoder for the binary nums file formats of truncprimes (-u binary and
+-u delta). Recovers the text form (base 10, one number per line, pre order)
+so the expensive binary to decimal conversions happen offline instead of on
+the recursion hot path.
+
+usage: ./nums_decode -f <nums_file>
+
+The file is self describing: a header stores the prime type, base and
+minimum length, full records store a number's raw little endian bytes
+prefixed by its digit and byte lengths, and delta records (4 bytes) encode
+a number relative to its recursion parent as a pop count and an append
+number (r/l the digit, lor the digit for left or base+digit for right,
+lar left*base+right). The decoder replays the pre order traversal with a
+stack of ancestor values: a full record replaces every stacked value at
+its digit length or deeper (they belong to finished subtrees), a delta
+record pops to the parent and applies the append.
+*/
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gmp.h>
+
+// command line
+const char *OPTION_STRING = "f:";
+const struct option OPTION_LONG[] =
+{
+    {"file",required_argument,0,'f'},
+    {0,0,0,0}
+};
+
+#define NUMS_MAGIC 0x3130534d554e5054uL // "TPNUMS01"
+
+uint32_t _base;
+uint32_t _ptype; // 0 r, 1 l, 2 lor, 3 lar
+
+// ancestor stack of values with their digit lengths
+mpz_t *_vals;
+uint32_t *_lens;
+uint32_t _sp, _scap;
+
+// powers of the base for the left appends, grown as needed
+mpz_t *_pows;
+uint32_t _plen;
+
+static void ensure_stack(uint32_t need)
+{
+    if (need <= _scap)
+        return;
+    uint32_t cap = _scap ? 2*_scap : 64;
+    if (cap < need)
+        cap = need;
+    _vals = realloc(_vals,cap*sizeof(*_vals));
+    _lens = realloc(_lens,cap*sizeof(*_lens));
+    for (uint32_t i = _scap; i < cap; ++i)
+        mpz_init(_vals[i]);
+    _scap = cap;
+}
+
+static mpz_t *get_power(uint32_t i)
+{
+    if (i >= _plen)
+    {
+        uint32_t plen = 2*(i+1);
+        _pows = realloc(_pows,plen*sizeof(*_pows));
+        if (!_plen)
+            mpz_init_set_ui(_pows[_plen++],1);
+        for (; _plen < plen; ++_plen)
+        {
+            mpz_init(_pows[_plen]);
+            mpz_mul_ui(_pows[_plen],_pows[_plen-1],_base);
+        }
+    }
+    return _pows+i;
+}
+
+void invalid(void)
+{
+    fprintf(stderr,"invalid nums file\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    const char *filename = NULL;
+    int o;
+    while ((o = getopt_long(argc,argv,OPTION_STRING,OPTION_LONG,NULL)) != -1)
+    {
+        if (o == 'f')
+            filename = optarg;
+        else
+        {
+            fprintf(stderr,"./nums_decode -f <nums_file>\n");
+            return 0;
+        }
+    }
+    if (!filename)
+    {
+        fprintf(stderr,"./nums_decode -f <nums_file>\n");
+        return 0;
+    }
+    FILE *f = fopen(filename,"r");
+    if (!f)
+    {
+        fprintf(stderr,"error opening nums file\n");
+        return 1;
+    }
+    uint64_t magic;
+    uint32_t head[4];
+    if (fread(&magic,sizeof(magic),1,f) != 1 || magic != NUMS_MAGIC
+     || fread(head,sizeof(*head),4,f) != 4
+     || head[0] > 3 || head[1] < 2 || head[1] > 255)
+        invalid();
+    _ptype = head[0];
+    _base = head[1];
+    uint32_t mul = _ptype == 3 ? 2 : 1;
+    uint32_t plimit = _ptype == 3 ? _base*_base
+                    : _ptype == 2 ? 2*_base : _base;
+    unsigned char *buf = NULL;
+    size_t buf_alloc = 0;
+    uint16_t tag;
+    while (fread(&tag,sizeof(tag),1,f) == 1)
+    {
+        if (tag == 0xffff) // full record
+        {
+            uint32_t lens[2];
+            if (fread(lens,sizeof(*lens),2,f) != 2 || lens[0] == 0)
+                invalid();
+            if (lens[1] > buf_alloc)
+            {
+                buf_alloc = 2*lens[1];
+                buf = realloc(buf,buf_alloc);
+            }
+            if (fread(buf,1,lens[1],f) != lens[1])
+                invalid();
+            // values at this digit length or deeper are finished subtrees
+            while (_sp && _lens[_sp-1] >= lens[0])
+                --_sp;
+            ensure_stack(_sp+1);
+            mpz_import(_vals[_sp],lens[1],-1,1,0,0,buf);
+            _lens[_sp++] = lens[0];
+        }
+        else // delta record, pop count then append number
+        {
+            uint16_t p;
+            if (fread(&p,sizeof(p),1,f) != 1
+             || tag >= _sp || p == 0 || p >= plimit)
+                invalid();
+            _sp -= tag;
+            ensure_stack(_sp+1);
+            mpz_t *parent = _vals+(_sp-1);
+            mpz_t *v = _vals+_sp;
+            uint32_t plen = _lens[_sp-1];
+            switch (_ptype)
+            {
+            case 0: // right append
+                mpz_mul_ui(*v,*parent,_base);
+                mpz_add_ui(*v,*v,p);
+                break;
+            case 1: // left append
+                mpz_set(*v,*parent);
+                mpz_addmul_ui(*v,*get_power(plen),p);
+                break;
+            case 2: // left (p < base) or right (base + digit) append
+                if (p < _base)
+                {
+                    mpz_set(*v,*parent);
+                    mpz_addmul_ui(*v,*get_power(plen),p);
+                }
+                else
+                {
+                    mpz_mul_ui(*v,*parent,_base);
+                    mpz_add_ui(*v,*v,p-_base);
+                }
+                break;
+            case 3: // left and right append, p = left*base+right
+                mpz_mul_ui(*v,*parent,_base);
+                mpz_add_ui(*v,*v,p%_base);
+                mpz_addmul_ui(*v,*get_power(plen+1),p/_base);
+                break;
+            }
+            _lens[_sp++] = plen + mul;
+        }
+        mpz_out_str(stdout,10,_vals[_sp-1]);
+        printf("\n");
+    }
+    fclose(f);
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,520 @@
+/*
+Native streaming replacement for stats_combine.py. Merges the stats csv
+files of a split run (root.csv for lengths up to the split length, the
+root_#.csv subtree files beyond it) into one table and recombines the
+per subtree hashes so the merged hash is verifiable against a full run.
+
+usage: ./stats_merge <input_dir> <prime_type> <base> <split_len> [threads]
+
+Reads <input_dir>/job_roots_all.txt for the subtree files to add (it
+contains duplicates for left-or-right primes, which are applied once per
+occurrence because the recursion also expands those subtrees once per
+reachable path). Files are streamed one csv row triplet at a time and
+folded into a single table of counts/mins/maxes indexed by digit length
+and child count, so memory stays at one merged table regardless of how
+many files or how large the arbitrary precision values are (the python
+merger builds per file object trees and takes hours and tens of GB for
+base 200 lar). With a thread count > 1 the subtree files are parsed in
+parallel and only the row folding is serialized.
+
+The hash is recombined by redoing the cheap top of the recursion (down
+to the split length plus one level) with the same digit append order and
+HASH_INIT/HASH_UPDATE recurrence as truncprimes.c, substituting each job
+root's subtree hash from its csv file instead of descending further.
+
+Output is written to stdout in the same format as tp_stats.
+*/
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gmp.h>
+
+#define PRIME_TEST(n) mpz_probab_prime_p(n,0)
+
+// hashing recurrence, must match truncprimes.c
+#define HASH_ROT(h) (((h) >> 45) | ((h) << 19))
+#define HASH_UPDATE(h,d,c) ((h)^HASH_ROT(8191*(127*(h)-(d))+(c)))
+
+const char *_dir;
+const char *_prime_type;
+uint32_t _base;
+uint32_t _split;
+uint32_t _mult; // digits appended per recursion level (2 for lar, else 1)
+uint32_t _max_children;
+
+// merged table indexed by digit length, each row has _max_children+1
+// columns with the "all" column at index 0, rows allocated when a file
+// first contributes to that length
+typedef struct
+{
+    uint64_t *counts;
+    mpz_t *pmin, *pmax;
+}
+ROW;
+ROW *_rows;
+uint32_t _nrows;
+pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+
+// job roots in job_roots_all.txt order with the hash from each file
+char **_job_names;
+uint32_t _njobs;
+uint64_t *_job_hashes;
+uint32_t _next_job;
+
+// job root values sorted for lookup during hash recombination
+typedef struct
+{
+    mpz_t value;
+    uint64_t hash;
+}
+JOB_HASH;
+JOB_HASH *_job_map;
+uint32_t _job_map_len;
+
+void parse_error(const char *path)
+{
+    fprintf(stderr,"error parsing stats file %s\n",path);
+    exit(1);
+}
+
+ROW *get_row(uint32_t length)
+{
+    if (length >= _nrows)
+    {
+        uint32_t nrows = 2*(length+1);
+        _rows = realloc(_rows,nrows*sizeof(*_rows));
+        memset(_rows+_nrows,0,(nrows-_nrows)*sizeof(*_rows));
+        _nrows = nrows;
+    }
+    ROW *row = _rows+length;
+    if (!row->counts)
+    {
+        row->counts = calloc(_max_children+1,sizeof(*row->counts));
+        row->pmin = malloc((_max_children+1)*sizeof(*row->pmin));
+        row->pmax = malloc((_max_children+1)*sizeof(*row->pmax));
+        for (uint32_t k = 0; k <= _max_children; ++k)
+        {
+            mpz_init(row->pmin[k]);
+            mpz_init(row->pmax[k]);
+        }
+    }
+    return row;
+}
+
+// fold a value into a min cell, 0 means no primes so the nonzero one wins
+static inline void fold_min(mpz_t acc, const mpz_t x)
+{
+    if (mpz_cmp_ui(acc,0) == 0
+        || (mpz_cmp_ui(x,0) != 0 && mpz_cmp(x,acc) < 0))
+        mpz_set(acc,x);
+}
+
+static inline void fold_max(mpz_t acc, const mpz_t x)
+{
+    if (mpz_cmp(x,acc) > 0)
+        mpz_set(acc,x);
+}
+
+// split a csv line in place, cells[0..ncells-1] point into the buffer
+// returns false if the line does not have exactly ncells cells
+bool split_cells(char *line, char **cells, uint32_t ncells)
+{
+    line[strcspn(line,"\n")] = '\0';
+    uint32_t i = 0;
+    cells[i++] = line;
+    for (char *p = line; *p; ++p)
+        if (*p == ',')
+        {
+            if (i == ncells)
+                return false;
+            *p = '\0';
+            cells[i++] = p+1;
+        }
+    return i == ncells;
+}
+
+// stream one stats csv file into the merged table, keeping only the rows
+// passing the length filter, and return the file's hash property
+// a row triplet (counts, min, max) is parsed with one temporary mpz and
+// folded under the table lock, so concurrent parsers only serialize there
+uint64_t merge_file(const char *path, bool below_split)
+{
+    FILE *f = fopen(path,"r");
+    if (!f)
+    {
+        fprintf(stderr,"error opening stats file %s\n",path);
+        exit(1);
+    }
+    char *lines[3] = {NULL,NULL,NULL};
+    size_t lens[3] = {0,0,0};
+    char **cells = malloc((_max_children+2)*sizeof(*cells));
+    mpz_t cell;
+    mpz_init(cell);
+    uint64_t hash = 0;
+    bool have_hash = false, have_header = false;
+    char key[64], value[64];
+    while (getline(&lines[0],&lens[0],f) != -1)
+    {
+        if (lines[0][0] == '#')
+        {
+            // "# prop = value" comment lines, others (the lor NOTE) skip
+            if (sscanf(lines[0],"# %63s = %63s",key,value) != 2)
+                continue;
+            if ((!strcmp(key,"prime_type") && strcmp(value,_prime_type))
+                || (!strcmp(key,"base")
+                    && strtoul(value,NULL,10) != _base))
+                parse_error(path);
+            if (!strcmp(key,"hash"))
+            {
+                hash = strtoul(value,NULL,10);
+                have_hash = true;
+            }
+            continue;
+        }
+        if (!have_header)
+        {
+            // "digits,all,0,..." table header, checks the column count
+            if (!split_cells(lines[0],cells,_max_children+2)
+                || strcmp(cells[0],"digits") || strcmp(cells[1],"all"))
+                parse_error(path);
+            have_header = true;
+            continue;
+        }
+        // row triplet: counts line then min line then max line
+        if (getline(&lines[1],&lens[1],f) == -1
+            || getline(&lines[2],&lens[2],f) == -1)
+            parse_error(path);
+        uint32_t length = strtoul(lines[0],NULL,10);
+        if (length == 0
+            || (below_split ? length > _split : length <= _split))
+            continue;
+        if (!split_cells(lines[0],cells,_max_children+2))
+            parse_error(path);
+        // _rows may be reallocated by other threads so take a copy of the
+        // row struct under the lock, the cell arrays it points to never move
+        pthread_mutex_lock(&_lock);
+        ROW row = *get_row(length);
+        for (uint32_t k = 0; k <= _max_children; ++k)
+            row.counts[k] += strtoul(cells[k+1],NULL,10);
+        pthread_mutex_unlock(&_lock);
+        for (uint32_t m = 1; m <= 2; ++m) // min line then max line
+        {
+            if (!split_cells(lines[m],cells,_max_children+2)
+                || cells[0][0] != '\0')
+                parse_error(path);
+            mpz_t *acc = m == 1 ? row.pmin : row.pmax;
+            for (uint32_t k = 0; k <= _max_children; ++k)
+            {
+                if (mpz_set_str(cell,cells[k+1],10) != 0)
+                    parse_error(path);
+                pthread_mutex_lock(&_lock);
+                if (m == 1)
+                    fold_min(acc[k],cell);
+                else
+                    fold_max(acc[k],cell);
+                pthread_mutex_unlock(&_lock);
+            }
+        }
+    }
+    if (!have_hash || !have_header)
+        parse_error(path);
+    mpz_clear(cell);
+    free(cells);
+    free(lines[0]);
+    free(lines[1]);
+    free(lines[2]);
+    fclose(f);
+    return hash;
+}
+
+// worker for parallel subtree file merging, claims job indexes in order
+void *merge_worker(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&_lock);
+        uint32_t i = _next_job++;
+        pthread_mutex_unlock(&_lock);
+        if (i >= _njobs)
+            break;
+        char *path = malloc(strlen(_dir)+strlen(_job_names[i])+16);
+        sprintf(path,"%s/root_%s.csv",_dir,_job_names[i]);
+        _job_hashes[i] = merge_file(path,false);
+        free(path);
+    }
+    return NULL;
+}
+
+/*
+Hash recombination, the top of the recursion tree (down to the split
+length plus one level) is cheap so it is redone here with the same digit
+append order as truncprimes.c, a node that is a job root takes the
+subtree hash from its csv file instead of recursing
+*/
+
+mpz_t *_powers; // _powers[i] = base^i
+
+int job_cmp(const void *a, const void *b)
+{
+    return mpz_cmp(((const JOB_HASH*)a)->value,((const JOB_HASH*)b)->value);
+}
+
+// look up a job root's subtree hash, false if the value is not a job root
+bool job_lookup(const mpz_t value, uint64_t *hash)
+{
+    uint32_t lo = 0, hi = _job_map_len;
+    while (lo < hi)
+    {
+        uint32_t mid = (lo+hi)/2;
+        int c = mpz_cmp(value,_job_map[mid].value);
+        if (c == 0)
+        {
+            *hash = _job_map[mid].hash;
+            return true;
+        }
+        if (c < 0)
+            hi = mid;
+        else
+            lo = mid+1;
+    }
+    return false;
+}
+
+// hash of the subtree rooted at a prime value with the given digit length
+uint64_t node_hash(const mpz_t value, uint32_t length)
+{
+    uint64_t h;
+    if (job_lookup(value,&h))
+        return h;
+    h = mpz_get_ui(value)>>1; // HASH_INIT
+    if (length > _split) // children are below the rebuilt tree depth
+        return h;
+    mpz_t child;
+    mpz_init(child);
+    if (!strcmp(_prime_type,"r"))
+        for (uint32_t d = 1; d < _base; ++d)
+        {
+            mpz_mul_ui(child,value,_base);
+            mpz_add_ui(child,child,d);
+            if (PRIME_TEST(child))
+                h = HASH_UPDATE(h,d,node_hash(child,length+1));
+        }
+    else if (!strcmp(_prime_type,"l"))
+        for (uint32_t d = 1; d < _base; ++d)
+        {
+            mpz_set(child,value);
+            mpz_addmul_ui(child,_powers[length],d);
+            if (PRIME_TEST(child))
+                h = HASH_UPDATE(h,d,node_hash(child,length+1));
+        }
+    else if (!strcmp(_prime_type,"lor"))
+    {
+        for (uint32_t d = 1; d < _base; ++d) // append left
+        {
+            mpz_set(child,value);
+            mpz_addmul_ui(child,_powers[length],d);
+            if (PRIME_TEST(child))
+                h = HASH_UPDATE(h,d,node_hash(child,length+1));
+        }
+        for (uint32_t d = 1; d < _base; ++d) // append right
+        {
+            mpz_mul_ui(child,value,_base);
+            mpz_add_ui(child,child,d);
+            if (PRIME_TEST(child))
+                h = HASH_UPDATE(h,(uint64_t)_base+d,
+                    node_hash(child,length+1));
+        }
+    }
+    else // lar
+        for (uint32_t dl = 1; dl < _base; ++dl)
+            for (uint32_t dr = 1; dr < _base; ++dr)
+            {
+                mpz_mul_ui(child,value,_base);
+                mpz_addmul_ui(child,_powers[length+1],dl);
+                mpz_add_ui(child,child,dr);
+                if (PRIME_TEST(child))
+                    h = HASH_UPDATE(h,(uint64_t)dl*_base+dr,
+                        node_hash(child,length+2));
+            }
+    mpz_clear(child);
+    return h;
+}
+
+// hash of the full tree (root 0), the 1 digit root loop and for lar the 2
+// digit root loop after it, mirroring the primes_*_init functions
+uint64_t root_hash(void)
+{
+    uint64_t h = 0;
+    mpz_t root;
+    mpz_init(root);
+    for (uint32_t d = 2; d < _base; ++d)
+    {
+        mpz_set_ui(root,d);
+        if (PRIME_TEST(root))
+            h = HASH_UPDATE(h,d,node_hash(root,1));
+    }
+    if (!strcmp(_prime_type,"lar"))
+        for (uint32_t dl = 1; dl < _base; ++dl)
+            for (uint32_t dr = 0; dr < _base; ++dr)
+            {
+                mpz_set_ui(root,dl*_base+dr);
+                if (PRIME_TEST(root))
+                    h = HASH_UPDATE(h,(uint64_t)dl*_base+dr,
+                        node_hash(root,2));
+            }
+    mpz_clear(root);
+    return h;
+}
+
+// print a merged table row in tp_stats format (counts, min, max lines)
+void print_row(uint32_t length)
+{
+    ROW *row = _rows+length;
+    printf("%u",length);
+    for (uint32_t k = 0; k <= _max_children; ++k)
+        printf(",%lu",row->counts[k]);
+    printf("\n");
+    for (uint32_t m = 1; m <= 2; ++m)
+    {
+        mpz_t *cells = m == 1 ? row->pmin : row->pmax;
+        for (uint32_t k = 0; k <= _max_children; ++k)
+        {
+            printf(",");
+            mpz_out_str(NULL,10,cells[k]);
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 5)
+    {
+        fprintf(stderr,"./stats_merge <input_dir> <prime_type> <base> "
+            "<split_len> [threads]\n");
+        return 0;
+    }
+    _dir = argv[1];
+    _prime_type = argv[2];
+    _base = atoi(argv[3]);
+    _split = atoi(argv[4]);
+    uint32_t threads = argc > 5 ? atoi(argv[5]) : 1;
+    if (strcmp(_prime_type,"r") && strcmp(_prime_type,"l")
+        && strcmp(_prime_type,"lor") && strcmp(_prime_type,"lar"))
+    {
+        fprintf(stderr,"invalid prime type\n");
+        return 0;
+    }
+    if (_base < 2 || _base > 255 || _split < 2 || threads < 1)
+    {
+        fprintf(stderr,"invalid arguments\n");
+        return 0;
+    }
+    _mult = strcmp(_prime_type,"lar") ? 1 : 2;
+    _max_children = _base;
+    if (!strcmp(_prime_type,"lor"))
+        _max_children *= 2;
+    else if (!strcmp(_prime_type,"lar"))
+        _max_children *= _base;
+    // read the job root list (duplicates kept, see the top comment)
+    char *path = malloc(strlen(_dir)+32);
+    sprintf(path,"%s/job_roots_all.txt",_dir);
+    FILE *f = fopen(path,"r");
+    if (!f)
+    {
+        fprintf(stderr,"error opening %s\n",path);
+        exit(1);
+    }
+    char *line = NULL;
+    size_t linelen = 0;
+    uint32_t jobs_alloc = 64;
+    _job_names = malloc(jobs_alloc*sizeof(*_job_names));
+    while (getline(&line,&linelen,f) != -1)
+    {
+        line[strcspn(line,"\n")] = '\0';
+        if (line[0] == '\0')
+            continue;
+        if (_njobs == jobs_alloc)
+        {
+            jobs_alloc *= 2;
+            _job_names = realloc(_job_names,
+                jobs_alloc*sizeof(*_job_names));
+        }
+        _job_names[_njobs++] = strdup(line);
+    }
+    free(line);
+    fclose(f);
+    _job_hashes = malloc(_njobs*sizeof(*_job_hashes));
+    // merge root.csv (lengths up to the split) then the subtree files
+    sprintf(path,"%s/root.csv",_dir);
+    merge_file(path,true);
+    free(path);
+    if (threads == 1)
+        merge_worker(NULL);
+    else
+    {
+        pthread_t *tids = malloc(threads*sizeof(*tids));
+        for (uint32_t i = 0; i < threads; ++i)
+            if (pthread_create(tids+i,NULL,merge_worker,NULL) != 0)
+            {
+                fprintf(stderr,"unable to create thread\n");
+                exit(1);
+            }
+        for (uint32_t i = 0; i < threads; ++i)
+            pthread_join(tids[i],NULL);
+        free(tids);
+    }
+    // build the job root lookup for hash recombination, duplicate roots
+    // (left-or-right) collapse to the same subtree hash
+    _job_map = malloc(_njobs*sizeof(*_job_map));
+    for (uint32_t i = 0; i < _njobs; ++i)
+    {
+        if (mpz_init_set_str(_job_map[i].value,_job_names[i],10) != 0)
+        {
+            fprintf(stderr,"invalid job root %s\n",_job_names[i]);
+            exit(1);
+        }
+        _job_map[i].hash = _job_hashes[i];
+    }
+    qsort(_job_map,_njobs,sizeof(*_job_map),job_cmp);
+    _job_map_len = _njobs;
+    _powers = malloc((_split+3)*sizeof(*_powers));
+    mpz_init_set_ui(_powers[0],1);
+    for (uint32_t i = 1; i < _split+3; ++i)
+    {
+        mpz_init(_powers[i]);
+        mpz_mul_ui(_powers[i],_powers[i-1],_base);
+    }
+    // output the merged table
+    printf("# prime_type = %s\n",_prime_type);
+    printf("# base = %u\n",_base);
+    printf("# root = 0\n");
+    printf("# max_length = 4294967295\n");
+    if (!strcmp(_prime_type,"lor"))
+        printf("# NOTE: counts are not applicable\n");
+    printf("digits,all");
+    for (uint32_t k = 0; k < _max_children; ++k)
+        printf(",%u",k);
+    printf("\n");
+    if (_mult == 2) // lar stats list odd lengths then even lengths
+    {
+        for (uint32_t length = 1; length < _nrows; length += 2)
+            if (_rows[length].counts)
+                print_row(length);
+        for (uint32_t length = 2; length < _nrows; length += 2)
+            if (_rows[length].counts)
+                print_row(length);
+    }
+    else
+        for (uint32_t length = 1; length < _nrows; ++length)
+            if (_rows[length].counts)
+                print_row(length);
+    printf("# hash = %lu\n",root_hash());
+    return 0;
+}
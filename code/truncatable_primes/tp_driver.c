@@ -0,0 +1,803 @@
+/*
+Native job orchestrator for full truncatable prime tree runs.
+
+Replaces the truncprimes_full_tree.sh pipeline (tp_tree + tree_convert +
+num_len_filter.py + sort/uniq + GNU parallel + tree_combine.py) with a single
+driver binary. The driver:
+1. runs tp_tree itself up to the split length and keeps the partial tree in
+   memory (no root.bin on disk)
+2. walks the partial tree to find the subtree job roots, exactly the leaf
+   nodes the shell pipeline would filter out of root.txt, remembering where
+   each leaf's placeholder end byte sits in the byte stream
+3. schedules one tp_tree -r process per job across a worker pool with a
+   shared queue so skewed subtree sizes balance dynamically, reading each
+   job's output through a pipe (no per job temp files)
+4. splices completed jobs into the output file in recursion order, replacing
+   each placeholder end byte with the job bytes after the root marker, the
+   same substitution tree_combine.py performs
+5. journals progress after each splice so an interrupted run can resume
+   without recomputing the finished prefix
+
+Job outputs that complete ahead of the splice cursor wait in memory, so the
+output file only ever grows sequentially; this is what makes the journal a
+single offset. Duplicate lor roots are spliced once per occurrence like the
+job files were.
+
+-b base (--base base)
+    number base, valid range is 2-255, default is 10
+-p type (--prime_type type)
+    prime type, r, l, lor or lar (as in truncprimes)
+-l max_length (--max_length max_length)
+    maximum length in digits to compute, default is unlimited (2^32-1)
+-s split_length (--split_length split_length)
+    digit length at which subtrees become jobs, must be at least 2
+    larger values make more (smaller) jobs which balance better but grow
+    the serial partial tree pass
+-j jobs (--jobs jobs)
+    number of tp_tree worker processes to run concurrently, default is 1
+-o output_file (--output output_file)
+    file for the combined tree (required, the driver seeks in it on resume)
+-x tp_tree (--tp_tree tp_tree)
+    path of the tp_tree binary to run, default is ./tp_tree
+-a cache_file (--cache_file cache_file)
+    passed through to every tp_tree process (shared prime cache)
+-c journal_file (--journal journal_file)
+    record progress in this file after each spliced job
+    the file is replaced atomically (written to a .tmp file then renamed)
+-e journal_file (--resume journal_file)
+    resume an interrupted run from a journal file
+    the other options must match the original run, completed jobs are not
+    recomputed (jobs finished out of order past the crash point are)
+*/
+
+#include <ctype.h>
+#include <getopt.h>
+#include <gmp.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// command line arguments
+const char *OPTION_STRING = "a:b:c:e:j:l:o:p:s:x:";
+const struct option OPTION_LONG[] =
+{
+    { "base",         required_argument, 0, 'b' },
+    { "cache_file",   required_argument, 0, 'a' },
+    { "jobs",         required_argument, 0, 'j' },
+    { "journal",      required_argument, 0, 'c' },
+    { "max_length",   required_argument, 0, 'l' },
+    { "output",       required_argument, 0, 'o' },
+    { "prime_type",   required_argument, 0, 'p' },
+    { "resume",       required_argument, 0, 'e' },
+    { "split_length", required_argument, 0, 's' },
+    { "tp_tree",      required_argument, 0, 'x' },
+    { 0,              0,                 0, 0   }
+};
+uint32_t _g_base;
+char *_g_prime_type;
+uint32_t _g_maxlength;
+uint32_t _g_split;
+uint32_t _g_jobs;
+char *_g_out_filename;
+char *_g_tp_tree;
+char *_g_cache_filename;
+char *_g_journal_filename;
+char *_g_resume_filename;
+
+#define BUFFER_SIZE (1<<20)
+
+// partial tree bytes (output of tp_tree -l split_length)
+unsigned char *_g_tree;
+size_t _g_tree_len;
+size_t _g_tree_pos; // cursor for the job scan
+uint32_t _g_markers; // root marker bytes at the start (2 for lor/lar)
+
+// subtree jobs in recursion order
+typedef struct
+{
+    char *root; // root value in base 10 (tp_tree -r argument)
+    size_t placeholder; // offset of the end byte this job's output replaces
+    char *out_bytes; // captured output, NULL until the job completes
+    size_t out_len;
+    bool done;
+} TP_JOB;
+TP_JOB *_g_job_list;
+uint32_t _g_job_count, _g_job_alloc;
+uint32_t _g_job_next; // next job to hand to a worker
+uint32_t _g_job_done0; // jobs already spliced by a resumed run
+pthread_mutex_t _g_job_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t _g_job_cond = PTHREAD_COND_INITIALIZER;
+
+// powers of the base for computing leaf values during the scan
+mpz_t *_g_powers;
+uint32_t _g_plen;
+
+// splice state
+FILE *_g_out;
+uint64_t _g_out_offset; // bytes written to the output file
+
+// checks if a string is a number
+bool is_number(const char *s)
+{
+    if (!isdigit(*s)) // must start with digit
+        return false;
+    ++s;
+    while (isdigit(*s)) // go past last digit
+        ++s;
+    return !(*s); // must be at null terminator
+}
+
+// returns a pointer to the mpz_t variable representing base^p
+static inline mpz_t *get_power(uint32_t p)
+{
+    if (p >= _g_plen)
+    {
+        _g_powers = realloc(_g_powers,sizeof(mpz_t)*(p+1));
+        for (uint32_t i = _g_plen; i <= p; ++i)
+        {
+            mpz_init(_g_powers[i]);
+            mpz_mul_ui(_g_powers[i],_g_powers[i-1],_g_base);
+        }
+        _g_plen = p+1;
+    }
+    return _g_powers+p;
+}
+
+/*
+Partial tree generation
+The driver execs tp_tree itself so the recursion code is not duplicated here;
+the child's stdout is captured in memory through a pipe.
+*/
+
+// fork and exec a tp_tree process with the given extra arguments and read
+// its entire output, exits on any failure
+void run_tp_tree(char **extra, char **buf, size_t *len)
+{
+    char basestr[8];
+    sprintf(basestr,"%u",_g_base);
+    char lenstr[16];
+    sprintf(lenstr,"%u",_g_maxlength);
+    char *argv[24];
+    int argc = 0;
+    argv[argc++] = _g_tp_tree;
+    argv[argc++] = "-p";
+    argv[argc++] = _g_prime_type;
+    argv[argc++] = "-b";
+    argv[argc++] = basestr;
+    if (_g_maxlength != (uint32_t)-1) // a later -l in extra overrides this
+    {
+        argv[argc++] = "-l";
+        argv[argc++] = lenstr;
+    }
+    if (_g_cache_filename)
+    {
+        argv[argc++] = "-a";
+        argv[argc++] = _g_cache_filename;
+    }
+    while (*extra)
+        argv[argc++] = *(extra++);
+    argv[argc] = NULL;
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        fprintf(stderr,"unable to create pipe\n");
+        exit(1);
+    }
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        fprintf(stderr,"unable to fork\n");
+        exit(1);
+    }
+    if (pid == 0) // child
+    {
+        close(fds[0]);
+        if (dup2(fds[1],1) == -1)
+            _exit(127);
+        close(fds[1]);
+        execv(_g_tp_tree,argv);
+        fprintf(stderr,"unable to exec %s\n",_g_tp_tree);
+        _exit(127);
+    }
+    close(fds[1]);
+    size_t cap = BUFFER_SIZE, used = 0;
+    char *data = malloc(cap);
+    for (;;)
+    {
+        if (used == cap)
+        {
+            cap *= 2;
+            data = realloc(data,cap);
+        }
+        ssize_t r = read(fds[0],data+used,cap-used);
+        if (r == 0)
+            break;
+        if (r < 0)
+        {
+            fprintf(stderr,"unable to read from tp_tree process\n");
+            exit(1);
+        }
+        used += r;
+    }
+    close(fds[0]);
+    int status;
+    if (waitpid(pid,&status,0) == -1
+     || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fprintf(stderr,"tp_tree process failed\n");
+        exit(1);
+    }
+    *buf = data;
+    *len = used;
+}
+
+/*
+Job scan
+Mirrors the tree walk of tree_combine.py: recurse the partial tree tracking
+each node's value, every leaf that tp_tree stopped expanding at the split
+length becomes a job and its end byte becomes the splice placeholder.
+*/
+
+// read the next partial tree byte
+static inline uint32_t scan_byte()
+{
+    if (_g_tree_pos >= _g_tree_len)
+    {
+        fprintf(stderr,"unexpected end of partial tree\n");
+        exit(1);
+    }
+    return _g_tree[_g_tree_pos++];
+}
+
+// record a job for the subtree rooted at val
+void add_job(const mpz_t val)
+{
+    if (_g_job_count == _g_job_alloc)
+    {
+        _g_job_alloc = _g_job_alloc ? 2*_g_job_alloc : 1024;
+        _g_job_list = realloc(_g_job_list,
+            _g_job_alloc*sizeof(*_g_job_list));
+    }
+    TP_JOB *job = _g_job_list + _g_job_count++;
+    job->root = mpz_get_str(NULL,10,val);
+    job->placeholder = _g_tree_pos - 1; // the end byte just read
+    job->out_bytes = NULL;
+    job->out_len = 0;
+    job->done = false;
+}
+
+// leaf handler shared by the scan functions, len is the leaf digit length
+// jobs are exactly the leaves the split length stopped from expanding
+static inline void scan_leaf(const mpz_t val, uint32_t len)
+{
+    uint32_t append = strcmp(_g_prime_type,"lar") == 0 ? 2 : 1;
+    if (len + append > _g_split && len + append <= _g_maxlength)
+        add_job(val);
+}
+
+void scan_r(const mpz_t val, uint32_t len)
+{
+    uint32_t d = scan_byte();
+    if (d == 255) // leaf
+    {
+        scan_leaf(val,len);
+        return;
+    }
+    mpz_t val2;
+    mpz_init(val2);
+    while (d != 255)
+    {
+        mpz_mul_ui(val2,val,_g_base);
+        mpz_add_ui(val2,val2,d);
+        scan_r(val2,len+1);
+        d = scan_byte();
+    }
+    mpz_clear(val2);
+}
+
+void scan_l(const mpz_t val, uint32_t len)
+{
+    uint32_t d = scan_byte();
+    if (d == 255) // leaf
+    {
+        scan_leaf(val,len);
+        return;
+    }
+    mpz_t val2;
+    mpz_init(val2);
+    while (d != 255)
+    {
+        mpz_set(val2,val);
+        mpz_addmul_ui(val2,*get_power(len),d);
+        scan_l(val2,len+1);
+        d = scan_byte();
+    }
+    mpz_clear(val2);
+}
+
+void scan_lor(const mpz_t val, uint32_t len)
+{
+    uint32_t side = scan_byte();
+    if (side == 255) // leaf
+    {
+        scan_leaf(val,len);
+        return;
+    }
+    mpz_t val2;
+    mpz_init(val2);
+    while (side != 255)
+    {
+        uint32_t d = scan_byte();
+        if (side == 0) // left append
+        {
+            mpz_set(val2,val);
+            mpz_addmul_ui(val2,*get_power(len),d);
+        }
+        else // right append
+        {
+            mpz_mul_ui(val2,val,_g_base);
+            mpz_add_ui(val2,val2,d);
+        }
+        scan_lor(val2,len+1);
+        side = scan_byte();
+    }
+    mpz_clear(val2);
+}
+
+void scan_lar(const mpz_t val, uint32_t len)
+{
+    uint32_t ld = scan_byte();
+    if (ld == 255) // leaf
+    {
+        scan_leaf(val,len);
+        return;
+    }
+    mpz_t val2;
+    mpz_init(val2);
+    while (ld != 255)
+    {
+        uint32_t rd = scan_byte();
+        // ld may only be 0 for the 1 digit roots of the full tree
+        uint32_t len2 = len + (len == 0 && ld == 0 ? 1 : 2);
+        mpz_mul_ui(val2,val,_g_base);
+        mpz_add_ui(val2,val2,rd);
+        mpz_addmul_ui(val2,*get_power(len2-1),ld);
+        scan_lar(val2,len2);
+        ld = scan_byte();
+    }
+    mpz_clear(val2);
+}
+
+// scan the whole partial tree and build the job list
+void scan_jobs()
+{
+    _g_markers = (strcmp(_g_prime_type,"lor") == 0
+               || strcmp(_g_prime_type,"lar") == 0) ? 2 : 1;
+    for (uint32_t i = 0; i < _g_markers; ++i)
+        if (scan_byte() != 255)
+        {
+            fprintf(stderr,"invalid partial tree\n");
+            exit(1);
+        }
+    mpz_t zero;
+    mpz_init(zero);
+    if (strcmp(_g_prime_type,"r") == 0)
+        scan_r(zero,0);
+    else if (strcmp(_g_prime_type,"l") == 0)
+        scan_l(zero,0);
+    else if (strcmp(_g_prime_type,"lor") == 0)
+        scan_lor(zero,0);
+    else
+        scan_lar(zero,0);
+    mpz_clear(zero);
+    if (_g_tree_pos != _g_tree_len)
+    {
+        fprintf(stderr,"invalid partial tree\n");
+        exit(1);
+    }
+}
+
+/*
+Journal
+Text format in the style of the truncprimes checkpoints, replaced atomically
+after each spliced job. Records only the splice frontier since everything
+before it is already in the output file and everything after is recomputed.
+*/
+
+// helpers shared with the journal reader
+void journal_match(FILE *f, const char *key, const char *value)
+{
+    char buf[64];
+    if (fscanf(f,"%63s",buf) != 1 || strcmp(buf,key) != 0
+     || fscanf(f,"%63s",buf) != 1 || strcmp(buf,value) != 0)
+    {
+        fprintf(stderr,"journal does not match arguments\n");
+        exit(1);
+    }
+}
+
+void journal_expect(FILE *f, const char *key)
+{
+    char buf[64];
+    if (fscanf(f,"%63s",buf) != 1 || strcmp(buf,key) != 0)
+    {
+        fprintf(stderr,"invalid journal file\n");
+        exit(1);
+    }
+}
+
+void write_journal(uint32_t jobs_done)
+{
+    char *tmpname = malloc(strlen(_g_journal_filename)+5);
+    sprintf(tmpname,"%s.tmp",_g_journal_filename);
+    FILE *f = fopen(tmpname,"w");
+    if (!f)
+    {
+        fprintf(stderr,"unable to write journal file\n");
+        exit(1);
+    }
+    fprintf(f,"tp_driver journal\n");
+    fprintf(f,"prime_type %s\n",_g_prime_type);
+    fprintf(f,"base %u\n",_g_base);
+    fprintf(f,"max_length %u\n",_g_maxlength);
+    fprintf(f,"split %u\n",_g_split);
+    fprintf(f,"jobs_total %u\n",_g_job_count);
+    fprintf(f,"jobs_done %u\n",jobs_done);
+    fprintf(f,"offset %lu\n",_g_out_offset);
+    fprintf(f,"end\n");
+    if (fclose(f) != 0 || rename(tmpname,_g_journal_filename) != 0)
+    {
+        fprintf(stderr,"unable to write journal file\n");
+        exit(1);
+    }
+    free(tmpname);
+}
+
+// reads the journal, validates it against the arguments and returns the
+// number of already spliced jobs, _g_out_offset is set to the saved offset
+uint32_t load_journal()
+{
+    FILE *f = fopen(_g_resume_filename,"r");
+    if (!f)
+    {
+        fprintf(stderr,"unable to open journal file\n");
+        exit(1);
+    }
+    char value[16];
+    journal_match(f,"tp_driver","journal");
+    journal_match(f,"prime_type",_g_prime_type);
+    sprintf(value,"%u",_g_base);
+    journal_match(f,"base",value);
+    sprintf(value,"%u",_g_maxlength);
+    journal_match(f,"max_length",value);
+    sprintf(value,"%u",_g_split);
+    journal_match(f,"split",value);
+    sprintf(value,"%u",_g_job_count);
+    journal_match(f,"jobs_total",value);
+    uint32_t jobs_done;
+    journal_expect(f,"jobs_done");
+    if (fscanf(f,"%u",&jobs_done) != 1 || jobs_done > _g_job_count)
+    {
+        fprintf(stderr,"invalid journal file\n");
+        exit(1);
+    }
+    journal_expect(f,"offset");
+    if (fscanf(f,"%lu",&_g_out_offset) != 1)
+    {
+        fprintf(stderr,"invalid journal file\n");
+        exit(1);
+    }
+    journal_expect(f,"end");
+    fclose(f);
+    return jobs_done;
+}
+
+/*
+Worker pool
+Each worker thread repeatedly takes the next job from the shared queue, runs
+a tp_tree process for its root and captures the output, exactly the dynamic
+balancing GNU parallel provided but without the temp file per job.
+*/
+
+void *worker_main(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&_g_job_lock);
+        uint32_t i = _g_job_next++;
+        pthread_mutex_unlock(&_g_job_lock);
+        if (i >= _g_job_count)
+            break;
+        TP_JOB *job = _g_job_list + i;
+        char *extra[4];
+        extra[0] = "-r";
+        extra[1] = job->root;
+        extra[2] = NULL;
+        char *buf;
+        size_t len;
+        run_tp_tree(extra,&buf,&len);
+        // the root marker bytes are dropped when splicing, check them now
+        if (len < _g_markers + 1)
+        {
+            fprintf(stderr,"job output too short for root %s\n",job->root);
+            exit(1);
+        }
+        for (uint32_t k = 0; k < _g_markers; ++k)
+            if ((unsigned char)buf[k] != 255)
+            {
+                fprintf(stderr,"invalid job output for root %s\n",job->root);
+                exit(1);
+            }
+        pthread_mutex_lock(&_g_job_lock);
+        job->out_bytes = buf;
+        job->out_len = len;
+        job->done = true;
+        pthread_cond_signal(&_g_job_cond);
+        pthread_mutex_unlock(&_g_job_lock);
+    }
+    return NULL;
+}
+
+// write bytes to the output file
+void splice_write(const char *buf, size_t len)
+{
+    if (fwrite(buf,1,len,_g_out) != len)
+    {
+        fprintf(stderr,"unable to write output file\n");
+        exit(1);
+    }
+    _g_out_offset += len;
+}
+
+// main splice loop, writes the partial tree with each placeholder end byte
+// replaced by the corresponding job output as the jobs complete in order
+void run_splice()
+{
+    // partial tree position of the first unwritten byte
+    size_t tree_pos = 0;
+    if (_g_job_done0 > 0) // resuming, skip past the last spliced job
+        tree_pos = _g_job_list[_g_job_done0-1].placeholder + 1;
+    for (uint32_t i = _g_job_done0; i < _g_job_count; ++i)
+    {
+        TP_JOB *job = _g_job_list + i;
+        pthread_mutex_lock(&_g_job_lock);
+        while (!job->done)
+            pthread_cond_wait(&_g_job_cond,&_g_job_lock);
+        pthread_mutex_unlock(&_g_job_lock);
+        // partial tree up to the placeholder, then the job subtree
+        splice_write((char*)_g_tree+tree_pos,job->placeholder-tree_pos);
+        splice_write(job->out_bytes+_g_markers,job->out_len-_g_markers);
+        tree_pos = job->placeholder + 1;
+        free(job->out_bytes);
+        job->out_bytes = NULL;
+        if (fflush(_g_out) != 0)
+        {
+            fprintf(stderr,"unable to write output file\n");
+            exit(1);
+        }
+        // jobs_done only reaches the total once the tail below is written
+        if (_g_journal_filename && i+1 < _g_job_count)
+            write_journal(i+1);
+    }
+    // partial tree after the last placeholder
+    splice_write((char*)_g_tree+tree_pos,_g_tree_len-tree_pos);
+    if (fflush(_g_out) != 0)
+    {
+        fprintf(stderr,"unable to write output file\n");
+        exit(1);
+    }
+    if (_g_journal_filename)
+        write_journal(_g_job_count);
+}
+
+int main(int argc, char **argv)
+{
+    // set default values
+    _g_base = 10;
+    _g_maxlength = -1;
+    _g_split = 0;
+    _g_jobs = 1;
+    _g_prime_type = NULL;
+    _g_out_filename = NULL;
+    _g_tp_tree = "./tp_tree";
+    _g_cache_filename = NULL;
+    _g_journal_filename = NULL;
+    _g_resume_filename = NULL;
+    if (argc < 2)
+    {
+        fprintf(stderr,"tp_driver <-p prime_type> <-s split_length> "
+                "<-o output_file> [-b base] [-l max_length] [-j jobs]\n");
+        return 0;
+    }
+    // read options
+    int o;
+    while ((o = getopt_long(argc,argv,OPTION_STRING,OPTION_LONG,NULL)) != -1)
+    {
+        switch (o)
+        {
+        case 'a': // cache file
+            _g_cache_filename = optarg;
+            break;
+        case 'b': // base
+            if (!is_number(optarg))
+            {
+                fprintf(stderr,"base must be a number\n");
+                return 0;
+            }
+            _g_base = atoi(optarg);
+            break;
+        case 'c': // journal file
+            _g_journal_filename = optarg;
+            break;
+        case 'e': // resume file
+            _g_resume_filename = optarg;
+            break;
+        case 'j': // jobs
+            if (!is_number(optarg))
+            {
+                fprintf(stderr,"jobs must be a number\n");
+                return 0;
+            }
+            _g_jobs = atoi(optarg);
+            break;
+        case 'l': // max length
+            if (!is_number(optarg))
+            {
+                fprintf(stderr,"max length must be a number\n");
+                return 0;
+            }
+            _g_maxlength = atoi(optarg);
+            break;
+        case 'o': // output file
+            _g_out_filename = optarg;
+            break;
+        case 'p': // prime type
+            _g_prime_type = optarg;
+            break;
+        case 's': // split length
+            if (!is_number(optarg))
+            {
+                fprintf(stderr,"split length must be a number\n");
+                return 0;
+            }
+            _g_split = atoi(optarg);
+            break;
+        case 'x': // tp_tree path
+            _g_tp_tree = optarg;
+            break;
+        default:
+            fprintf(stderr,"error parsing arguments\n");
+            fprintf(stderr,"tp_driver <-p prime_type> <-s split_length> "
+                    "<-o output_file> [-b base] [-l max_length] [-j jobs]\n");
+            return 0;
+        }
+    }
+    if (_g_base < 2 || _g_base > 255)
+    {
+        fprintf(stderr,"base %u out of valid range (2-255)\n",_g_base);
+        return 0;
+    }
+    if (!_g_prime_type)
+    {
+        fprintf(stderr,"must specify prime type\n");
+        return 0;
+    }
+    if (strcmp(_g_prime_type,"r") != 0 && strcmp(_g_prime_type,"l") != 0
+     && strcmp(_g_prime_type,"lor") != 0 && strcmp(_g_prime_type,"lar") != 0)
+    {
+        fprintf(stderr,"invalid prime type: %s\n",_g_prime_type);
+        return 0;
+    }
+    if (_g_split < 2)
+    {
+        fprintf(stderr,"split length must be >= 2\n");
+        return 0;
+    }
+    if (_g_split >= _g_maxlength)
+    {
+        fprintf(stderr,"split length must be less than max length\n");
+        return 0;
+    }
+    if (_g_jobs < 1)
+    {
+        fprintf(stderr,"jobs must be >= 1\n");
+        return 0;
+    }
+    if (!_g_out_filename)
+    {
+        fprintf(stderr,"must specify output file\n");
+        return 0;
+    }
+    if (_g_journal_filename && _g_resume_filename)
+    {
+        fprintf(stderr,"resumed runs continue their own journal\n");
+        return 0;
+    }
+    if (_g_resume_filename) // a resumed run keeps journaling its progress
+        _g_journal_filename = _g_resume_filename;
+    _g_powers = malloc(sizeof(mpz_t));
+    mpz_init_set_ui(_g_powers[0],1);
+    _g_plen = 1;
+    // partial tree, computed in memory (identical on a resumed run)
+    char lenstr[16];
+    sprintf(lenstr,"%u",_g_split);
+    char *extra[4];
+    extra[0] = "-l";
+    extra[1] = lenstr;
+    extra[2] = NULL;
+    run_tp_tree(extra,(char**)&_g_tree,&_g_tree_len);
+    scan_jobs();
+    fprintf(stderr,"splitting into %u jobs\n",_g_job_count);
+    // open the output and position both ends of the splice for resume
+    _g_out_offset = 0;
+    _g_job_done0 = 0;
+    if (_g_resume_filename)
+    {
+        _g_job_done0 = load_journal();
+        if (_g_job_done0 == _g_job_count) // tail was written too, see journal
+        {
+            fprintf(stderr,"run already complete\n");
+            return 0;
+        }
+        _g_out = fopen(_g_out_filename,"r+");
+        if (!_g_out || fseek(_g_out,_g_out_offset,SEEK_SET) != 0)
+        {
+            fprintf(stderr,"unable to reopen output file\n");
+            exit(1);
+        }
+        // discard output past the journal frontier (partial splices)
+        if (ftruncate(fileno(_g_out),_g_out_offset) != 0)
+        {
+            fprintf(stderr,"unable to truncate output file\n");
+            exit(1);
+        }
+        fprintf(stderr,"resuming after %u jobs\n",_g_job_done0);
+    }
+    else
+        _g_out = fopen(_g_out_filename,"w");
+    if (!_g_out)
+    {
+        fprintf(stderr,"unable to open output file\n");
+        exit(1);
+    }
+    if (setvbuf(_g_out,NULL,_IOFBF,BUFFER_SIZE) == -1)
+    {
+        fprintf(stderr,"unable to set output buffer\n");
+        exit(1);
+    }
+    // workers start behind the splice frontier
+    _g_job_next = _g_job_done0;
+    uint32_t nthreads = _g_jobs;
+    if (nthreads > _g_job_count - _g_job_done0)
+        nthreads = _g_job_count - _g_job_done0;
+    pthread_t *threads = malloc(nthreads*sizeof(*threads));
+    for (uint32_t i = 0; i < nthreads; ++i)
+        if (pthread_create(threads+i,NULL,worker_main,NULL) != 0)
+        {
+            fprintf(stderr,"unable to create thread\n");
+            exit(1);
+        }
+    run_splice();
+    for (uint32_t i = 0; i < nthreads; ++i)
+        pthread_join(threads[i],NULL);
+    if (fclose(_g_out) != 0)
+    {
+        fprintf(stderr,"unable to write output file\n");
+        exit(1);
+    }
+    free(threads);
+    for (uint32_t i = 0; i < _g_job_count; ++i)
+        free(_g_job_list[i].root);
+    free(_g_job_list);
+    free(_g_tree);
+    for (uint32_t i = 0; i < _g_plen; ++i)
+        mpz_clear(_g_powers[i]);
+    free(_g_powers);
+    return 0;
+}
@@ -0,0 +1,295 @@
+/*
+Parallel recomputation of the stats verification hash from a stored tree
+file, so a merged or archived tree.bin can be checked against the
+"# hash = " line of a stats run without regenerating the tree.
+
+usage: ./tp_hash -f <file> -p <prime_type> [-b base] [-r root] [-t threads]
+
+The hash recurrence (see "Hashing function" in truncprimes.c) uses only
+the lower 64 bits of each node's value, so recomputation is pure integer
+arithmetic over the byte format and runs at I/O speed. The recurrence
+composes per child, so the depth 1 subtrees are hashed independently on
+worker threads and the results are folded into the root hash in file
+order at the end, exactly like the recursion folds them.
+
+Prints "# hash = <hash>" (the same line the stats csv ends with) and the
+node count and throughput to stderr. With -r the file is a subtree run
+and the printed hash is the hash of that root's node, matching a stats
+run with the same root.
+*/
+
+#include <getopt.h>
+#include <gmp.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tree_reader.h"
+
+// the hash recurrence from truncprimes.c (-DWRITE_STATS), all 64 bit
+#define HASH_ROT(h) (((h) >> 45) | ((h) << 19))
+#define HASH_UPDATE(h,d,c) ((h)^HASH_ROT(8191*(127*(h)-(d))+(c)))
+
+// command line
+const char *OPTION_STRING = "b:f:p:r:t:";
+const struct option OPTION_LONG[] =
+{
+    { "base",       required_argument, 0, 'b' },
+    { "file",       required_argument, 0, 'f' },
+    { "prime_type", required_argument, 0, 'p' },
+    { "root",       required_argument, 0, 'r' },
+    { "threads",    required_argument, 0, 't' },
+    { 0, 0, 0, 0 }
+};
+
+TR_TREE _tree;
+uint64_t _base; // 64 bit so value arithmetic promotes without casts
+int _ptype;
+
+uint64_t _rval; // lower 64 bits of the -r root, 0 for a full tree
+uint64_t _rpow; // base^(digits of root) mod 2^64, 1 for a full tree
+bool _subtree_run;
+
+// depth 1 subtree offsets and their hash results, folded in file order
+uint64_t *_offs;
+uint64_t *_hashes;
+uint32_t *_paths; // path value of each subtree's root node
+uint64_t _nsubtrees, _next_subtree;
+pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+
+uint64_t _total; // node count (summed under the lock)
+
+typedef struct
+{
+    // per depth slots, a node's hash accumulates while its children fold
+    uint64_t *hash;
+    uint64_t *value; // lower 64 bits of the node's value
+    uint64_t *pow; // base^(node's digit count) mod 2^64
+    uint32_t *path; // path value of the node's append
+    uint32_t cap;
+    uint64_t count;
+    uint64_t result; // final hash of the current subtree's root node
+}
+WALK;
+
+static void walk_grow(WALK *w, uint32_t cap)
+{
+    w->hash = realloc(w->hash,cap*sizeof(*w->hash));
+    w->value = realloc(w->value,cap*sizeof(*w->value));
+    w->pow = realloc(w->pow,cap*sizeof(*w->pow));
+    w->path = realloc(w->path,cap*sizeof(*w->path));
+    w->cap = cap;
+}
+
+// open callback, computes the node's value (mod 2^64) from its parent and
+// starts its hash accumulator
+static bool walk_open(void *arg, const unsigned char *value, uint32_t depth,
+        uint64_t off)
+{
+    (void)off;
+    WALK *w = (WALK*)arg;
+    if (depth >= w->cap)
+        walk_grow(w,2*depth);
+    uint32_t i = depth-1;
+    uint32_t d = TR_path_value(&_tree,value);
+    uint64_t pv = i > 0 ? w->value[i-1] : _rval;
+    uint64_t pp = i > 0 ? w->pow[i-1] : _rpow;
+    uint64_t v;
+    switch (_ptype)
+    {
+    case TR_L:
+        v = pv + d*pp;
+        break;
+    case TR_LOR:
+        if (d < _base) // left append
+            v = pv + d*pp;
+        else // right append
+            v = pv*_base + (d-_base);
+        break;
+    case TR_LAR: // left digit then right digit
+        v = (pv + (d/_base)*pp)*_base + d%_base;
+        break;
+    default: // r
+        v = pv*_base + d;
+        break;
+    }
+    // depth 1 of a full tree appends to value 0 with pow 1, so v above is
+    // already the 1 digit root (or the 2 digit lar root via d = dl*b+dr)
+    w->value[i] = v;
+    w->pow[i] = pp*(_ptype == TR_LAR ? _base*_base : _base);
+    if (i == 0 && !_subtree_run && _ptype == TR_LAR && d < _base)
+        w->pow[i] = _base; // 1 digit lar root
+    w->path[i] = d;
+    w->hash[i] = v >> 1;
+    ++w->count;
+    return true;
+}
+
+// close callback, the node's child list ended so its hash is final and
+// folds into its parent's accumulator
+static void walk_close(void *arg, uint32_t depth)
+{
+    WALK *w = (WALK*)arg;
+    uint32_t i = depth-1;
+    if (i > 0)
+        w->hash[i-1] = HASH_UPDATE(w->hash[i-1],w->path[i],w->hash[i]);
+    else
+        w->result = w->hash[0];
+}
+
+void *worker(void *arg)
+{
+    (void)arg;
+    WALK w;
+    memset(&w,0,sizeof(w));
+    walk_grow(&w,64);
+    for (;;)
+    {
+        pthread_mutex_lock(&_lock);
+        uint64_t i = _next_subtree++;
+        pthread_mutex_unlock(&_lock);
+        if (i >= _nsubtrees)
+            break;
+        TR_visit(&_tree,_offs[i],1,walk_open,walk_close,&w);
+        _hashes[i] = w.result;
+        _paths[i] = TR_path_value(&_tree,_tree.data+_offs[i]);
+    }
+    pthread_mutex_lock(&_lock);
+    _total += w.count;
+    pthread_mutex_unlock(&_lock);
+    free(w.hash);
+    free(w.value);
+    free(w.pow);
+    free(w.path);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filename = NULL, *prime_type = NULL;
+    uint32_t base = 10, threads = 1;
+    mpz_t root;
+    mpz_init(root);
+    int o;
+    while ((o = getopt_long(argc,argv,OPTION_STRING,OPTION_LONG,NULL)) != -1)
+    {
+        switch (o)
+        {
+        case 'b':
+            base = atoi(optarg);
+            break;
+        case 'f':
+            filename = optarg;
+            break;
+        case 'p':
+            prime_type = optarg;
+            break;
+        case 'r':
+            if (mpz_set_str(root,optarg,10) != 0
+             || mpz_cmp_ui(root,0) < 0)
+            {
+                fprintf(stderr,"root must be integer >= 0\n");
+                return 0;
+            }
+            break;
+        case 't':
+            threads = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr,"./tp_hash -f <file> -p <prime_type> "
+                "[-b base] [-r root] [-t threads]\n");
+            return 0;
+        }
+    }
+    if (!filename || !prime_type)
+    {
+        fprintf(stderr,"must specify file and prime type\n");
+        return 0;
+    }
+    if (base < 2 || base > 255 || threads < 1)
+    {
+        fprintf(stderr,"invalid arguments\n");
+        return 0;
+    }
+    _base = base;
+    if (!strcmp(prime_type,"r"))
+        _ptype = TR_R;
+    else if (!strcmp(prime_type,"l"))
+        _ptype = TR_L;
+    else if (!strcmp(prime_type,"lor"))
+        _ptype = TR_LOR;
+    else if (!strcmp(prime_type,"lar"))
+        _ptype = TR_LAR;
+    else
+    {
+        fprintf(stderr,"invalid prime type %s\n",prime_type);
+        return 0;
+    }
+    // lower 64 bits and digit count of the -r root
+    _rval = 0;
+    _rpow = 1;
+    _subtree_run = mpz_cmp_ui(root,0) > 0;
+    if (_subtree_run)
+    {
+        _rval = mpz_get_ui(root);
+        while (mpz_cmp_ui(root,0) > 0)
+        {
+            mpz_div_ui(root,root,base);
+            _rpow *= _base;
+        }
+    }
+    struct timespec t0,t1;
+    clock_gettime(CLOCK_MONOTONIC,&t0);
+    TR_open(&_tree,filename,prime_type,base);
+    // collect the depth 1 subtree offsets for sharding
+    uint64_t alloc = 64;
+    _offs = malloc(alloc*sizeof(*_offs));
+    uint64_t off = _tree.vbytes; // past the root marker
+    while (_tree.data[off] != 255)
+    {
+        if (_nsubtrees == alloc)
+        {
+            alloc *= 2;
+            _offs = realloc(_offs,alloc*sizeof(*_offs));
+        }
+        _offs[_nsubtrees++] = off;
+        off = TR_skip(&_tree,off);
+    }
+    _hashes = malloc(_nsubtrees*sizeof(*_hashes));
+    _paths = malloc(_nsubtrees*sizeof(*_paths));
+    if (threads == 1)
+        worker(NULL);
+    else
+    {
+        pthread_t *tids = malloc(threads*sizeof(*tids));
+        for (uint32_t i = 0; i < threads; ++i)
+            if (pthread_create(tids+i,NULL,worker,NULL) != 0)
+            {
+                fprintf(stderr,"unable to create thread\n");
+                exit(1);
+            }
+        for (uint32_t i = 0; i < threads; ++i)
+            pthread_join(tids[i],NULL);
+        free(tids);
+    }
+    // fold the subtree hashes into the root hash in file order
+    uint64_t hash = _rval >> 1;
+    for (uint64_t i = 0; i < _nsubtrees; ++i)
+        hash = HASH_UPDATE(hash,_paths[i],_hashes[i]);
+    clock_gettime(CLOCK_MONOTONIC,&t1);
+    double secs = (t1.tv_sec-t0.tv_sec) + 1e-9*(t1.tv_nsec-t0.tv_nsec);
+    fprintf(stderr,"hashed %lu nodes (%lu bytes) in %.2fs (%.0f MB/s)\n",
+        _total,_tree.size,secs,
+        secs > 0 ? 1e-6*_tree.size/secs : 0);
+    printf("# hash = %lu\n",hash);
+    TR_close(&_tree);
+    free(_offs);
+    free(_hashes);
+    free(_paths);
+    mpz_clear(root);
+    return 0;
+}
@@ -9,6 +9,7 @@ Truncatable primes utility functions
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "../pseudoprimes/functions.h"
 #include "tp_util.h"
 
 /*
@@ -25,7 +26,9 @@ bool is_r_truncprime(const mpz_t a, uint32_t b)
     mpz_init_set(n,a);
     while (mpz_cmp_ui(n,0) > 0) // test primality and truncate right
     {
-        if (!PRIME_TEST(n) || mpz_div_ui(n,n,b) == 0)
+        // mpz_fdiv_ui leaves n alone, mpz_div_ui here would truncate a
+        // second digit before the next primality test
+        if (!PRIME_TEST(n) || mpz_fdiv_ui(n,b) == 0)
         {
             ret = false;
             break;
@@ -193,10 +196,26 @@ void TP_init(TP_STATE *state, uint32_t base, const mpz_t root,
     state->pow = malloc(sizeof(*state->pow));
     mpz_init_set_ui(state->pow[0],1);
     state->plen = 1;
+    // largest digit length where every value fits in 63 bits (fast path)
+    // is_prime64 is limited to 63 bits like the kernels in functions.h
+    state->len64 = 0;
+    uint64_t upow = 1;
+    while (upow <= (POW2(63)-1)/base)
+    {
+        upow *= base;
+        ++state->len64;
+    }
+    state->upow = malloc(state->len64*sizeof(*state->upow));
+    state->upow[0] = 1;
+    for (uint32_t i = 1; i < state->len64; ++i)
+        state->upow[i] = state->upow[i-1]*base;
     // initialize recursion state
     state->stack = malloc(2*sizeof(*state->stack));
     mpz_init_set(state->stack[0].n,root);
     mpz_init(state->stack[1].n);
+    state->stack[0].u = state->stack[1].u = 0;
+    if (state->rlen <= state->len64) // 64 bit mirror of the root
+        state->stack[0].u = mpz_get_ui(root);
     state->stack[0].i = 0;
     state->stack[1].i = 0;
     state->stack[0].v[0] = state->stack[0].v[1] = 0;
@@ -205,6 +224,8 @@ void TP_init(TP_STATE *state, uint32_t base, const mpz_t root,
     state->stack[0].c = state->stack[1].c = 0;
     state->slen = 2;
     state->depth = 1; // start in next stack frame
+    state->yield = NULL;
+    state->ylen = 0;
 }
 
 void TP_clear(TP_STATE *state)
@@ -215,8 +236,12 @@ void TP_clear(TP_STATE *state)
         mpz_clear(state->pow[i]);
     for (i = 0; i < state->slen; ++i)
         mpz_clear(state->stack[i].n);
+    for (i = 0; i < state->ylen; ++i)
+        mpz_clear(state->yield[i]);
     free(state->pow);
+    free(state->upow);
     free(state->stack);
+    free(state->yield);
 }
 
 // convenience macros
@@ -225,6 +250,11 @@ void TP_clear(TP_STATE *state)
 #define S_CURR (state->stack[state->depth])
 #define S_PREV (state->stack[state->depth-1])
 
+// 64 bit fast path check, mul is digits appended per level (2 for lar)
+// constant within a frame so a frame never mixes the two representations
+#define S_FITS64(mul) \
+    (state->rlen + (mul)*state->depth <= state->len64)
+
 void TP_resize_stack(TP_STATE *state, uint32_t len)
 {
     assert(len > state->slen);
@@ -232,6 +262,7 @@ void TP_resize_stack(TP_STATE *state, uint32_t len)
     for (uint32_t i = state->slen; i < len; ++i)
     {
         mpz_init(state->stack[i].n);
+        state->stack[i].u = 0;
         state->stack[i].i = 0;
         state->stack[i].v[0] = state->stack[i].v[1] = 0;
         state->stack[i].c = 0;
@@ -252,21 +283,37 @@ void TP_resize_powers(TP_STATE *state, uint32_t len)
 }
 
 // sets value from generator conditionally
+// copy is a state owned slot for batch calls (sibling frames reuse stack
+// entries so a pointer into the stack only survives one step), NULL keeps
+// the single step behavior of pointing into the stack
 static inline void set_value(bool is_set, TP_VALUE *value, uint32_t len,
-        const mpz_t *num, uint32_t children, uint32_t path)
+        const mpz_t *num, uint32_t children, uint32_t path, mpz_t *copy)
 {
     if (is_set)
     {
+        if (copy)
+        {
+            mpz_set(*copy,*num);
+            num = (const mpz_t*)copy;
+        }
         value->len = len;
         value->num = num;
         value->children = children;
         value->path = path;
     }
-    else
+    else if (value)
         value->len = 0;
 }
 
-uint32_t TP_next_r(TP_STATE *state, char *ret, TP_VALUE *value)
+/*
+Generator step functions, each call yields one byte sequence
+The mode is passed as an argument (equal to state->mode) so the batch
+drivers below can inline these with a constant mode and fold the checks,
+the single step TP_next_* wrappers pass it dynamically
+*/
+
+static inline uint32_t TP_step_r(TP_STATE *state, char *ret,
+        TP_VALUE *value, uint32_t mode, mpz_t *copy)
 {
     if (state->depth == 0)
         return 0;
@@ -275,33 +322,46 @@ uint32_t TP_next_r(TP_STATE *state, char *ret, TP_VALUE *value)
         if (S_CURR.i == 0) // yield root
         {
             ++S_CURR.i;
-            set_value(state->mode==TP_PRE_ORDER,value,
-                state->rlen+state->depth-1,&S_PREV.n,-1,S_PREV.i-1);
+            set_value(mode==TP_PRE_ORDER,value,
+                state->rlen+state->depth-1,&S_PREV.n,-1,S_PREV.i-1,copy);
             ret[0] = S_CURR.v[0];
             return 1;
         }
-        else if (state->rlen + state->depth > state->maxlen)
+        else if (S_CURR.i < S_BASE
+              && state->rlen + state->depth > state->maxlen)
             S_CURR.i = S_BASE; // skip deeper recursion
         else if (S_CURR.i < S_BASE) // digit append loop
         {
-            if (S_CURR.i == 1) // setup
-                mpz_mul_ui(S_CURR.n,S_PREV.n,S_BASE);
-            mpz_add_ui(S_CURR.n,S_CURR.n,1);
-            ++S_CURR.i;
-            if (PRIME_TEST(S_CURR.n))
+            if (S_FITS64(1)) // fast path, GMP only touched for primes
             {
-                ++S_CURR.c;
-                ++state->depth; // enter new stack frame
-                if (state->depth >= state->slen)
-                    TP_resize_stack(state,state->depth+1);
-                S_CURR.v[0] = S_PREV.i-1; // digit
-                S_CURR.i = S_CURR.c = 0;
+                if (S_CURR.i == 1) // setup
+                    S_CURR.u = S_PREV.u*S_BASE;
+                ++S_CURR.u;
+                ++S_CURR.i;
+                if (!is_prime64(S_CURR.u))
+                    continue;
+                mpz_set_ui(S_CURR.n,S_CURR.u);
             }
+            else
+            {
+                if (S_CURR.i == 1) // setup
+                    mpz_mul_ui(S_CURR.n,S_PREV.n,S_BASE);
+                mpz_add_ui(S_CURR.n,S_CURR.n,1);
+                ++S_CURR.i;
+                if (!PRIME_TEST(S_CURR.n))
+                    continue;
+            }
+            ++S_CURR.c;
+            ++state->depth; // enter new stack frame
+            if (state->depth >= state->slen)
+                TP_resize_stack(state,state->depth+1);
+            S_CURR.v[0] = S_PREV.i-1; // digit
+            S_CURR.i = S_CURR.c = 0;
         }
         else // yield end
         {
-            set_value(state->mode==TP_POST_ORDER,value,
-                state->rlen+state->depth-1,&S_PREV.n,S_CURR.c,S_PREV.i-1);
+            set_value(mode==TP_POST_ORDER,value,
+                state->rlen+state->depth-1,&S_PREV.n,S_CURR.c,S_PREV.i-1,copy);
             --state->depth;
             ret[0] = 255;
             return 1;
@@ -309,7 +369,8 @@ uint32_t TP_next_r(TP_STATE *state, char *ret, TP_VALUE *value)
     }
 }
 
-uint32_t TP_next_l(TP_STATE *state, char *ret, TP_VALUE *value)
+static inline uint32_t TP_step_l(TP_STATE *state, char *ret,
+        TP_VALUE *value, uint32_t mode, mpz_t *copy)
 {
     if (state->depth == 0)
         return 0;
@@ -318,35 +379,49 @@ uint32_t TP_next_l(TP_STATE *state, char *ret, TP_VALUE *value)
         if (S_CURR.i == 0) // yield root
         {
             ++S_CURR.i;
-            set_value(state->mode==TP_PRE_ORDER,value,
-                state->rlen+state->depth-1,&S_PREV.n,-1,S_PREV.i-1);
+            set_value(mode==TP_PRE_ORDER,value,
+                state->rlen+state->depth-1,&S_PREV.n,-1,S_PREV.i-1,copy);
             ret[0] = S_CURR.v[0];
             return 1;
         }
-        else if (state->rlen + state->depth > state->maxlen)
+        else if (S_CURR.i < S_BASE
+              && state->rlen + state->depth > state->maxlen)
             S_CURR.i = S_BASE; // skip deeper recursion
         else if (S_CURR.i < S_BASE) // digit append loop
         {
-            if (S_CURR.i == 1) // setup
-                mpz_set(S_CURR.n,S_PREV.n);
-            if (state->rlen + state->depth > state->plen)
-                TP_resize_powers(state,state->rlen+state->depth);
-            mpz_add(S_CURR.n,S_CURR.n,state->pow[state->rlen+state->depth-1]);
-            ++S_CURR.i;
-            if (PRIME_TEST(S_CURR.n))
+            if (S_FITS64(1)) // fast path, GMP only touched for primes
             {
-                ++S_CURR.c;
-                ++state->depth;
-                if (state->depth >= state->slen)
-                    TP_resize_stack(state,state->depth+1);
-                S_CURR.v[0] = S_PREV.i-1; // digit
-                S_CURR.i = S_CURR.c = 0;
+                if (S_CURR.i == 1) // setup
+                    S_CURR.u = S_PREV.u;
+                S_CURR.u += state->upow[state->rlen+state->depth-1];
+                ++S_CURR.i;
+                if (!is_prime64(S_CURR.u))
+                    continue;
+                mpz_set_ui(S_CURR.n,S_CURR.u);
+            }
+            else
+            {
+                if (S_CURR.i == 1) // setup
+                    mpz_set(S_CURR.n,S_PREV.n);
+                if (state->rlen + state->depth > state->plen)
+                    TP_resize_powers(state,state->rlen+state->depth);
+                mpz_add(S_CURR.n,S_CURR.n,
+                    state->pow[state->rlen+state->depth-1]);
+                ++S_CURR.i;
+                if (!PRIME_TEST(S_CURR.n))
+                    continue;
             }
+            ++S_CURR.c;
+            ++state->depth;
+            if (state->depth >= state->slen)
+                TP_resize_stack(state,state->depth+1);
+            S_CURR.v[0] = S_PREV.i-1; // digit
+            S_CURR.i = S_CURR.c = 0;
         }
         else // yield end
         {
-            set_value(state->mode==TP_POST_ORDER,value,
-                state->rlen+state->depth-1,&S_PREV.n,S_CURR.c,S_PREV.i-1);
+            set_value(mode==TP_POST_ORDER,value,
+                state->rlen+state->depth-1,&S_PREV.n,S_CURR.c,S_PREV.i-1,copy);
             --state->depth;
             ret[0] = 255;
             return 1;
@@ -354,7 +429,8 @@ uint32_t TP_next_l(TP_STATE *state, char *ret, TP_VALUE *value)
     }
 }
 
-uint32_t TP_next_lor(TP_STATE *state, char *ret, TP_VALUE *value)
+static inline uint32_t TP_step_lor(TP_STATE *state, char *ret,
+        TP_VALUE *value, uint32_t mode, mpz_t *copy)
 {
     if (state->depth == 0)
         return 0;
@@ -363,57 +439,84 @@ uint32_t TP_next_lor(TP_STATE *state, char *ret, TP_VALUE *value)
         if (S_CURR.i == 0) // yield root
         {
             ++S_CURR.i;
-            set_value(state->mode==TP_PRE_ORDER,value,
-                state->rlen+state->depth-1,&S_PREV.n,-1,S_PREV.i-1);
+            set_value(mode==TP_PRE_ORDER,value,
+                state->rlen+state->depth-1,&S_PREV.n,-1,S_PREV.i-1,copy);
             ret[0] = S_CURR.v[0];
             ret[1] = S_CURR.v[1];
             return 2;
         }
-        else if (state->rlen + state->depth > state->maxlen)
-            S_CURR.i = S_BASE;
+        else if (S_CURR.i < 2*S_BASE
+              && state->rlen + state->depth > state->maxlen)
+            S_CURR.i = 2*S_BASE;
         else if (S_CURR.i < S_BASE) // append left
         {
-            if (S_CURR.i == 1) // setup
-                mpz_set(S_CURR.n,S_PREV.n);
-            if (state->rlen + state->depth > state->plen)
-                TP_resize_powers(state,state->rlen+state->depth);
-            mpz_add(S_CURR.n,S_CURR.n,state->pow[state->rlen+state->depth-1]);
-            ++S_CURR.i;
-            if (PRIME_TEST(S_CURR.n))
+            if (S_FITS64(1)) // fast path, GMP only touched for primes
             {
-                ++S_CURR.c;
-                ++state->depth;
-                if (state->depth >= state->slen)
-                    TP_resize_stack(state,state->depth+1);
-                S_CURR.v[0] = 0;
-                S_CURR.v[1] = S_PREV.i-1;
-                S_CURR.i = S_CURR.c = 0;
+                if (S_CURR.i == 1) // setup
+                    S_CURR.u = S_PREV.u;
+                S_CURR.u += state->upow[state->rlen+state->depth-1];
+                ++S_CURR.i;
+                if (!is_prime64(S_CURR.u))
+                    continue;
+                mpz_set_ui(S_CURR.n,S_CURR.u);
             }
+            else
+            {
+                if (S_CURR.i == 1) // setup
+                    mpz_set(S_CURR.n,S_PREV.n);
+                if (state->rlen + state->depth > state->plen)
+                    TP_resize_powers(state,state->rlen+state->depth);
+                mpz_add(S_CURR.n,S_CURR.n,
+                    state->pow[state->rlen+state->depth-1]);
+                ++S_CURR.i;
+                if (!PRIME_TEST(S_CURR.n))
+                    continue;
+            }
+            ++S_CURR.c;
+            ++state->depth;
+            if (state->depth >= state->slen)
+                TP_resize_stack(state,state->depth+1);
+            S_CURR.v[0] = 0;
+            S_CURR.v[1] = S_PREV.i-1;
+            S_CURR.i = S_CURR.c = 0;
         }
         else if (S_CURR.i == S_BASE) // switch to append right
         {
-            mpz_mul_ui(S_CURR.n,S_PREV.n,S_BASE);
+            if (S_FITS64(1))
+                S_CURR.u = S_PREV.u*S_BASE;
+            else
+                mpz_mul_ui(S_CURR.n,S_PREV.n,S_BASE);
             ++S_CURR.i;
         }
         else if (S_CURR.i < 2*S_BASE) // append right
         {
-            mpz_add_ui(S_CURR.n,S_CURR.n,1);
-            ++S_CURR.i;
-            if (PRIME_TEST(S_CURR.n))
+            if (S_FITS64(1))
             {
-                ++S_CURR.c;
-                ++state->depth;
-                if (state->depth >= state->slen)
-                    TP_resize_stack(state,state->depth+1);
-                S_CURR.v[0] = 1;
-                S_CURR.v[1] = S_PREV.i-1-S_BASE;
-                S_CURR.i = S_CURR.c = 0;
+                ++S_CURR.u;
+                ++S_CURR.i;
+                if (!is_prime64(S_CURR.u))
+                    continue;
+                mpz_set_ui(S_CURR.n,S_CURR.u);
+            }
+            else
+            {
+                mpz_add_ui(S_CURR.n,S_CURR.n,1);
+                ++S_CURR.i;
+                if (!PRIME_TEST(S_CURR.n))
+                    continue;
             }
+            ++S_CURR.c;
+            ++state->depth;
+            if (state->depth >= state->slen)
+                TP_resize_stack(state,state->depth+1);
+            S_CURR.v[0] = 1;
+            S_CURR.v[1] = S_PREV.i-1-S_BASE;
+            S_CURR.i = S_CURR.c = 0;
         }
         else // yield end
         {
-            set_value(state->mode==TP_POST_ORDER,value,
-                state->rlen+state->depth-1,&S_PREV.n,S_CURR.c,S_PREV.i-1);
+            set_value(mode==TP_POST_ORDER,value,
+                state->rlen+state->depth-1,&S_PREV.n,S_CURR.c,S_PREV.i-1,copy);
             --state->depth;
             ret[0] = 255;
             return 1;
@@ -421,7 +524,8 @@ uint32_t TP_next_lor(TP_STATE *state, char *ret, TP_VALUE *value)
     }
 }
 
-uint32_t TP_next_lar(TP_STATE *state, char *ret, TP_VALUE *value)
+static inline uint32_t TP_step_lar(TP_STATE *state, char *ret,
+        TP_VALUE *value, uint32_t mode, mpz_t *copy)
 {
     if (state->depth == 0)
         return 0;
@@ -430,50 +534,166 @@ uint32_t TP_next_lar(TP_STATE *state, char *ret, TP_VALUE *value)
         if (S_CURR.i == 0) // yield root
         {
             S_CURR.i = S_BASE; // skip so left append is nonzero
-            set_value(state->mode==TP_PRE_ORDER,value,
-                state->rlen+2*(state->depth-1),&S_PREV.n,-1,S_PREV.i-1);
+            set_value(mode==TP_PRE_ORDER,value,
+                state->rlen+2*(state->depth-1),&S_PREV.n,-1,S_PREV.i-1,copy);
             ret[0] = S_CURR.v[0];
             ret[1] = S_CURR.v[1];
             return 2;
         }
-        else if (state->rlen + 2*state->depth > state->maxlen)
+        else if (S_CURR.i < S_BASE*S_BASE
+              && state->rlen + 2*state->depth > state->maxlen)
             S_CURR.i = S_BASE*S_BASE;
         else if (S_CURR.i < S_BASE*S_BASE)
         {
-            if (S_CURR.i == S_BASE) // setup
-                mpz_mul_ui(S_CURR.n,S_PREV.n,S_BASE);
             if (S_CURR.i % S_BASE == 0) // increment left digit
             {
-                if (S_CURR.i != S_BASE) // reset right digit to 0
-                    mpz_sub_ui(S_CURR.n,S_CURR.n,S_BASE-1);
-                if (state->rlen + 2*state->depth > state->plen)
-                    TP_resize_powers(state,state->rlen+2*state->depth);
-                mpz_add(S_CURR.n,S_CURR.n,state->pow[state->rlen+2*state->depth-1]);
+                if (S_FITS64(2)) // fast path, GMP only touched for primes
+                {
+                    if (S_CURR.i == S_BASE) // setup
+                        S_CURR.u = S_PREV.u*S_BASE;
+                    else // reset right digit to 0
+                        S_CURR.u -= S_BASE-1;
+                    S_CURR.u += state->upow[state->rlen+2*state->depth-1];
+                }
+                else
+                {
+                    if (S_CURR.i == S_BASE) // setup
+                        mpz_mul_ui(S_CURR.n,S_PREV.n,S_BASE);
+                    else // reset right digit to 0
+                        mpz_sub_ui(S_CURR.n,S_CURR.n,S_BASE-1);
+                    if (state->rlen + 2*state->depth > state->plen)
+                        TP_resize_powers(state,state->rlen+2*state->depth);
+                    mpz_add(S_CURR.n,S_CURR.n,
+                        state->pow[state->rlen+2*state->depth-1]);
+                }
                 ++S_CURR.i;
             }
             else // increment right digit, test primality
             {
-                mpz_add_ui(S_CURR.n,S_CURR.n,1);
-                ++S_CURR.i;
-                if (PRIME_TEST(S_CURR.n))
+                if (S_FITS64(2))
+                {
+                    ++S_CURR.u;
+                    ++S_CURR.i;
+                    if (!is_prime64(S_CURR.u))
+                        continue;
+                    mpz_set_ui(S_CURR.n,S_CURR.u);
+                }
+                else
                 {
-                    ++S_CURR.c;
-                    ++state->depth;
-                    if (state->depth >= state->slen)
-                        TP_resize_stack(state,state->depth+1);
-                    S_CURR.v[0] = (S_PREV.i-1)/S_BASE;
-                    S_CURR.v[1] = (S_PREV.i-1)%S_BASE;
-                    S_CURR.i = S_CURR.c = 0;
+                    mpz_add_ui(S_CURR.n,S_CURR.n,1);
+                    ++S_CURR.i;
+                    if (!PRIME_TEST(S_CURR.n))
+                        continue;
                 }
+                ++S_CURR.c;
+                ++state->depth;
+                if (state->depth >= state->slen)
+                    TP_resize_stack(state,state->depth+1);
+                S_CURR.v[0] = (S_PREV.i-1)/S_BASE;
+                S_CURR.v[1] = (S_PREV.i-1)%S_BASE;
+                S_CURR.i = S_CURR.c = 0;
             }
         }
         else // yield end
         {
-            set_value(state->mode==TP_POST_ORDER,value,
-                state->rlen+2*(state->depth-1),&S_PREV.n,S_CURR.c,S_PREV.i-1);
+            set_value(mode==TP_POST_ORDER,value,
+                state->rlen+2*(state->depth-1),&S_PREV.n,S_CURR.c,S_PREV.i-1,copy);
             --state->depth;
             ret[0] = 255;
             return 1;
         }
     }
 }
+
+uint32_t TP_next_r(TP_STATE *state, char *ret, TP_VALUE *value)
+{
+    return TP_step_r(state,ret,value,state->mode,NULL);
+}
+
+uint32_t TP_next_l(TP_STATE *state, char *ret, TP_VALUE *value)
+{
+    return TP_step_l(state,ret,value,state->mode,NULL);
+}
+
+uint32_t TP_next_lor(TP_STATE *state, char *ret, TP_VALUE *value)
+{
+    return TP_step_lor(state,ret,value,state->mode,NULL);
+}
+
+uint32_t TP_next_lar(TP_STATE *state, char *ret, TP_VALUE *value)
+{
+    return TP_step_lar(state,ret,value,state->mode,NULL);
+}
+
+/*
+Batch interface, see tp_util.h
+The stack is grown up front (depth enters at most one frame per yielded
+element) so nothing a returned value points to is reallocated mid batch
+*/
+
+static void batch_setup(TP_STATE *state, uint32_t n, bool with_values)
+{
+    if (state->depth + n + 1 >= state->slen)
+        TP_resize_stack(state,state->depth+n+2);
+    if (with_values && state->ylen < n)
+    {
+        state->yield = realloc(state->yield,n*sizeof(*state->yield));
+        for (uint32_t i = state->ylen; i < n; ++i)
+            mpz_init(state->yield[i]);
+        state->ylen = n;
+    }
+}
+
+// one driver loop per mode so the constant mode argument folds the checks
+// inside the inlined step function
+#define BATCH_LOOP(stepfn,mode,values,copy) \
+    while (k < n) \
+    { \
+        uint32_t l = stepfn(state,bytes+2*k,values,mode,copy); \
+        if (!l) \
+            break; \
+        lens[k++] = l; \
+    }
+
+#define BATCH_FN(stepfn) \
+    uint32_t k = 0; \
+    switch (state->mode) \
+    { \
+    case TP_PRE_ORDER: \
+        batch_setup(state,n,true); \
+        BATCH_LOOP(stepfn,TP_PRE_ORDER,values+k,state->yield+k) \
+        break; \
+    case TP_POST_ORDER: \
+        batch_setup(state,n,true); \
+        BATCH_LOOP(stepfn,TP_POST_ORDER,values+k,state->yield+k) \
+        break; \
+    default: \
+        batch_setup(state,n,false); \
+        BATCH_LOOP(stepfn,TP_BYTES_ONLY,values ? values+k : NULL,NULL) \
+        break; \
+    } \
+    return k;
+
+uint32_t TP_next_batch_r(TP_STATE *state, char *bytes, uint32_t *lens,
+        TP_VALUE *values, uint32_t n)
+{
+    BATCH_FN(TP_step_r)
+}
+
+uint32_t TP_next_batch_l(TP_STATE *state, char *bytes, uint32_t *lens,
+        TP_VALUE *values, uint32_t n)
+{
+    BATCH_FN(TP_step_l)
+}
+
+uint32_t TP_next_batch_lor(TP_STATE *state, char *bytes, uint32_t *lens,
+        TP_VALUE *values, uint32_t n)
+{
+    BATCH_FN(TP_step_lor)
+}
+
+uint32_t TP_next_batch_lar(TP_STATE *state, char *bytes, uint32_t *lens,
+        TP_VALUE *values, uint32_t n)
+{
+    BATCH_FN(TP_step_lar)
+}
@@ -15,7 +15,9 @@ bool is_lar_truncprime(const mpz_t a, uint32_t b);
 // stack frame
 typedef struct
 {
-    mpz_t n; // the number to test for primality
+    mpz_t n; // the number to test for primality, set for primes only on
+             // the 64 bit fast path (yielded values are always set)
+    uint64_t u; // 64 bit mirror of n while the numbers fit in 63 bits
     uint32_t i; // the next append
     uint32_t c; // number of child nodes
     // r/l use 1..base-1
@@ -36,6 +38,11 @@ typedef struct
     uint32_t rlen; // length of root (digits in base)
     uint32_t maxlen; // maximum length of numbers allowed
     uint32_t mode; // 0 = bytes only, 1 = pre order, 2 = post order
+    // 64 bit fast path, appends are a multiply-add and primality uses the
+    // deterministic SPRP tests while the numbers fit in 63 bits, so GMP is
+    // only touched for primes on bounded-depth trees
+    uint32_t len64; // largest digit length where every value fits 63 bits
+    uint64_t *upow; // powers of the base below base^len64
     // expandable constants
     mpz_t *pow; // powers of the base (always initialized with length >= 1)
     uint32_t plen; // length of powers
@@ -43,6 +50,11 @@ typedef struct
     uint32_t depth; // index in the stack
     TP_FRAME *stack; // number stack (always initialized with length >= 1)
     uint32_t slen; // length of stack
+    // batch yield slots, sibling frames reuse stack entries so the numbers
+    // yielded by a batch call are copied here (lazily grown to the batch
+    // size, untouched by the single step functions)
+    mpz_t *yield;
+    uint32_t ylen; // length of yield
 }
 TP_STATE;
 
@@ -76,3 +88,22 @@ uint32_t TP_next_r(TP_STATE *state, char *ret, TP_VALUE *value);
 uint32_t TP_next_l(TP_STATE *state, char *ret, TP_VALUE *value);
 uint32_t TP_next_lor(TP_STATE *state, char *ret, TP_VALUE *value);
 uint32_t TP_next_lar(TP_STATE *state, char *ret, TP_VALUE *value);
+
+// extract up to n elements from generator with one call, the stack walk
+// stays in one tight loop with the mode checks specialized out
+// bytes receives the byte sequences at a fixed stride of 2 (bytes+2*k),
+// lens[k] is the length of sequence k (1 or 2)
+// values[k] is set like the single step functions, or pass NULL in bytes
+// only mode to skip value bookkeeping entirely
+// unlike the single step functions the yielded numbers are copied into
+// slots owned by the state (sibling frames reuse stack entries within a
+// batch), so values[k].num stays valid until the next call on the state
+// return value is the number of elements filled, 0 at end of generator
+uint32_t TP_next_batch_r(TP_STATE *state, char *bytes, uint32_t *lens,
+        TP_VALUE *values, uint32_t n);
+uint32_t TP_next_batch_l(TP_STATE *state, char *bytes, uint32_t *lens,
+        TP_VALUE *values, uint32_t n);
+uint32_t TP_next_batch_lor(TP_STATE *state, char *bytes, uint32_t *lens,
+        TP_VALUE *values, uint32_t n);
+uint32_t TP_next_batch_lar(TP_STATE *state, char *bytes, uint32_t *lens,
+        TP_VALUE *values, uint32_t n);
@@ -0,0 +1,762 @@
+/*
+Parallel bulk verifier for finished truncprimes artifacts, so a multi day
+run can be checked instead of trusted (the root validation calls in
+truncprimes.c are commented out and re-deriving a tree was the only check).
+
+usage: ./tp_verify -m <tree|nums> -f <file> -p <prime_type> [-b base]
+        [-r root] [-t threads]
+
+-m tree verifies a tree file in the bytes format: the depth 1 subtrees are
+sharded across threads and each worker walks its subtrees (tree_reader),
+reconstructing every node's number by digit append and checking the append
+encoding and the number's primality. A node's truncatability chain is its
+ancestor path, which is verified along the way, so no chain is retested
+per node — that is why verification runs at a large multiple of generation
+speed, which tests about base (or base^2 for lar) mostly composite
+candidates per tree node while the verifier tests only the primes that
+made it into the tree. With -r the tree is a subtree run and the root's
+own chain is checked once up front.
+
+-m nums verifies a text nums file (one number per line, base 10): the file
+is split into per thread byte ranges aligned to line breaks and every
+number's full truncatability chain is checked, using is_prime64 for every
+link that fits in 63 bits and GMP only above that.
+
+Prints the verified number count and throughput on success; the first
+violation found is reported to stderr with its file offset and the exit
+status is 1.
+*/
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <gmp.h>
+
+#include "../pseudoprimes/functions.h"
+#include "tp_util.h"
+#include "tree_reader.h"
+
+// command line
+const char *OPTION_STRING = "b:f:m:p:r:t:";
+const struct option OPTION_LONG[] =
+{
+    { "base",       required_argument, 0, 'b' },
+    { "file",       required_argument, 0, 'f' },
+    { "mode",       required_argument, 0, 'm' },
+    { "prime_type", required_argument, 0, 'p' },
+    { "root",       required_argument, 0, 'r' },
+    { "threads",    required_argument, 0, 't' },
+    { 0, 0, 0, 0 }
+};
+
+uint32_t _base;
+const char *_prime_type;
+int _ptype; // TR_R/TR_L/TR_LOR/TR_LAR
+uint32_t _mult; // digits appended per tree level (2 for lar, else 1)
+uint32_t _len64; // largest digit length where every value fits 63 bits
+uint64_t *_upow; // powers of the base below base^_len64
+
+// first violation found, workers stop expanding once one is recorded
+pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+volatile bool _failed;
+char _fail_msg[256];
+
+// verified number count (summed under the lock)
+uint64_t _total;
+
+void fail(const char *what, const mpz_t num, uint64_t off)
+{
+    pthread_mutex_lock(&_lock);
+    if (!_failed)
+    {
+        char *s = mpz_get_str(NULL,10,num);
+        snprintf(_fail_msg,sizeof(_fail_msg),
+            "violation at byte %lu: %s (%.80s)",off,what,s);
+        free(s);
+        _failed = true;
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+/*
+64 bit truncatability chains, mirrors of the is_*_truncprime functions in
+tp_util.c using is_prime64 so chains below 2^63 never touch GMP
+*/
+
+bool chain_r64(uint64_t v)
+{
+    while (v)
+    {
+        if (!is_prime64(v) || v%_base == 0)
+            return false;
+        v /= _base;
+    }
+    return true;
+}
+
+// p is the value of the most significant digit (base^(digits-1))
+bool chain_l64(uint64_t v, uint64_t p)
+{
+    while (v)
+    {
+        uint64_t d = v/p;
+        if (!is_prime64(v) || d == 0)
+            return false;
+        v -= d*p;
+        p /= _base;
+    }
+    return true;
+}
+
+bool chain_lor64(uint64_t v, uint64_t p)
+{
+    if (v < _base)
+        return is_prime64(v);
+    if (!is_prime64(v))
+        return false;
+    for (;;)
+    {
+        if (v < _base)
+            return true;
+        uint64_t d = v/p;
+        if (d == 0) // digits must be nonzero to stay truncatable
+            return false;
+        uint64_t tl = v - d*p; // left truncation
+        uint64_t tr = v/_base; // right truncation
+        p /= _base;
+        bool trp = is_prime64(tr);
+        bool tlp = is_prime64(tl);
+        if (trp && tlp)
+            return chain_lor64(tr,p) || chain_lor64(tl,p);
+        if (trp)
+            v = tr;
+        else if (tlp)
+            v = tl;
+        else
+            return false;
+    }
+}
+
+bool chain_lar64(uint64_t v, uint64_t p)
+{
+    while (v)
+    {
+        uint64_t d = v/p;
+        if (!is_prime64(v) || d == 0)
+            return false;
+        v = (v - d*p)/_base; // truncate left and right
+        p /= _base*_base;
+    }
+    return true;
+}
+
+/*
+Arbitrary precision chains for numbers above 63 bits, these run the GMP
+steps of the is_*_truncprime functions only until the value fits in 63
+bits and then delegate to the 64 bit chains above
+*/
+
+#define MPZ_FITS64(n) (mpz_sizeinbase(n,2) <= 63)
+
+// whether a digit count is within the 64 bit chains, values of length
+// _len64 + 1 can still fit in 63 bits but _upow stops at base^(_len64-1)
+#define LEN_FITS64(digits) ((digits) <= _len64)
+
+bool chain_r(const mpz_t a)
+{
+    if (MPZ_FITS64(a))
+        return chain_r64(mpz_get_ui(a));
+    mpz_t n;
+    mpz_init_set(n,a);
+    bool ret = true;
+    while (!MPZ_FITS64(n))
+    {
+        if (!PRIME_TEST(n) || mpz_fdiv_ui(n,_base) == 0)
+        {
+            ret = false;
+            break;
+        }
+        mpz_div_ui(n,n,_base);
+    }
+    if (ret)
+        ret = chain_r64(mpz_get_ui(n));
+    mpz_clear(n);
+    return ret;
+}
+
+// l/lor/lar need the value of the most significant digit, digits is the
+// length of a
+static void top_power(mpz_t p, uint32_t digits)
+{
+    mpz_ui_pow_ui(p,_base,digits-1);
+}
+
+bool chain_l(const mpz_t a, uint32_t digits)
+{
+    if (LEN_FITS64(digits))
+        return chain_l64(mpz_get_ui(a),_upow[digits-1]);
+    mpz_t n,d,p;
+    mpz_init_set(n,a);
+    mpz_inits(d,p,NULL);
+    top_power(p,digits);
+    bool ret = true;
+    while (!LEN_FITS64(digits))
+    {
+        if (!PRIME_TEST(n) || (mpz_div(d,n,p), mpz_cmp_ui(d,0) == 0))
+        {
+            ret = false;
+            break;
+        }
+        mpz_submul_ui(n,p,mpz_get_ui(d));
+        mpz_div_ui(p,p,_base);
+        --digits;
+    }
+    if (ret)
+        ret = chain_l64(mpz_get_ui(n),_upow[digits-1]);
+    mpz_clears(n,d,p,NULL);
+    return ret;
+}
+
+bool chain_lor(const mpz_t a, uint32_t digits)
+{
+    if (LEN_FITS64(digits))
+        return chain_lor64(mpz_get_ui(a),_upow[digits-1]);
+    if (!PRIME_TEST(a))
+        return false;
+    mpz_t tr,tl,d,p;
+    mpz_inits(tr,tl,d,p,NULL);
+    mpz_set(tr,a);
+    top_power(p,digits);
+    bool ret;
+    for (;;)
+    {
+        if (LEN_FITS64(digits))
+        {
+            ret = chain_lor64(mpz_get_ui(tr),_upow[digits-1]);
+            break;
+        }
+        mpz_div(d,tr,p);
+        if (mpz_cmp_ui(d,0) == 0) // digits must be nonzero
+        {
+            ret = false;
+            break;
+        }
+        mpz_set(tl,tr);
+        mpz_submul_ui(tl,p,mpz_get_ui(d));
+        mpz_div_ui(tr,tr,_base);
+        mpz_div_ui(p,p,_base);
+        --digits;
+        bool trp = PRIME_TEST(tr);
+        bool tlp = PRIME_TEST(tl);
+        if (trp && tlp)
+        {
+            ret = chain_lor(tr,digits) || chain_lor(tl,digits);
+            break;
+        }
+        if (trp)
+            continue;
+        if (tlp)
+            mpz_set(tr,tl);
+        else
+        {
+            ret = false;
+            break;
+        }
+    }
+    mpz_clears(tr,tl,d,p,NULL);
+    return ret;
+}
+
+bool chain_lar(const mpz_t a, uint32_t digits)
+{
+    if (LEN_FITS64(digits))
+        return chain_lar64(mpz_get_ui(a),_upow[digits-1]);
+    mpz_t n,d,p;
+    mpz_init_set(n,a);
+    mpz_inits(d,p,NULL);
+    top_power(p,digits);
+    bool ret = true;
+    while (!LEN_FITS64(digits))
+    {
+        if (!PRIME_TEST(n) || (mpz_div(d,n,p), mpz_cmp_ui(d,0) == 0))
+        {
+            ret = false;
+            break;
+        }
+        mpz_submul_ui(n,p,mpz_get_ui(d));
+        mpz_div_ui(n,n,_base);
+        mpz_div_ui(p,p,_base*_base);
+        digits -= 2;
+    }
+    if (ret)
+        ret = chain_lar64(mpz_get_ui(n),_upow[digits-1]);
+    mpz_clears(n,d,p,NULL);
+    return ret;
+}
+
+// full chain check by prime type, digits is the length of a in _base
+bool chain_check(const mpz_t a, uint32_t digits)
+{
+    switch (_ptype)
+    {
+    case TR_R: return chain_r(a);
+    case TR_L: return chain_l(a,digits);
+    case TR_LOR: return chain_lor(a,digits);
+    default: return chain_lar(a,digits);
+    }
+}
+
+/*
+Tree verification, each worker claims depth 1 subtrees and walks them with
+tree_reader, reconstructing node numbers on a value stack
+*/
+
+TR_TREE _tree;
+mpz_t _root; // -r root, depth 1 nodes append to it when nonzero
+uint32_t _rlen; // digits of _root, 0 for a full tree
+
+uint64_t *_subtrees; // offsets of the depth 1 subtree roots
+uint64_t _nsubtrees, _next_subtree;
+
+typedef struct
+{
+    // value stack indexed by depth, lengths tracked per entry because lar
+    // full trees mix odd and even length subtrees
+    mpz_t *vals;
+    uint64_t *uvals; // 64 bit mirrors, valid while lens[i] <= _len64
+    uint32_t *lens;
+    uint32_t cap;
+    mpz_t pow; // scratch for left appends above the 64 bit range
+    uint64_t count;
+}
+WALK;
+
+static void walk_grow(WALK *w, uint32_t cap)
+{
+    w->vals = realloc(w->vals,cap*sizeof(*w->vals));
+    w->uvals = realloc(w->uvals,cap*sizeof(*w->uvals));
+    w->lens = realloc(w->lens,cap*sizeof(*w->lens));
+    for (uint32_t i = w->cap; i < cap; ++i)
+        mpz_init(w->vals[i]);
+    w->cap = cap;
+}
+
+// open callback, computes the node's number from its parent and checks the
+// append encoding and primality
+static bool walk_open(void *arg, const unsigned char *value, uint32_t depth,
+        uint64_t off)
+{
+    WALK *w = (WALK*)arg;
+    if (_failed)
+        return false; // stop expanding, some worker found a violation
+    if (depth >= w->cap)
+        walk_grow(w,2*depth);
+    uint32_t i = depth-1; // stack slot of this node
+    const mpz_t *parent = NULL;
+    uint32_t plen = _rlen;
+    if (i > 0)
+    {
+        parent = (const mpz_t*)(w->vals+(i-1));
+        plen = w->lens[i-1];
+    }
+    else if (_rlen)
+        parent = (const mpz_t*)&_root;
+    // decode the append and check the digit ranges
+    uint32_t dl = 0, dr = value[0];
+    if (_tree.vbytes == 2)
+        dl = value[0], dr = value[1];
+    bool bad = dr >= _base;
+    switch (_ptype)
+    {
+    case TR_LOR: // side byte then digit, roots are written as left appends
+        bad = bad || dl > 1 || dr == 0 || (!parent && dl != 0);
+        break;
+    case TR_LAR: // left digit 0 only for 1 digit roots
+        bad = bad || dl >= _base
+            || (parent && (dl == 0 || dr == 0));
+        break;
+    default: // r/l, the nonzero digit
+        bad = bad || dr == 0;
+        break;
+    }
+    if (bad)
+    {
+        mpz_t z;
+        mpz_init_set_ui(z,(uint64_t)dl*_base+dr);
+        fail("invalid append encoding",z,off);
+        mpz_clear(z);
+        return false;
+    }
+    uint32_t len = parent ? plen + _mult
+        : (_ptype == TR_LAR && dl ? 2 : 1);
+    w->lens[i] = len;
+    // compute the number, staying in 64 bits while it fits
+    if (len <= _len64)
+    {
+        uint64_t u;
+        if (i > 0)
+            u = w->uvals[i-1];
+        else // depth 1, the -r root or 0 for a full tree
+            u = _rlen ? mpz_get_ui(_root) : 0;
+        switch (_ptype)
+        {
+        case TR_L:
+            u = parent ? u + (uint64_t)dr*_upow[plen] : dr;
+            break;
+        case TR_LOR:
+            if (!parent)
+                u = dr;
+            else if (dl == 0) // left append
+                u += (uint64_t)dr*_upow[plen];
+            else // right append
+                u = u*_base + dr;
+            break;
+        case TR_LAR:
+            u = u*_base + (uint64_t)dl*_upow[plen+1] + dr;
+            break;
+        default: // r
+            u = u*_base + dr;
+            break;
+        }
+        w->uvals[i] = u;
+        mpz_set_ui(w->vals[i],u);
+        if (!is_prime64(u))
+        {
+            fail("composite number in tree",w->vals[i],off);
+            return false;
+        }
+    }
+    else
+    {
+        mpz_t *v = w->vals+i;
+        switch (_ptype)
+        {
+        case TR_L:
+            mpz_ui_pow_ui(w->pow,_base,plen);
+            mpz_set(*v,*parent);
+            mpz_addmul_ui(*v,w->pow,dr);
+            break;
+        case TR_LOR:
+            if (dl == 0) // left append
+            {
+                mpz_ui_pow_ui(w->pow,_base,plen);
+                mpz_set(*v,*parent);
+                mpz_addmul_ui(*v,w->pow,dr);
+            }
+            else // right append
+            {
+                mpz_mul_ui(*v,*parent,_base);
+                mpz_add_ui(*v,*v,dr);
+            }
+            break;
+        case TR_LAR:
+            mpz_ui_pow_ui(w->pow,_base,plen+1);
+            mpz_mul_ui(*v,*parent,_base);
+            mpz_addmul_ui(*v,w->pow,dl);
+            mpz_add_ui(*v,*v,dr);
+            break;
+        default: // r
+            mpz_mul_ui(*v,*parent,_base);
+            mpz_add_ui(*v,*v,dr);
+            break;
+        }
+        if (!PRIME_TEST(w->vals[i]))
+        {
+            fail("composite number in tree",w->vals[i],off);
+            return false;
+        }
+    }
+    // a depth 1 node of a full tree is a recursion root, check its (1 or 2
+    // digit) chain so every node's ancestor path starts at a valid root
+    if (!parent && !chain_check(w->vals[i],len))
+    {
+        fail("invalid recursion root",w->vals[i],off);
+        return false;
+    }
+    ++w->count;
+    return true;
+}
+
+void *tree_worker(void *arg)
+{
+    (void)arg;
+    WALK w;
+    memset(&w,0,sizeof(w));
+    walk_grow(&w,64);
+    mpz_init(w.pow);
+    for (;;)
+    {
+        pthread_mutex_lock(&_lock);
+        uint64_t i = _next_subtree++;
+        pthread_mutex_unlock(&_lock);
+        if (i >= _nsubtrees || _failed)
+            break;
+        TR_visit(&_tree,_subtrees[i],1,walk_open,NULL,&w);
+    }
+    pthread_mutex_lock(&_lock);
+    _total += w.count;
+    pthread_mutex_unlock(&_lock);
+    for (uint32_t i = 0; i < w.cap; ++i)
+        mpz_clear(w.vals[i]);
+    mpz_clear(w.pow);
+    free(w.vals);
+    free(w.uvals);
+    free(w.lens);
+    return NULL;
+}
+
+/*
+Nums verification, the mapped file is split into per thread byte ranges
+aligned to line breaks and every number's full chain is checked
+*/
+
+const char *_nums_data;
+uint64_t _nums_size;
+uint32_t _nthreads;
+uint32_t _worker_index;
+
+void *nums_worker(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&_lock);
+    uint32_t id = _worker_index++;
+    pthread_mutex_unlock(&_lock);
+    uint64_t lo = _nums_size*id/_nthreads;
+    uint64_t hi = _nums_size*(id+1)/_nthreads;
+    // a line belongs to the range containing its first character
+    if (lo && _nums_data[lo-1] != '\n')
+        while (lo < _nums_size && _nums_data[lo] != '\n')
+            ++lo;
+    mpz_t n,e;
+    mpz_inits(n,e,NULL);
+    char *buf = NULL;
+    size_t buf_alloc = 0;
+    uint64_t count = 0;
+    uint64_t pos = lo;
+    while (pos < hi && !_failed)
+    {
+        if (_nums_data[pos] == '\n')
+        {
+            ++pos;
+            continue;
+        }
+        uint64_t end = pos;
+        while (end < _nums_size && _nums_data[end] != '\n')
+            ++end;
+        uint64_t len = end-pos;
+        if (len+1 > buf_alloc)
+        {
+            buf_alloc = 2*(len+1);
+            buf = realloc(buf,buf_alloc);
+        }
+        memcpy(buf,_nums_data+pos,len);
+        buf[len] = '\0';
+        if (mpz_set_str(n,buf,10) != 0 || mpz_cmp_ui(n,0) <= 0)
+        {
+            mpz_set_ui(n,0);
+            fail("unparseable line",n,pos);
+            break;
+        }
+        uint32_t digits = 0;
+        mpz_set(e,n);
+        while (mpz_cmp_ui(e,0) > 0) // count digits
+            ++digits, mpz_div_ui(e,e,_base);
+        if (!chain_check(n,digits))
+        {
+            fail("number is not truncatable prime",n,pos);
+            break;
+        }
+        ++count;
+        pos = end+1;
+    }
+    pthread_mutex_lock(&_lock);
+    _total += count;
+    pthread_mutex_unlock(&_lock);
+    mpz_clears(n,e,NULL);
+    free(buf);
+    return NULL;
+}
+
+void run_threads(uint32_t threads, void *(*worker)(void*))
+{
+    if (threads == 1)
+    {
+        worker(NULL);
+        return;
+    }
+    pthread_t *tids = malloc(threads*sizeof(*tids));
+    for (uint32_t i = 0; i < threads; ++i)
+        if (pthread_create(tids+i,NULL,worker,NULL) != 0)
+        {
+            fprintf(stderr,"unable to create thread\n");
+            exit(1);
+        }
+    for (uint32_t i = 0; i < threads; ++i)
+        pthread_join(tids[i],NULL);
+    free(tids);
+}
+
+int main(int argc, char **argv)
+{
+    const char *filename = NULL, *mode = NULL;
+    _base = 10;
+    uint32_t threads = 1;
+    mpz_init(_root);
+    int o;
+    while ((o = getopt_long(argc,argv,OPTION_STRING,OPTION_LONG,NULL)) != -1)
+    {
+        switch (o)
+        {
+        case 'b':
+            _base = atoi(optarg);
+            break;
+        case 'f':
+            filename = optarg;
+            break;
+        case 'm':
+            mode = optarg;
+            break;
+        case 'p':
+            _prime_type = optarg;
+            break;
+        case 'r':
+            if (mpz_set_str(_root,optarg,10) != 0
+             || mpz_cmp_ui(_root,0) < 0)
+            {
+                fprintf(stderr,"root must be integer >= 0\n");
+                return 0;
+            }
+            break;
+        case 't':
+            threads = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr,"./tp_verify -m <tree|nums> -f <file> "
+                "-p <prime_type> [-b base] [-r root] [-t threads]\n");
+            return 0;
+        }
+    }
+    if (!filename || !mode || !_prime_type)
+    {
+        fprintf(stderr,"must specify mode, file and prime type\n");
+        return 0;
+    }
+    if (_base < 2 || _base > 255 || threads < 1)
+    {
+        fprintf(stderr,"invalid arguments\n");
+        return 0;
+    }
+    if (!strcmp(_prime_type,"r"))
+        _ptype = TR_R;
+    else if (!strcmp(_prime_type,"l"))
+        _ptype = TR_L;
+    else if (!strcmp(_prime_type,"lor"))
+        _ptype = TR_LOR;
+    else if (!strcmp(_prime_type,"lar"))
+        _ptype = TR_LAR;
+    else
+    {
+        fprintf(stderr,"invalid prime type %s\n",_prime_type);
+        return 0;
+    }
+    _mult = _ptype == TR_LAR ? 2 : 1;
+    // powers of the base while values fit in 63 bits
+    _len64 = 0;
+    uint64_t upow = 1;
+    while (upow <= (POW2(63)-1)/_base)
+    {
+        upow *= _base;
+        ++_len64;
+    }
+    _upow = malloc(_len64*sizeof(*_upow));
+    _upow[0] = 1;
+    for (uint32_t i = 1; i < _len64; ++i)
+        _upow[i] = _upow[i-1]*_base;
+    // digits of the -r root, its own chain is checked once
+    _rlen = 0;
+    if (mpz_cmp_ui(_root,0) > 0)
+    {
+        mpz_t e;
+        mpz_init_set(e,_root);
+        while (mpz_cmp_ui(e,0) > 0)
+            mpz_div_ui(e,e,_base), ++_rlen;
+        mpz_clear(e);
+        if (!chain_check(_root,_rlen))
+        {
+            fprintf(stderr,"root is not a %s truncatable prime\n",
+                _prime_type);
+            exit(1);
+        }
+    }
+    struct timespec t0,t1;
+    clock_gettime(CLOCK_MONOTONIC,&t0);
+    if (!strcmp(mode,"tree"))
+    {
+        TR_open(&_tree,filename,_prime_type,_base);
+        // collect the depth 1 subtree offsets for sharding
+        uint64_t alloc = 64;
+        _subtrees = malloc(alloc*sizeof(*_subtrees));
+        uint64_t off = _tree.vbytes; // past the root marker
+        while (_tree.data[off] != 255)
+        {
+            if (_nsubtrees == alloc)
+            {
+                alloc *= 2;
+                _subtrees = realloc(_subtrees,alloc*sizeof(*_subtrees));
+            }
+            _subtrees[_nsubtrees++] = off;
+            off = TR_skip(&_tree,off);
+        }
+        run_threads(threads,tree_worker);
+        TR_close(&_tree);
+    }
+    else if (!strcmp(mode,"nums"))
+    {
+        int fd = open(filename,O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd,&st) != 0)
+        {
+            fprintf(stderr,"error opening nums file\n");
+            exit(1);
+        }
+        _nums_size = st.st_size;
+        if (_nums_size)
+        {
+            _nums_data = mmap(NULL,_nums_size,PROT_READ,MAP_SHARED,fd,0);
+            if (_nums_data == MAP_FAILED)
+            {
+                fprintf(stderr,"error mapping nums file\n");
+                exit(1);
+            }
+            _nthreads = threads;
+            run_threads(threads,nums_worker);
+            munmap((void*)_nums_data,_nums_size);
+        }
+        close(fd);
+    }
+    else
+    {
+        fprintf(stderr,"invalid mode %s\n",mode);
+        return 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC,&t1);
+    if (_failed)
+    {
+        fprintf(stderr,"%s\n",_fail_msg);
+        exit(1);
+    }
+    double secs = (t1.tv_sec-t0.tv_sec) + 1e-9*(t1.tv_nsec-t0.tv_nsec);
+    printf("verified %lu numbers in %.2fs (%.0f/sec)\n",
+        _total,secs,secs > 0 ? _total/secs : 0);
+    return 0;
+}
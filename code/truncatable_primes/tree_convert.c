@@ -1,6 +1,9 @@
 /*
 Converts the tree output to integers, 1 per line, in the recursion order.
 
+-f format (--format format)
+    input format, "bytes" (default) or "packed"
+    (the packed block format written by truncprimes -f packed)
 -i base (--input_base base)
     base of the truncatable primes (2-255, default 10)
 -o base (--output_base base)
@@ -9,12 +12,20 @@ Converts the tree output to integers, 1 per line, in the recursion order.
     type of truncatable primes (r, l, lor, lar)
 -r root (--root root)
     root number used for this recursion tree (default 0)
+-t threads (--threads threads)
+    number of worker threads for decoding, default is 1 (serial)
+    with more than 1 thread the input is read into memory and split into
+    chunks of tree events (the block framing of the packed format, or an
+    indexing pass over the byte format which records the path to each
+    chunk start), worker threads then decode the chunks independently
+    and the text output is written in recursion order
 */
 
 #include <assert.h>
 #include <ctype.h>
 #include <getopt.h>
 #include <gmp.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -27,13 +38,15 @@ Global constants and variables
 */
 
 // command line arguments
-const char *OPTION_STRING = "i:o:p:r:";
+const char *OPTION_STRING = "f:i:o:p:r:t:";
 const struct option OPTION_LONG[] =
 {
+    { "format",      required_argument, 0, 'f' },
     { "input_base",  required_argument, 0, 'i' },
     { "output_base", required_argument, 0, 'o' },
     { "prime_type",  required_argument, 0, 'p' },
     { "root",        required_argument, 0, 'r' },
+    { "threads",     required_argument, 0, 't' },
     { 0,             0,                 0, 0   }
 };
 
@@ -77,14 +90,20 @@ uint32_t _g_ibase = 10;
 uint32_t _g_obase = 10;
 uint64_t _g_root = 0;
 char *_g_prime_type;
+int _g_ptype; // type code, 0 r, 1 l, 2 lor, 3 lar
+bool _g_packed = false;
+uint32_t _g_threads = 1;
+uint32_t _g_rlen0; // digit length of the root argument
 
-// for recursion
-uint32_t _g_depth;
-uint32_t _g_rlen;
-mpz_t *_g_stack;
-uint32_t _g_slen;
-mpz_t *_g_powers;
-uint32_t _g_plen;
+// for recursion, thread local so worker threads decode independently
+// _g_out is stdout for serial decoding, workers capture output in memory
+__thread uint32_t _g_depth;
+__thread uint32_t _g_rlen;
+__thread mpz_t *_g_stack;
+__thread uint32_t _g_slen;
+__thread mpz_t *_g_powers;
+__thread uint32_t _g_plen;
+__thread FILE *_g_out;
 
 // returns a pointer to the mpz_t variable representing base^p
 // grows the array of base powers when necessary
@@ -142,11 +161,11 @@ static inline void check_byte_between(int b, int lo, int hi)
     }
 }
 
-// write string of mpz_t to stdout
+// write string of mpz_t to the output stream
 static inline void write_number(const mpz_t n)
 {
-    mpz_out_str(stdout,_g_obase,n);
-    printf("\n");
+    mpz_out_str(_g_out,_g_obase,n);
+    fputc('\n',_g_out);
 }
 
 /*
@@ -305,9 +324,528 @@ void primes_lar_init()
     }
 }
 
+/*
+Packed format reading (see the format description in truncprimes.c)
+Iterates the open/close events of each block, keeping the same stack of node
+values as the recursive byte format readers above
+*/
+
+uint32_t _g_wbits, _g_vbits;
+unsigned char *_g_pk_shape, *_g_pk_values; // block buffers
+uint32_t _g_pk_salloc, _g_pk_valloc;
+
+// read a little endian u32 (block header fields)
+static inline uint32_t read_u32()
+{
+    uint32_t v = read_byte_strict();
+    v |= (uint32_t)read_byte_strict() << 8;
+    v |= (uint32_t)read_byte_strict() << 16;
+    v |= (uint32_t)read_byte_strict() << 24;
+    return v;
+}
+
+// extract the next bits (LSB first) at bit position *pos
+static inline uint32_t unpack_bits(const unsigned char *buf, uint64_t *pos,
+    uint32_t bits)
+{
+    uint32_t v = 0;
+    for (uint32_t i = 0; i < bits; ++i, ++*pos)
+        if (buf[*pos >> 3] & (1 << (*pos & 7)))
+            v |= 1 << i;
+    return v;
+}
+
+// apply an open event with packed value v, pushing the node on the stack
+// for full trees the values at depth 1 are roots and set _g_rlen
+void apply_open(uint32_t v)
+{
+    uint32_t dmask = (1u << _g_wbits) - 1;
+    bool fulltree = (_g_root == 0);
+    ++_g_depth;
+    CHECK_STACK;
+    if (fulltree && _g_depth == 1) // root value
+    {
+        if (_g_ptype == 3) // 1 or 2 digit lar root
+        {
+            uint32_t ld = v >> _g_wbits, rd = v & dmask;
+            check_byte_between(ld,-1,_g_ibase);
+            check_byte_between(rd,-1,_g_ibase);
+            check_byte_between(ld*_g_ibase+rd,1,_g_ibase*_g_ibase);
+            mpz_set_ui(STACK_CURR,ld*_g_ibase+rd);
+            _g_rlen = 1 + (ld != 0);
+        }
+        else // 1 digit root (lor roots have side 0 so v is checked)
+        {
+            check_byte_between(v,1,_g_ibase);
+            mpz_set_ui(STACK_CURR,v);
+            _g_rlen = 1;
+        }
+        return;
+    }
+    // recursion depth relative to the root value
+    uint32_t k = _g_depth - (fulltree ? 1 : 0);
+    switch (_g_ptype)
+    {
+    case 0: // right append
+        check_byte_between(v,0,_g_ibase);
+        mpz_mul_ui(STACK_CURR,STACK_PREV,_g_ibase);
+        mpz_add_ui(STACK_CURR,STACK_CURR,v);
+        break;
+    case 1: // left append
+        check_byte_between(v,0,_g_ibase);
+        mpz_set(STACK_CURR,STACK_PREV);
+        mpz_addmul_ui(STACK_CURR,*get_power(_g_rlen+k-1),v);
+        break;
+    case 2: // left or right append
+    {
+        uint32_t d = v & dmask;
+        check_byte_between(d,0,_g_ibase);
+        if (v >> _g_wbits) // right
+        {
+            mpz_mul_ui(STACK_CURR,STACK_PREV,_g_ibase);
+            mpz_add_ui(STACK_CURR,STACK_CURR,d);
+        }
+        else // left
+        {
+            mpz_set(STACK_CURR,STACK_PREV);
+            mpz_addmul_ui(STACK_CURR,*get_power(_g_rlen+k-1),d);
+        }
+        break;
+    }
+    case 3: // left and right append
+    {
+        uint32_t ld = v >> _g_wbits, rd = v & dmask;
+        check_byte_between(ld,0,_g_ibase);
+        check_byte_between(rd,0,_g_ibase);
+        mpz_mul_ui(STACK_CURR,STACK_PREV,_g_ibase);
+        mpz_addmul_ui(STACK_CURR,*get_power(_g_rlen+(k<<1)-1),ld);
+        mpz_add_ui(STACK_CURR,STACK_CURR,rd);
+        break;
+    }
+    }
+}
+
+void primes_packed()
+{
+    bool done = false; // set by the close event ending the stream
+    while (!done)
+    {
+        if (read_byte() == -1)
+        {
+            fprintf(stderr,"unexpected EOF in packed input\n");
+            exit(1);
+        }
+        --_g_buffer_index; // the byte read is part of the block header
+        uint32_t nevents = read_u32();
+        uint32_t nnodes = read_u32();
+        uint32_t depth0 = read_u32();
+        if (nnodes > nevents)
+        {
+            fprintf(stderr,"invalid packed block header\n");
+            exit(1);
+        }
+        if (depth0 != _g_depth)
+        {
+            fprintf(stderr,"packed block depth does not match\n");
+            exit(1);
+        }
+        // the path is redundant when reading sequentially, skip it
+        uint32_t hbytes = ((uint64_t)depth0*_g_vbits + 7)/8;
+        for (uint32_t i = 0; i < hbytes; ++i)
+            read_byte_strict();
+        uint32_t sbytes = (nevents + 7)/8;
+        uint32_t vbytes = ((uint64_t)nnodes*_g_vbits + 7)/8;
+        if (sbytes > _g_pk_salloc)
+        {
+            _g_pk_shape = realloc(_g_pk_shape,sbytes);
+            _g_pk_salloc = sbytes;
+        }
+        if (vbytes > _g_pk_valloc)
+        {
+            _g_pk_values = realloc(_g_pk_values,vbytes);
+            _g_pk_valloc = vbytes;
+        }
+        for (uint32_t i = 0; i < sbytes; ++i)
+            _g_pk_shape[i] = read_byte_strict();
+        for (uint32_t i = 0; i < vbytes; ++i)
+            _g_pk_values[i] = read_byte_strict();
+        uint64_t vpos = 0;
+        for (uint32_t ev = 0; ev < nevents; ++ev)
+        {
+            if (done)
+            {
+                fprintf(stderr,"events after the end of the tree\n");
+                exit(1);
+            }
+            if (!(_g_pk_shape[ev >> 3] & (1 << (ev & 7)))) // close
+            {
+                if (_g_depth == 0)
+                    done = true; // closes the entire stream
+                else
+                    --_g_depth;
+                continue;
+            }
+            uint32_t v = unpack_bits(_g_pk_values,&vpos,_g_vbits);
+            apply_open(v);
+            write_number(STACK_CURR);
+        }
+    }
+}
+
+/*
+Parallel decoding (-t)
+The input is read into memory and split into chunks of tree events, worker
+threads take chunks from a shared queue (so skewed chunk decode times
+balance) and capture their text output in memory, then the outputs are
+written to stdout in chunk order which is the recursion order
+For the packed format the chunks are simply the blocks, whose headers carry
+the path needed to seed the stack, for the byte format an indexing pass
+scans the events (no mpz work) and records the path at each chunk boundary
+*/
+
+#define CHUNK_EVENTS (1<<16) // byte format events per chunk
+
+typedef struct
+{
+    size_t offset, end; // input byte range of the chunk
+    uint32_t depth; // open nodes at the chunk start (byte format)
+    size_t path; // their values, offset into the path pool (byte format)
+    char *out_bytes; // decoded text output
+    size_t out_len;
+}
+TC_CHUNK;
+
+unsigned char *_g_input; // entire input stream
+size_t _g_input_len;
+TC_CHUNK *_g_chunks;
+uint32_t _g_chunk_count, _g_chunk_alloc;
+uint32_t *_g_path_pool; // chunk start paths, packed values end to end
+size_t _g_pool_len, _g_pool_alloc;
+uint32_t _g_chunk_next; // next chunk for a worker (guarded by chunk lock)
+pthread_mutex_t _g_chunk_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// read all of stdin into memory
+void slurp_input()
+{
+    size_t cap = BUFFER_SIZE;
+    _g_input = malloc(cap);
+    _g_input_len = 0;
+    for (;;)
+    {
+        if (_g_input_len == cap)
+        {
+            cap *= 2;
+            _g_input = realloc(_g_input,cap);
+        }
+        ssize_t r = read(0,_g_input+_g_input_len,cap-_g_input_len);
+        if (r == -1)
+        {
+            fprintf(stderr,"unable to read input\n");
+            exit(1);
+        }
+        if (r == 0) // EOF
+            break;
+        _g_input_len += r;
+    }
+}
+
+// record a chunk starting at the given input offset with the current path
+// (the end offsets are filled in once all chunks are known)
+void add_chunk(size_t offset, uint32_t depth, const uint32_t *path)
+{
+    if (_g_chunk_count == _g_chunk_alloc)
+    {
+        _g_chunk_alloc = (_g_chunk_alloc ? 2*_g_chunk_alloc : 1024);
+        _g_chunks = realloc(_g_chunks,_g_chunk_alloc*sizeof(*_g_chunks));
+    }
+    TC_CHUNK *c = _g_chunks + _g_chunk_count++;
+    c->offset = offset;
+    c->depth = depth;
+    c->path = _g_pool_len;
+    c->out_bytes = NULL;
+    c->out_len = 0;
+    if (_g_pool_len + depth > _g_pool_alloc)
+    {
+        _g_pool_alloc = (_g_pool_alloc ? 2*_g_pool_alloc : 1024);
+        while (_g_pool_len + depth > _g_pool_alloc)
+            _g_pool_alloc *= 2;
+        _g_path_pool = realloc(_g_path_pool,
+            _g_pool_alloc*sizeof(*_g_path_pool));
+    }
+    memcpy(_g_path_pool+_g_pool_len,path,depth*sizeof(*path));
+    _g_pool_len += depth;
+}
+
+// index the byte format, a linear scan of the events tracking the path
+// also validates the stream structure (the workers then trust the offsets)
+void index_bytes()
+{
+    uint32_t markers = (_g_ptype >= 2) ? 2 : 1;
+    if (_g_input_len < markers || _g_input[0] != 255
+     || (markers == 2 && _g_input[1] != 255))
+    {
+        fprintf(stderr,"invalid root byte, expected 255\n");
+        exit(1);
+    }
+    size_t pos = markers;
+    uint32_t *path = NULL;
+    uint32_t depth = 0, palloc = 0, nevents = 0;
+    add_chunk(pos,0,NULL);
+    bool done = false;
+    while (!done)
+    {
+        if (pos == _g_input_len)
+        {
+            fprintf(stderr,"expected another byte but reached EOF\n");
+            exit(1);
+        }
+        uint32_t b = _g_input[pos++];
+        if (b == 255) // close
+        {
+            if (depth == 0)
+                done = true; // closes the entire stream
+            else
+                --depth;
+        }
+        else // open, normalize the value like the packed format
+        {
+            uint32_t v = b;
+            if (_g_ptype >= 2) // 2 byte values
+            {
+                if (pos == _g_input_len)
+                {
+                    fprintf(stderr,"expected another byte but reached "
+                                    "EOF\n");
+                    exit(1);
+                }
+                uint32_t b2 = _g_input[pos++];
+                check_byte_between(b,-1,(_g_ptype == 2) ? 2 : _g_ibase);
+                check_byte_between(b2,-1,_g_ibase);
+                v = (b << _g_wbits) | b2;
+            }
+            if (depth == palloc)
+            {
+                palloc = (palloc ? 2*palloc : 64);
+                path = realloc(path,palloc*sizeof(*path));
+            }
+            path[depth++] = v;
+        }
+        if (!done && ++nevents == CHUNK_EVENTS)
+        {
+            nevents = 0;
+            add_chunk(pos,depth,path);
+        }
+    }
+    if (pos != _g_input_len)
+    {
+        fprintf(stderr,"extra bytes found at end\n");
+        exit(1);
+    }
+    for (uint32_t i = 0; i+1 < _g_chunk_count; ++i)
+        _g_chunks[i].end = _g_chunks[i+1].offset;
+    _g_chunks[_g_chunk_count-1].end = _g_input_len;
+    free(path);
+}
+
+// read a little endian u32 from the input
+static inline uint32_t get_u32(const unsigned char *p)
+{
+    return p[0] | ((uint32_t)p[1] << 8)
+        | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// index the packed format, the blocks are already framed
+void index_packed()
+{
+    size_t pos = 0;
+    while (pos < _g_input_len)
+    {
+        if (_g_input_len - pos < 12)
+        {
+            fprintf(stderr,"invalid packed block header\n");
+            exit(1);
+        }
+        uint32_t nevents = get_u32(_g_input+pos);
+        uint32_t nnodes = get_u32(_g_input+pos+4);
+        uint32_t depth0 = get_u32(_g_input+pos+8);
+        if (nnodes > nevents)
+        {
+            fprintf(stderr,"invalid packed block header\n");
+            exit(1);
+        }
+        size_t size = 12 + ((uint64_t)depth0*_g_vbits + 7)/8
+            + (nevents + 7)/8 + ((uint64_t)nnodes*_g_vbits + 7)/8;
+        if (_g_input_len - pos < size)
+        {
+            fprintf(stderr,"unexpected EOF in packed input\n");
+            exit(1);
+        }
+        add_chunk(pos,0,NULL);
+        _g_chunks[_g_chunk_count-1].end = pos + size;
+        pos += size;
+    }
+    if (_g_chunk_count == 0)
+    {
+        fprintf(stderr,"unexpected EOF in packed input\n");
+        exit(1);
+    }
+}
+
+// rebuild the stack along a path of packed values (the chunk start state)
+void seed_path(const uint32_t *path, uint32_t depth)
+{
+    mpz_set_ui(_g_stack[0],_g_root);
+    _g_depth = 0;
+    _g_rlen = _g_rlen0;
+    for (uint32_t i = 0; i < depth; ++i)
+        apply_open(path[i]);
+}
+
+// the close event ending the stream must be the very last one
+static inline void check_last_event(bool last)
+{
+    if (!last)
+    {
+        fprintf(stderr,"events after the end of the tree\n");
+        exit(1);
+    }
+}
+
+// decode a byte format chunk (an arbitrary range of events)
+void decode_bytes_chunk(TC_CHUNK *c, bool lastchunk)
+{
+    seed_path(_g_path_pool+c->path,c->depth);
+    const unsigned char *p = _g_input + c->offset;
+    const unsigned char *pend = _g_input + c->end;
+    while (p != pend)
+    {
+        uint32_t b = *p++;
+        if (b == 255) // close
+        {
+            if (_g_depth == 0) // closes the entire stream
+                check_last_event(lastchunk && p == pend);
+            else
+                --_g_depth;
+            continue;
+        }
+        uint32_t v = b;
+        if (_g_ptype >= 2) // the indexing pass validated the pairs
+            v = (b << _g_wbits) | *p++;
+        apply_open(v);
+        write_number(STACK_CURR);
+    }
+}
+
+// decode a packed format chunk (one block), seeding from its header path
+void decode_packed_chunk(TC_CHUNK *c, bool lastchunk)
+{
+    const unsigned char *p = _g_input + c->offset;
+    uint32_t nevents = get_u32(p);
+    uint32_t nnodes = get_u32(p+4);
+    uint32_t depth0 = get_u32(p+8);
+    const unsigned char *hpath = p + 12;
+    const unsigned char *shape = hpath + ((uint64_t)depth0*_g_vbits + 7)/8;
+    const unsigned char *values = shape + (nevents + 7)/8;
+    (void)nnodes;
+    mpz_set_ui(_g_stack[0],_g_root);
+    _g_depth = 0;
+    _g_rlen = _g_rlen0;
+    uint64_t hpos = 0;
+    for (uint32_t i = 0; i < depth0; ++i)
+        apply_open(unpack_bits(hpath,&hpos,_g_vbits));
+    uint64_t vpos = 0;
+    for (uint32_t ev = 0; ev < nevents; ++ev)
+    {
+        if (!(shape[ev >> 3] & (1 << (ev & 7)))) // close
+        {
+            if (_g_depth == 0) // closes the entire stream
+                check_last_event(lastchunk && ev == nevents-1);
+            else
+                --_g_depth;
+            continue;
+        }
+        uint32_t v = unpack_bits(values,&vpos,_g_vbits);
+        apply_open(v);
+        write_number(STACK_CURR);
+    }
+}
+
+// worker thread, takes chunks from the shared queue until none remain
+void *worker_main(void *arg)
+{
+    (void)arg;
+    _g_stack = malloc(sizeof(mpz_t));
+    mpz_init(_g_stack[0]);
+    _g_slen = 1;
+    _g_powers = malloc(sizeof(mpz_t));
+    mpz_init_set_ui(_g_powers[0],1);
+    _g_plen = 1;
+    for (;;)
+    {
+        pthread_mutex_lock(&_g_chunk_lock);
+        uint32_t i = _g_chunk_next++;
+        pthread_mutex_unlock(&_g_chunk_lock);
+        if (i >= _g_chunk_count)
+            break;
+        TC_CHUNK *c = _g_chunks + i;
+        _g_out = open_memstream(&c->out_bytes,&c->out_len);
+        if (_g_packed)
+            decode_packed_chunk(c,i == _g_chunk_count-1);
+        else
+            decode_bytes_chunk(c,i == _g_chunk_count-1);
+        fclose(_g_out);
+    }
+    for (uint32_t i = 0; i < _g_slen; ++i)
+        mpz_clear(_g_stack[i]);
+    free(_g_stack);
+    for (uint32_t i = 0; i < _g_plen; ++i)
+        mpz_clear(_g_powers[i]);
+    free(_g_powers);
+    return NULL;
+}
+
+// parallel conversion, see the -t option description at the top of this file
+void run_threaded()
+{
+    slurp_input();
+    if (_g_packed)
+        index_packed();
+    else
+        index_bytes();
+    uint32_t nthreads = _g_threads;
+    if (nthreads > _g_chunk_count)
+        nthreads = _g_chunk_count;
+    pthread_t *threads = malloc(nthreads*sizeof(*threads));
+    for (uint32_t i = 0; i < nthreads; ++i)
+        if (pthread_create(threads+i,NULL,worker_main,NULL) != 0)
+        {
+            fprintf(stderr,"unable to create thread\n");
+            exit(1);
+        }
+    for (uint32_t i = 0; i < nthreads; ++i)
+        pthread_join(threads[i],NULL);
+    free(threads);
+    // write the chunk outputs in recursion order
+    for (uint32_t i = 0; i < _g_chunk_count; ++i)
+    {
+        TC_CHUNK *c = _g_chunks + i;
+        if (c->out_len && fwrite(c->out_bytes,1,c->out_len,stdout)
+            != c->out_len)
+        {
+            fprintf(stderr,"unable to write output\n");
+            exit(1);
+        }
+        free(c->out_bytes);
+    }
+    free(_g_input);
+    free(_g_chunks);
+    free(_g_path_pool);
+}
+
 int main(int argc, char **argv)
 {
     // setup
+    _g_out = stdout;
     _g_buffer = malloc(BUFFER_SIZE);
     _g_buffer_index = 0;
     _g_buffer_bytes = 0;
@@ -329,6 +867,15 @@ int main(int argc, char **argv)
     {
         switch(o)
         {
+        case 'f': // input format
+            if (strcmp(optarg,"packed") == 0)
+                _g_packed = true;
+            else if (strcmp(optarg,"bytes") != 0)
+            {
+                fprintf(stderr,"invalid format: %s\n",optarg);
+                return 0;
+            }
+            break;
         case 'i': // input base
             if (!is_number(optarg))
             {
@@ -356,6 +903,14 @@ int main(int argc, char **argv)
             }
             _g_root = atoll(optarg);
             break;
+        case 't': // threads
+            if (!is_number(optarg))
+            {
+                fprintf(stderr,"threads must be a number\n");
+                return 0;
+            }
+            _g_threads = atoi(optarg);
+            break;
         default:
             fprintf(stderr,"error parsing arguments\n");
             fprintf(stderr,"tree_convert <-p prime_type> "
@@ -373,41 +928,85 @@ int main(int argc, char **argv)
         fprintf(stderr,"output base %u out of valid range (2-62)\n",_g_obase);
         return 0;
     }
+    if (!_g_prime_type)
+    {
+        fprintf(stderr,"must specify prime type\n");
+        return 0;
+    }
+    if (strcmp(_g_prime_type,"r") == 0)
+        _g_ptype = 0;
+    else if (strcmp(_g_prime_type,"l") == 0)
+        _g_ptype = 1;
+    else if (strcmp(_g_prime_type,"lor") == 0)
+        _g_ptype = 2;
+    else if (strcmp(_g_prime_type,"lar") == 0)
+        _g_ptype = 3;
+    else
+    {
+        fprintf(stderr,"invalid prime type: %s\n",_g_prime_type);
+        return 0;
+    }
     // initialize recursion
     mpz_set_ui(_g_stack[0],_g_root);
     uint64_t root = _g_root;
-    _g_rlen = 0;
+    _g_rlen0 = 0;
     while (root)
-        ++_g_rlen, root /= _g_ibase;
+        ++_g_rlen0, root /= _g_ibase;
+    _g_rlen = _g_rlen0;
     _g_depth = 0;
-    int b;
-    b = read_byte();
-    if (b != 255) // first root byte
+    // packed value widths (parallel byte chunks use them for the paths)
+    if (_g_packed || _g_threads > 1)
     {
-        fprintf(stderr,"invalid root byte %i, expected 255\n",b);
-        return 1;
+        _g_wbits = 1;
+        while ((1u << _g_wbits) < _g_ibase)
+            ++_g_wbits;
+        if (_g_ptype == 2)
+            _g_vbits = _g_wbits + 1;
+        else if (_g_ptype == 3)
+            _g_vbits = 2*_g_wbits;
+        else
+            _g_vbits = _g_wbits;
     }
-    if (strcmp(_g_prime_type,"lor") == 0 || strcmp(_g_prime_type,"lar") == 0)
+    if (_g_threads > 1)
+    {
+        run_threaded();
+        free(_g_buffer);
+        for (uint32_t i = 0; i < _g_slen; ++i)
+            mpz_clear(_g_stack[i]);
+        free(_g_stack);
+        for (uint32_t i = 0; i < _g_plen; ++i)
+            mpz_clear(_g_powers[i]);
+        free(_g_powers);
+        return 0;
+    }
+    int b;
+    if (_g_packed) // no root marker bytes in the packed format
+        primes_packed();
+    else
     {
         b = read_byte();
-        if (b != 255) // second root byte
+        if (b != 255) // first root byte
         {
             fprintf(stderr,"invalid root byte %i, expected 255\n",b);
             return 1;
         }
-    }
-    if (strcmp(_g_prime_type,"r") == 0)
-        primes_r();
-    else if (strcmp(_g_prime_type,"l") == 0)
-        primes_l();
-    else if (strcmp(_g_prime_type,"lor") == 0)
-        primes_lor();
-    else if (strcmp(_g_prime_type,"lar") == 0)
-        primes_lar_init();
-    else
-    {
-        fprintf(stderr,"invalid prime type: %s\n",_g_prime_type);
-        return 0;
+        if (_g_ptype >= 2)
+        {
+            b = read_byte();
+            if (b != 255) // second root byte
+            {
+                fprintf(stderr,"invalid root byte %i, expected 255\n",b);
+                return 1;
+            }
+        }
+        if (_g_ptype == 0)
+            primes_r();
+        else if (_g_ptype == 1)
+            primes_l();
+        else if (_g_ptype == 2)
+            primes_lor();
+        else
+            primes_lar_init();
     }
     b = read_byte();
     if (b != -1) // should be at EOF
@@ -417,6 +1016,8 @@ int main(int argc, char **argv)
     }
     // clear
     free(_g_buffer);
+    free(_g_pk_shape);
+    free(_g_pk_values);
     for (uint32_t i = 0; i < _g_slen; ++i)
         mpz_clear(_g_stack[i]);
     free(_g_stack);
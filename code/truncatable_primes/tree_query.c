@@ -0,0 +1,304 @@
+/*
+Query tool for the binary tree format built on the mmap reader in
+tree_reader.c. The tree file is mapped instead of streamed so repeated
+queries only fault in the pages they touch, and with a persisted index
+(built once with -x) jumping to one subtree of a very large tree does
+not scan the bytes before it.
+
+usage: ./tree_query -f <tree_file> -p <prime_type> [-b <base>] <action>
+
+actions (exactly one)
+-x,--index <depth>
+    build the subtree offset index at the given depth and write it to
+    <tree_file>.tridx (replacing any existing index)
+-q,--query <query>
+    count - number of nodes (primes), of the subtree at -d if given
+    levels - nodes per depth, of the subtree at -d if given
+    children - nodes per child count, of the subtree at -d if given
+    subtree - write the raw subtree bytes at -d to stdout, the output is
+        value bytes then child subtrees then the end byte (the tree format
+        without a root marker)
+
+other options
+-f,--file <tree_file>
+    the tree file to read (required)
+-p,--primetype <prime_type>
+    r, l, lor, lar (required, the format does not store it)
+-b,--base <base>
+    number base, 2-255 (default 10, the format does not store it)
+-d,--digit_path <path>
+    dot separated path values selecting a subtree, using the append
+    encoding of the stats hash: r/l the digit, lor the digit (left) or
+    base+digit (right), lar left*base+right
+*/
+
+#include <ctype.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tree_reader.h"
+
+// command line
+const char *OPTION_STRING = "b:d:f:p:q:x:";
+const struct option OPTION_LONG[] =
+{
+    {"base",required_argument,0,'b'},
+    {"digit_path",required_argument,0,'d'},
+    {"file",required_argument,0,'f'},
+    {"primetype",required_argument,0,'p'},
+    {"query",required_argument,0,'q'},
+    {"index",required_argument,0,'x'},
+    {0,0,0,0}
+};
+
+#define MAX_PATH_LEN 1024
+#define MAX_DEPTH 65536
+
+// nodes per depth for the levels query
+uint64_t _g_levels[MAX_DEPTH];
+uint32_t _g_levels_max;
+
+bool levels_open(void *arg, const unsigned char *value, uint32_t depth,
+        uint64_t off)
+{
+    (void)arg, (void)value, (void)off;
+    if (depth >= MAX_DEPTH)
+    {
+        fprintf(stderr,"tree too deep\n");
+        exit(1);
+    }
+    ++_g_levels[depth];
+    if (depth > _g_levels_max)
+        _g_levels_max = depth;
+    return true;
+}
+
+// nodes per child count for the children query, a stack tracks how many
+// children each open node has seen so far
+uint64_t *_g_children;
+uint32_t _g_children_max;
+uint32_t _g_ccount[MAX_DEPTH];
+
+bool children_open(void *arg, const unsigned char *value, uint32_t depth,
+        uint64_t off)
+{
+    (void)arg, (void)value, (void)off;
+    if (depth >= MAX_DEPTH)
+    {
+        fprintf(stderr,"tree too deep\n");
+        exit(1);
+    }
+    if (depth)
+        ++_g_ccount[depth-1];
+    _g_ccount[depth] = 0;
+    return true;
+}
+
+void children_close(void *arg, uint32_t depth)
+{
+    (void)arg;
+    uint32_t c = _g_ccount[depth];
+    ++_g_children[c];
+    if (c > _g_children_max)
+        _g_children_max = c;
+}
+
+// parse a dot separated digit path, returns its length
+uint32_t parse_path(const char *s, uint32_t *path, uint32_t limit)
+{
+    uint32_t len = 0;
+    while (*s)
+    {
+        if (!isdigit(*s) || len == MAX_PATH_LEN)
+        {
+            fprintf(stderr,"invalid digit path\n");
+            exit(1);
+        }
+        uint32_t v = 0;
+        while (isdigit(*s))
+            v = 10*v + (*s++ - '0');
+        if (v == 0 || v >= limit)
+        {
+            fprintf(stderr,"digit path value %u out of range\n",v);
+            exit(1);
+        }
+        path[len++] = v;
+        if (*s == '.')
+            ++s;
+        else if (*s)
+        {
+            fprintf(stderr,"invalid digit path\n");
+            exit(1);
+        }
+    }
+    if (len == 0)
+    {
+        fprintf(stderr,"invalid digit path\n");
+        exit(1);
+    }
+    return len;
+}
+
+int main(int argc, char **argv)
+{
+    // default values
+    uint32_t arg_base = 10; // base
+    char *arg_path = NULL; // digit path
+    char *arg_file = NULL; // tree file
+    char *arg_primetype = NULL; // "r","l","lor","lar"
+    char *arg_query = NULL; // "count","levels","children","subtree"
+    uint32_t arg_index = 0; // index depth
+    // help message
+    if (argc < 2)
+    {
+        fprintf(stderr,"usage: ./tree_query -f <tree_file> -p <prime_type> "
+            "[-b <base>] (-x <depth> | -q <query> [-d <digit_path>])\n"
+            "queries: count, levels, children, subtree\n");
+        return 0;
+    }
+    // read options
+    int o;
+    while ((o = getopt_long(argc,argv,OPTION_STRING,OPTION_LONG,NULL)) != -1)
+    {
+        switch (o)
+        {
+        case 'b': // base
+            arg_base = atoi(optarg);
+            break;
+        case 'd': // digit_path
+            arg_path = optarg;
+            break;
+        case 'f': // file
+            arg_file = optarg;
+            break;
+        case 'p': // primetype
+            arg_primetype = optarg;
+            break;
+        case 'q': // query
+            arg_query = optarg;
+            break;
+        case 'x': // index
+            arg_index = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr,"error parsing arguments\n");
+            return 0;
+        }
+    }
+    if (arg_base < 2 || arg_base > 255)
+    {
+        fprintf(stderr,"base (%u) must be in range 2-255\n",arg_base);
+        return 0;
+    }
+    if (!arg_file)
+    {
+        fprintf(stderr,"must specify tree file\n");
+        return 0;
+    }
+    if (!arg_primetype)
+    {
+        fprintf(stderr,"must specify prime type\n");
+        return 0;
+    }
+    if ((arg_query != NULL) == (arg_index != 0))
+    {
+        fprintf(stderr,"must specify exactly one of -q and -x\n");
+        return 0;
+    }
+    TR_TREE tree;
+    TR_open(&tree,arg_file,arg_primetype,arg_base);
+    // path value limit for parsing, matches the append encoding
+    uint32_t plimit = arg_base;
+    if (tree.ptype == TR_LOR)
+        plimit *= 2;
+    else if (tree.ptype == TR_LAR)
+        plimit *= arg_base;
+    // build index
+    if (arg_index)
+    {
+        TR_index_build(&tree,arg_file,arg_index);
+        printf("indexed %lu nodes at depth <= %u\n",tree.icount,tree.idepth);
+        TR_close(&tree);
+        return 0;
+    }
+    // resolve the subtree to query (the whole tree if no path given)
+    uint32_t path[MAX_PATH_LEN];
+    uint32_t plen = 0;
+    uint64_t off = 0, len = 0;
+    if (arg_path)
+    {
+        plen = parse_path(arg_path,path,plimit);
+        if (!TR_subtree(&tree,path,plen,&off,&len))
+        {
+            fprintf(stderr,"no node at the given digit path\n");
+            exit(1);
+        }
+    }
+    if (strcmp(arg_query,"count") == 0)
+    {
+        uint64_t count = 0;
+        if (plen)
+            count = TR_count(&tree,off);
+        else
+        {
+            uint64_t o = tree.vbytes;
+            while (tree.data[o] != 255)
+            {
+                count += TR_count(&tree,o);
+                o = TR_skip(&tree,o);
+            }
+        }
+        printf("%lu\n",count);
+    }
+    else if (strcmp(arg_query,"levels") == 0)
+    {
+        if (plen)
+            TR_visit(&tree,off,plen,levels_open,NULL,NULL);
+        else
+            TR_visit_all(&tree,levels_open,NULL,NULL);
+        for (uint32_t i = plen ? plen : 1; i <= _g_levels_max; ++i)
+            printf("%u,%lu\n",i,_g_levels[i]);
+    }
+    else if (strcmp(arg_query,"children") == 0)
+    {
+        _g_children = calloc(plimit,sizeof(*_g_children));
+        if (plen)
+            TR_visit(&tree,off,plen,children_open,children_close,NULL);
+        else
+            TR_visit_all(&tree,children_open,children_close,NULL);
+        for (uint32_t i = 0; i <= _g_children_max; ++i)
+            printf("%u,%lu\n",i,_g_children[i]);
+        free(_g_children);
+    }
+    else if (strcmp(arg_query,"subtree") == 0)
+    {
+        if (!plen)
+        {
+            fprintf(stderr,"subtree query requires a digit path\n");
+            return 0;
+        }
+        uint64_t done = 0;
+        while (done < len)
+        {
+            ssize_t w = write(1,tree.data+off+done,len-done);
+            if (w <= 0)
+            {
+                fprintf(stderr,"unable to write output\n");
+                exit(1);
+            }
+            done += w;
+        }
+    }
+    else
+    {
+        fprintf(stderr,"invalid query %s\n",arg_query);
+        return 0;
+    }
+    TR_close(&tree);
+    return 0;
+}
@@ -0,0 +1,413 @@
+/*
+Memory mapped reader for the binary tree format, see tree_reader.h.
+
+At a node boundary a byte below 255 opens a node (its value is vbytes
+bytes, digits are below the base so never 255) and the byte 255 closes
+the enclosing child list, so the structure can be walked with a depth
+counter and no allocation. The root marker (255 repeated vbytes times)
+at the start of the file is skipped on open.
+
+Index file format (<file>.tridx, little endian):
+    u64 magic "TPTRIDX1"
+    u32 prime type code, u32 base, u32 index depth, u32 zero
+    u64 entry count, u64 tree file size (for staleness detection)
+    count u32 entry depths
+    count*depth u32 entry path values (zero padded past the entry depth)
+    count u64 entry offsets (of the value bytes)
+    count u64 entry subtree byte lengths
+Entries are all nodes with depth <= index depth in pre order. A mismatch
+in any header field (including the tree size) rejects the index silently
+so a stale file behaves like no index.
+*/
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tree_reader.h"
+
+#define TRIDX_MAGIC 0x3158444952545054uL // "TPTRIDX1" little endian
+#define TRIDX_SUFFIX ".tridx"
+
+// exit for structurally invalid tree bytes
+static void tree_invalid()
+{
+    fprintf(stderr,"invalid tree file\n");
+    exit(1);
+}
+
+static char *index_filename(const char *path)
+{
+    char *ret = malloc(strlen(path)+strlen(TRIDX_SUFFIX)+1);
+    strcpy(ret,path);
+    strcat(ret,TRIDX_SUFFIX);
+    return ret;
+}
+
+// load <file>.tridx if present and consistent with the tree file
+static void index_load(TR_TREE *t, const char *path)
+{
+    char *iname = index_filename(path);
+    FILE *f = fopen(iname,"rb");
+    free(iname);
+    if (!f)
+        return; // no index, everything falls back to scanning
+    uint64_t header[2];
+    uint32_t params[4];
+    uint64_t sizes[2];
+    if (fread(header,sizeof(uint64_t),1,f) != 1
+     || header[0] != TRIDX_MAGIC
+     || fread(params,sizeof(uint32_t),4,f) != 4
+     || params[0] != (uint32_t)t->ptype || params[1] != t->base
+     || params[2] == 0 || params[3] != 0
+     || fread(sizes,sizeof(uint64_t),2,f) != 2
+     || sizes[1] != t->size)
+    {
+        fclose(f);
+        return; // stale or foreign index, ignore it
+    }
+    uint32_t depth = params[2];
+    uint64_t count = sizes[0];
+    uint32_t *depths = malloc(count*sizeof(*depths));
+    uint32_t *paths = malloc(count*depth*sizeof(*paths));
+    uint64_t *offs = malloc(count*sizeof(*offs));
+    uint64_t *lens = malloc(count*sizeof(*lens));
+    if (fread(depths,sizeof(*depths),count,f) != count
+     || fread(paths,sizeof(*paths),count*depth,f) != count*depth
+     || fread(offs,sizeof(*offs),count,f) != count
+     || fread(lens,sizeof(*lens),count,f) != count)
+    {
+        fclose(f);
+        free(depths);
+        free(paths);
+        free(offs);
+        free(lens);
+        return;
+    }
+    fclose(f);
+    t->idepth = depth;
+    t->icount = count;
+    t->idepths = depths;
+    t->ipaths = paths;
+    t->ioffs = offs;
+    t->ilens = lens;
+}
+
+void TR_open(TR_TREE *t, const char *path, const char *prime_type,
+        uint32_t base)
+{
+    if (strcmp(prime_type,"r") == 0)
+        t->ptype = TR_R;
+    else if (strcmp(prime_type,"l") == 0)
+        t->ptype = TR_L;
+    else if (strcmp(prime_type,"lor") == 0)
+        t->ptype = TR_LOR;
+    else if (strcmp(prime_type,"lar") == 0)
+        t->ptype = TR_LAR;
+    else
+    {
+        fprintf(stderr,"invalid prime type %s\n",prime_type);
+        exit(1);
+    }
+    t->base = base;
+    t->vbytes = (t->ptype == TR_LOR || t->ptype == TR_LAR) ? 2 : 1;
+    int fd = open(path,O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd,&st) != 0)
+    {
+        fprintf(stderr,"unable to open tree file %s\n",path);
+        exit(1);
+    }
+    t->size = st.st_size;
+    // smallest valid tree is the root marker and its end byte
+    if (t->size < (uint64_t)t->vbytes + 1)
+        tree_invalid();
+    const unsigned char *map = mmap(NULL,t->size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr,"unable to map tree file %s\n",path);
+        exit(1);
+    }
+    t->data = map;
+    for (uint32_t i = 0; i < t->vbytes; ++i)
+        if (map[i] != 255)
+            tree_invalid(); // missing root marker
+    t->idepth = 0;
+    t->icount = 0;
+    t->idepths = NULL;
+    t->ipaths = NULL;
+    t->ioffs = NULL;
+    t->ilens = NULL;
+    index_load(t,path);
+}
+
+void TR_close(TR_TREE *t)
+{
+    munmap((void*)t->data,t->size);
+    t->data = NULL;
+    t->size = 0;
+    free(t->idepths);
+    free(t->ipaths);
+    free(t->ioffs);
+    free(t->ilens);
+    t->idepths = NULL;
+    t->ipaths = NULL;
+    t->ioffs = NULL;
+    t->ilens = NULL;
+    t->icount = 0;
+    t->idepth = 0;
+}
+
+uint32_t TR_path_value(const TR_TREE *t, const unsigned char *value)
+{
+    switch (t->ptype)
+    {
+    case TR_LOR: // side byte then digit, right appends offset by base
+        return value[0] ? t->base + value[1] : value[1];
+    case TR_LAR: // left digit then right digit
+        return (uint32_t)value[0]*t->base + value[1];
+    default: // r/l, the digit
+        return value[0];
+    }
+}
+
+uint64_t TR_skip(const TR_TREE *t, uint64_t off)
+{
+    uint32_t depth = 1;
+    off += t->vbytes;
+    while (depth)
+    {
+        if (off >= t->size)
+            tree_invalid();
+        if (t->data[off] == 255)
+            ++off, --depth;
+        else
+            off += t->vbytes, ++depth;
+    }
+    return off;
+}
+
+uint64_t TR_count(const TR_TREE *t, uint64_t off)
+{
+    uint64_t count = 1;
+    uint32_t depth = 1;
+    off += t->vbytes;
+    while (depth)
+    {
+        if (off >= t->size)
+            tree_invalid();
+        if (t->data[off] == 255)
+            ++off, --depth;
+        else
+            off += t->vbytes, ++depth, ++count;
+    }
+    return count;
+}
+
+void TR_visit(const TR_TREE *t, uint64_t off, uint32_t depth,
+        TR_OPEN_FN open, TR_CLOSE_FN close, void *arg)
+{
+    uint32_t depth0 = depth;
+    for (;;)
+    {
+        if (off >= t->size)
+            tree_invalid();
+        if (t->data[off] == 255) // end of a visited node's child list
+        {
+            ++off;
+            --depth;
+            if (close)
+                close(arg,depth);
+            if (depth == depth0) // the subtree's own child list closed
+                return;
+        }
+        else if (!open || open(arg,t->data+off,depth,off))
+        {
+            off += t->vbytes;
+            ++depth;
+        }
+        else // callback declined the children
+        {
+            off = TR_skip(t,off);
+            if (depth == depth0)
+                return;
+        }
+    }
+}
+
+void TR_visit_all(const TR_TREE *t, TR_OPEN_FN open, TR_CLOSE_FN close,
+        void *arg)
+{
+    uint64_t off = t->vbytes; // past the root marker
+    while (t->data[off] != 255)
+    {
+        uint64_t end = TR_skip(t,off);
+        TR_visit(t,off,1,open,close,arg);
+        off = end;
+        if (off >= t->size)
+            tree_invalid();
+    }
+}
+
+// scan a child list starting at off for the node with the given path value,
+// skipping the subtrees of earlier siblings, returns false at the end byte
+static bool find_child(const TR_TREE *t, uint64_t off, uint32_t target,
+        uint64_t *ret)
+{
+    for (;;)
+    {
+        if (off >= t->size)
+            tree_invalid();
+        if (t->data[off] == 255)
+            return false;
+        if (TR_path_value(t,t->data+off) == target)
+        {
+            *ret = off;
+            return true;
+        }
+        off = TR_skip(t,off);
+    }
+}
+
+bool TR_subtree(const TR_TREE *t, const uint32_t *path, uint32_t plen,
+        uint64_t *off, uint64_t *len)
+{
+    if (plen == 0)
+        return false;
+    uint64_t pos;
+    uint32_t depth = 0; // depth of the located prefix
+    if (t->icount) // jump to the deepest indexed prefix
+    {
+        uint32_t want = plen < t->idepth ? plen : t->idepth;
+        for (uint64_t i = 0; i < t->icount; ++i)
+        {
+            if (t->idepths[i] != want)
+                continue;
+            if (memcmp(t->ipaths+i*t->idepth,path,want*sizeof(*path)) != 0)
+                continue;
+            pos = t->ioffs[i];
+            depth = want;
+            if (depth == plen)
+            {
+                *off = pos;
+                *len = t->ilens[i];
+                return true;
+            }
+            break;
+        }
+        if (depth == 0)
+            return false; // prefix is indexed but absent from the tree
+    }
+    uint64_t list = depth ? pos + t->vbytes : t->vbytes;
+    while (depth < plen)
+    {
+        if (!find_child(t,list,path[depth],&pos))
+            return false;
+        ++depth;
+        list = pos + t->vbytes;
+    }
+    *off = pos;
+    *len = TR_skip(t,pos) - pos;
+    return true;
+}
+
+void TR_index_build(TR_TREE *t, const char *path, uint32_t depth)
+{
+    if (depth == 0)
+    {
+        fprintf(stderr,"index depth must be positive\n");
+        exit(1);
+    }
+    // collect entries in pre order with a stack of the open shallow nodes
+    uint64_t count = 0, cap = 1024;
+    uint32_t *depths = malloc(cap*sizeof(*depths));
+    uint32_t *paths = malloc(cap*depth*sizeof(*paths));
+    uint64_t *offs = malloc(cap*sizeof(*offs));
+    uint64_t *lens = malloc(cap*sizeof(*lens));
+    uint64_t *open = malloc(depth*sizeof(*open)); // entry index per level
+    uint32_t *pbuf = malloc(depth*sizeof(*pbuf)); // current path prefix
+    uint64_t off = t->vbytes;
+    uint32_t d = 1; // depth a node opened here would have
+    while (d)
+    {
+        if (off >= t->size)
+            tree_invalid();
+        if (t->data[off] == 255)
+        {
+            ++off;
+            --d;
+            if (d && d <= depth)
+                lens[open[d-1]] = off - offs[open[d-1]];
+        }
+        else
+        {
+            if (d <= depth)
+            {
+                if (count == cap)
+                {
+                    cap *= 2;
+                    depths = realloc(depths,cap*sizeof(*depths));
+                    paths = realloc(paths,cap*depth*sizeof(*paths));
+                    offs = realloc(offs,cap*sizeof(*offs));
+                    lens = realloc(lens,cap*sizeof(*lens));
+                }
+                pbuf[d-1] = TR_path_value(t,t->data+off);
+                depths[count] = d;
+                memcpy(paths+count*depth,pbuf,d*sizeof(*pbuf));
+                memset(paths+count*depth+d,0,(depth-d)*sizeof(*pbuf));
+                offs[count] = off;
+                open[d-1] = count;
+                ++count;
+            }
+            off += t->vbytes;
+            ++d;
+        }
+    }
+    if (off != t->size)
+        tree_invalid(); // trailing bytes after the final end byte
+    free(open);
+    free(pbuf);
+    // persist beside the tree file, write then rename like the checkpoints
+    char *iname = index_filename(path);
+    char *tname = malloc(strlen(iname)+5);
+    strcpy(tname,iname);
+    strcat(tname,".tmp");
+    FILE *f = fopen(tname,"wb");
+    uint64_t magic = TRIDX_MAGIC;
+    uint32_t params[4] = {(uint32_t)t->ptype,t->base,depth,0};
+    uint64_t sizes[2] = {count,t->size};
+    if (!f
+     || fwrite(&magic,sizeof(magic),1,f) != 1
+     || fwrite(params,sizeof(uint32_t),4,f) != 4
+     || fwrite(sizes,sizeof(uint64_t),2,f) != 2
+     || fwrite(depths,sizeof(*depths),count,f) != count
+     || fwrite(paths,sizeof(*paths),count*depth,f) != count*depth
+     || fwrite(offs,sizeof(*offs),count,f) != count
+     || fwrite(lens,sizeof(*lens),count,f) != count
+     || fclose(f) != 0
+     || rename(tname,iname) != 0)
+    {
+        fprintf(stderr,"unable to write index file %s\n",iname);
+        exit(1);
+    }
+    free(iname);
+    free(tname);
+    // replace any previously loaded index with the fresh one
+    free(t->idepths);
+    free(t->ipaths);
+    free(t->ioffs);
+    free(t->ilens);
+    t->idepth = depth;
+    t->icount = count;
+    t->idepths = depths;
+    t->ipaths = paths;
+    t->ioffs = offs;
+    t->ilens = lens;
+}
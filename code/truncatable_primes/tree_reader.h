@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+Memory mapped reader for the binary tree format written by truncprimes
+(-DWRITE_TREE, "bytes" format, see the header comment in truncprimes.c).
+The file is mapped read only so repeated queries touch pages instead of
+re-reading the stream, and a persisted subtree offset index (built once at
+a chosen depth, stored beside the file as <file>.tridx) lets one subtree
+of a large tree be located without a sequential scan.
+
+Nodes are identified by file offset (of their value bytes) and by digit
+path. Path values use the same append encoding as the stats hash:
+    r/l - the digit
+    lor - the digit for left append, base + the digit for right append
+    lar - (left digit)*base + (right digit)
+The root marker is not a node, its children are depth 1.
+Malformed tree files are reported to stderr and exit(1).
+*/
+
+// prime type codes
+#define TR_R 0
+#define TR_L 1
+#define TR_LOR 2
+#define TR_LAR 3
+
+typedef struct
+{
+    const unsigned char *data; // mapped tree bytes
+    uint64_t size; // file size
+    uint32_t base;
+    int ptype; // TR_R, TR_L, TR_LOR, TR_LAR
+    uint32_t vbytes; // value bytes per node (1 for r/l, 2 for lor/lar)
+    // subtree offset index, entries are all nodes with depth <= idepth in
+    // pre order, loaded from <file>.tridx when present (icount 0 otherwise)
+    uint32_t idepth;
+    uint64_t icount;
+    uint32_t *idepths; // depth of each entry
+    uint32_t *ipaths; // icount*idepth path values (zero padded)
+    uint64_t *ioffs; // offset of each entry's value bytes
+    uint64_t *ilens; // byte length of each entry's subtree
+}
+TR_TREE;
+
+// open (mmap) a tree file and load its index if one exists beside it
+void TR_open(TR_TREE *t, const char *path, const char *prime_type,
+        uint32_t base);
+void TR_close(TR_TREE *t);
+
+// path value for the node whose value bytes are at value
+uint32_t TR_path_value(const TR_TREE *t, const unsigned char *value);
+
+// returns the offset just past the subtree whose value bytes begin at off
+uint64_t TR_skip(const TR_TREE *t, uint64_t off);
+
+// number of nodes in the subtree whose value bytes begin at off
+// (including the node itself), counted without materializing values
+uint64_t TR_count(const TR_TREE *t, uint64_t off);
+
+// pre order visitor over the subtree whose value bytes begin at off
+// (a node at the given depth), open is called per node with its value
+// bytes and may return false to skip the node's children, close is called
+// when a visited node's child list ends, either may be NULL
+// use TR_visit_all to visit the whole tree (children of the root marker)
+typedef bool (*TR_OPEN_FN)(void *arg, const unsigned char *value,
+        uint32_t depth, uint64_t off);
+typedef void (*TR_CLOSE_FN)(void *arg, uint32_t depth);
+void TR_visit(const TR_TREE *t, uint64_t off, uint32_t depth,
+        TR_OPEN_FN open, TR_CLOSE_FN close, void *arg);
+void TR_visit_all(const TR_TREE *t, TR_OPEN_FN open, TR_CLOSE_FN close,
+        void *arg);
+
+// locate the subtree at a digit path (path values as described above)
+// sets the offset of its value bytes and its byte length, returns false
+// if no such node, uses the index to avoid scanning earlier subtrees
+bool TR_subtree(const TR_TREE *t, const uint32_t *path, uint32_t plen,
+        uint64_t *off, uint64_t *len);
+
+// build the subtree offset index at the given depth and persist it beside
+// the tree file (written to a .tmp file then renamed)
+void TR_index_build(TR_TREE *t, const char *path, uint32_t depth);
@@ -6,6 +6,10 @@ Generates truncatable primes.
     valid range is 2-255, default is 10
     no plan to expand this restriction as even for right truncatable primes
     it already gets very expensive to compute the full tree for base 100
+    builds compiled with -DFIXED_BASE=n (see compile_fixed_base.sh) fix
+    the base at compile time so the digit loop bounds and multiplies are
+    constants the compiler can unroll and strength reduce, such a build
+    only accepts -b n
 -l max_length (--max_length max_length)
     maximum length in digits to compute, default is unlimited (2^32-1)
 -m min_length (--min_length min_length)
@@ -15,6 +19,19 @@ Generates truncatable primes.
     if specified, the numbers with length at least that provided with -m
     will be output to nums_file, one per line, written in base 10
     numbers are written in pre order
+-u nums_format (--nums_format nums_format)
+    format for the nums file, default is "text" (base 10, one per line)
+    "binary" writes records of raw little endian bytes (mpz_export)
+    prefixed by the digit and byte lengths, skipping the quadratic binary
+    to decimal conversions which throttle the recursion for runs
+    collecting primes of thousands of digits
+    "delta" additionally encodes a number as 4 bytes relative to its
+    recursion parent (pop count and append number) whenever the parent is
+    in the file, since consecutive pre order numbers share all but the
+    appended digits by construction; numbers without a usable parent
+    (the first after a resume, the first of each threaded job, or when the
+    parent is below the -m cutoff) fall back to full records
+    use nums_decode to recover the text form offline
 -p type (--prime_type type)
     specify type of primes, currently supported are
     r - right truncatable (A024770 for base 10)
@@ -27,6 +44,63 @@ Generates truncatable primes.
     default is 0 (for recursing the entire tree)
     this option is intended for recursing subtrees on different threads
     it is not checked if root is a valid prime of the given type
+-t threads (--threads threads)
+    number of threads to use, default is 1 (serial recursion)
+    with more than 1 thread, the tree is searched in 3 phases:
+    1. a serial pass collects the subtree roots at the split length
+    2. worker threads compute those subtrees with per thread recursion state,
+       taking the next root from a shared queue whenever they become idle so
+       skewed subtree sizes balance across the threads
+    3. a serial pass recurses the part of the tree above the split length and
+       splices in the subtree results in recursion order
+    output (tree bytes, stats, hash, nums file) is identical to a serial run
+-s split_length (--split_length split_length)
+    digit length at which subtrees become jobs for the worker threads
+    must be at least 3 and greater than the root length
+    only meaningful with -t, default is 3 digits beyond the root length
+    larger values split into more (smaller) jobs which balance better but
+    spend more time in the serial phases
+-c checkpoint_file (--checkpoint checkpoint_file)
+    periodically write the recursion state to this file (serial mode only)
+    the file is replaced atomically (written to a .tmp file then renamed)
+    stdout must be redirected to a file so its position can be recorded
+    the saved state is the digit path from the root to the current node
+    plus the partial stats arrays and hash accumulators (stats mode)
+-i secs (--checkpoint_interval secs)
+    seconds between checkpoints, default is 600
+    the clock is only checked every few thousand tree nodes so checkpoints
+    may be slightly further apart than requested
+-e checkpoint_file (--resume checkpoint_file)
+    resume an interrupted run from a checkpoint file
+    the other options must match the original run and stdout must be
+    redirected to the same output file in append mode (>> in the shell, so
+    the redirection itself does not truncate the previous output), the file
+    is then truncated to the position recorded in the checkpoint before
+    output continues
+    subtrees completed before the checkpoint are not recomputed
+-f format (--format format)
+    output format for the recursion tree, "bytes" (default) or "packed"
+    "packed" writes the succinct block format described below, typically
+    4-8x smaller than the byte format for large bases
+    only meaningful for tree output, requires serial mode and does not
+    support checkpoint/resume
+-d progress_secs (--progress progress_secs)
+    dump a machine readable progress line to stderr every progress_secs
+    seconds: nodes visited, prime tests run/passed, nodes/sec since the
+    previous dump, and the current digit path with per length node counts
+    a dump can also be requested at any time by sending SIGUSR1, which
+    works whether or not -d is given
+    the counters are plain increments so the recursion is unaffected; in
+    threaded mode they are updated without synchronization so a dump is
+    approximate, and the path shown is the dumping thread's own
+-a cache_file (--cache_file cache_file)
+    memory mapped prime certificate cache shared across processes
+    the table stores 128 bit hashes of candidates proven prime so any
+    process or thread pointed at the same file skips the BPSW test for
+    them, which pays off when subtree jobs overlap (lor trees visit
+    duplicate numbers) and across repeated runs since the file persists
+    the file is created at a fixed size on first use, lookups and
+    inserts are lock free so any number of workers can share it
 
 The main data (either the tree in binary format or the statistics in csv format
 with comment lines) is written to stdout. The extra file, if specified, will
@@ -56,6 +130,31 @@ Binary format for the recursion tree (-DWRITE_TREE):
         end <- next(bytes)
         assert(end == 255)
 
+Packed binary format (-DWRITE_TREE, -f packed):
+
+    a denser encoding of the same recursion tree, values are bit packed
+    (LSB first) with a fixed width depending on the prime type
+        w = smallest width with 2^w >= base
+        r,l - w bits, the digit appended
+        lor - w+1 bits, (side << w) | digit, side is 0 left, 1 right
+        lar - 2w bits, (left digit << w) | right digit
+              left digit is 0 for 1 digit roots
+    the tree is a stream of events in recursion order, an open event
+    carries a node value and a close event ends a node's child list (the
+    255 byte of the byte format), the event closing the entire stream is
+    the last one, there are no root marker bytes
+    events are framed into blocks of at most 65536 events:
+        u32 nevents - events in the block
+        u32 nnodes - open events in the block
+        u32 depth0 - nodes open when the block starts
+        path - depth0 bit packed values, the path from the root to where
+               the block starts (redundant for sequential reading but it
+               allows blocks to be decoded in parallel)
+        shape - ceil(nevents/8) bytes, bit i (LSB first within a byte)
+                is event i, 1 for open and 0 for close
+        values - the nnodes bit packed values in open event order
+    u32 fields are little endian, blocks follow until EOF
+
 Output format for statistics (-DWRITE_STATS):
 
     Comment lines start with #
@@ -113,13 +212,19 @@ Hashing function (-DWRITE_STATS):
 #include <fcntl.h>
 #include <getopt.h>
 #include <gmp.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "../pseudoprimes/functions.h"
+
 /*
 Ensure necessary requirements for preprocessor symbols
 */
@@ -132,43 +237,111 @@ Ensure necessary requirements for preprocessor symbols
 #error "must define either WRITE_TREE or WRITE_STATS"
 #endif
 
+#if defined (FIXED_BASE) && (FIXED_BASE < 2 || FIXED_BASE > 255)
+#error "FIXED_BASE must be in range 2-255"
+#endif
+
 /*
 Global constants and variables
 */
 
 // command line arguments
-const char *OPTION_STRING = "b:l:m:n:p:r:";
+const char *OPTION_STRING = "a:b:c:d:e:f:i:l:m:n:p:r:s:t:u:";
 const struct option OPTION_LONG[] =
 {
-    { "base",       required_argument, 0, 'b' },
-    { "max_length", required_argument, 0, 'l' },
-    { "min_length", required_argument, 0, 'm' },
-    { "num_file",   required_argument, 0, 'n' },
-    { "prime_type", required_argument, 0, 'p' },
-    { "root",       required_argument, 0, 'r' },
-    { 0,            0,                 0, 0   }
+    { "base",                required_argument, 0, 'b' },
+    { "cache_file",          required_argument, 0, 'a' },
+    { "checkpoint",          required_argument, 0, 'c' },
+    { "checkpoint_interval", required_argument, 0, 'i' },
+    { "format",              required_argument, 0, 'f' },
+    { "max_length",          required_argument, 0, 'l' },
+    { "min_length",          required_argument, 0, 'm' },
+    { "num_file",            required_argument, 0, 'n' },
+    { "nums_format",         required_argument, 0, 'u' },
+    { "prime_type",          required_argument, 0, 'p' },
+    { "progress",            required_argument, 0, 'd' },
+    { "resume",              required_argument, 0, 'e' },
+    { "root",                required_argument, 0, 'r' },
+    { "split_length",        required_argument, 0, 's' },
+    { "threads",             required_argument, 0, 't' },
+    { 0,                     0,                 0, 0   }
 };
 char *_g_prime_type;
 mpz_t _g_root;
+bool _g_packed; // packed tree output (-f packed, tree mode only)
+
+// for threaded mode
+uint32_t _g_threads; // number of worker threads, 1 for serial recursion
+uint32_t _g_split; // digit length where subtrees become worker jobs
+
+// for checkpoint/resume (serial mode only)
+// the search position is just the digit path from the root (stack values are
+// recomputable from it), see write_checkpoint for everything that is saved
+#define CKPT_CHECK_NODES 16384
+char *_g_ckpt_filename;
+char *_g_resume_filename;
+uint32_t _g_ckpt_interval; // seconds between checkpoints, 0 disables
+time_t _g_ckpt_next; // earliest time for the next checkpoint
+uint32_t _g_ckpt_countdown; // nodes until the next clock check
+bool _g_resuming; // currently descending along the saved path
+uint32_t _g_rdepth; // recursion depth recorded in the checkpoint
+int64_t _g_num_pos; // nums file position from the checkpoint (-1 for none)
+char _g_phase; // recursion phase, 'r' = explicit root, '1'/'2' = init loops
+__thread uint32_t *_g_path; // _g_path[i] = in progress append of frame i
+                            // (index 0 is the primes_init_* root loop)
 
 // for nums file, largest numbers found are output
+// _g_num_file is thread local so workers can redirect it to a memory stream
 uint32_t _g_minlength;
 char *_g_num_filename;
-FILE *_g_num_file;
+__thread FILE *_g_num_file;
 #define BUFFER_SIZE_NUMS (1<<18)
 
-// buffer
+// nums file format (-u), binary modes start with a NUMS_MAGIC header
+#define NUMS_TEXT 0
+#define NUMS_BINARY 1
+#define NUMS_DELTA 2
+#define NUMS_MAGIC 0x3130534d554e5054uL // "TPNUMS01"
+uint32_t _g_nums_format;
+// depth of the last record, -1 when there is no usable delta context (the
+// start of the file, after a resume, or the start of a worker memory stream)
+__thread int64_t _g_num_prev;
+// export buffer for full records, grown as needed
+__thread unsigned char *_g_num_buf;
+__thread size_t _g_num_buf_alloc;
+
+// buffer (thread local, workers capture their output in memory)
 #define BUFFER_SIZE_BYTES (1<<18)
 #ifdef WRITE_TREE
-char *_g_buffer;
-uint32_t _g_buffer_index;
+__thread char *_g_buffer;
+__thread uint32_t _g_buffer_index;
+// growable memory output for worker threads
+__thread bool _g_out_mem;
+__thread char *_g_mem_buf;
+__thread size_t _g_mem_len, _g_mem_cap;
+
+// append bytes to the thread local memory output
+static inline void mem_append(const char *b, size_t l)
+{
+    if (_g_mem_len + l > _g_mem_cap)
+    {
+        _g_mem_cap = (_g_mem_cap ? 2*_g_mem_cap : BUFFER_SIZE_BYTES);
+        while (_g_mem_len + l > _g_mem_cap)
+            _g_mem_cap *= 2;
+        _g_mem_buf = realloc(_g_mem_buf,_g_mem_cap);
+    }
+    memcpy(_g_mem_buf+_g_mem_len,b,l);
+    _g_mem_len += l;
+}
 #endif
 
-// write to stdout for tree mode
+// write to stdout for tree mode (or thread local memory in worker threads)
 static inline void write_buffer()
 {
 #ifdef WRITE_TREE
-    if (write(1,_g_buffer,_g_buffer_index) != _g_buffer_index)
+    if (_g_out_mem)
+        mem_append(_g_buffer,_g_buffer_index);
+    else if (write(1,_g_buffer,_g_buffer_index) != _g_buffer_index)
     {
         fprintf(stderr,"unable to write output\n");
         exit(1);
@@ -187,45 +360,264 @@ static inline void write_byte(char b)
 #endif
 }
 
+/*
+Packed tree output (-f packed)
+Collects open/close events and bit packed node values into blocks, see the
+format description at the top of this file (serial mode only so the state
+does not need to be thread local)
+*/
+
+#ifdef WRITE_TREE
+#define PACKED_BLOCK_EVENTS (1<<16)
+uint32_t _g_wbits; // smallest width with 2^_g_wbits >= _g_base
+uint32_t _g_vbits; // bits per packed value (depends on prime type)
+unsigned char _g_pk_shape[PACKED_BLOCK_EVENTS/8]; // event bits of the block
+unsigned char *_g_pk_values; // bit packed values of the block
+uint32_t _g_pk_nevents, _g_pk_nnodes;
+uint64_t _g_pk_valbit; // bit position in _g_pk_values
+uint32_t *_g_pk_path; // values of the currently open nodes
+uint32_t _g_pk_depth, _g_pk_palloc;
+uint32_t _g_pk_depth0; // open nodes when the current block started
+unsigned char *_g_pk_hpath; // their bit packed values (block header)
+uint32_t _g_pk_halloc;
+
+// append the low bits of v at bit position *pos (LSB first, buf zeroed)
+static inline void pack_bits(unsigned char *buf, uint64_t *pos,
+    uint32_t v, uint32_t bits)
+{
+    for (uint32_t i = 0; i < bits; ++i, ++*pos)
+        if ((v >> i) & 1)
+            buf[*pos >> 3] |= 1 << (*pos & 7);
+}
+
+// write a little endian u32 (packed block header fields)
+static inline void write_u32(uint32_t v)
+{
+    write_byte(v);
+    write_byte(v >> 8);
+    write_byte(v >> 16);
+    write_byte(v >> 24);
+}
+
+// write the current block and snapshot the open path for the next header
+void packed_flush()
+{
+    if (_g_pk_nevents == 0)
+        return;
+    write_u32(_g_pk_nevents);
+    write_u32(_g_pk_nnodes);
+    write_u32(_g_pk_depth0);
+    uint32_t hbytes = (_g_pk_depth0*_g_vbits + 7)/8;
+    uint32_t sbytes = (_g_pk_nevents + 7)/8;
+    uint32_t vbytes = (_g_pk_valbit + 7)/8;
+    for (uint32_t i = 0; i < hbytes; ++i)
+        write_byte(_g_pk_hpath[i]);
+    for (uint32_t i = 0; i < sbytes; ++i)
+        write_byte(_g_pk_shape[i]);
+    for (uint32_t i = 0; i < vbytes; ++i)
+        write_byte(_g_pk_values[i]);
+    memset(_g_pk_shape,0,sbytes);
+    memset(_g_pk_values,0,vbytes);
+    _g_pk_nevents = _g_pk_nnodes = 0;
+    _g_pk_valbit = 0;
+    _g_pk_depth0 = _g_pk_depth;
+    hbytes = (_g_pk_depth0*_g_vbits + 7)/8;
+    if (hbytes > _g_pk_halloc)
+    {
+        _g_pk_hpath = realloc(_g_pk_hpath,hbytes);
+        _g_pk_halloc = hbytes;
+    }
+    memset(_g_pk_hpath,0,hbytes);
+    uint64_t pos = 0;
+    for (uint32_t i = 0; i < _g_pk_depth0; ++i)
+        pack_bits(_g_pk_hpath,&pos,_g_pk_path[i],_g_vbits);
+}
+
+// record an event bit in the block shape
+static inline void packed_event(bool open)
+{
+    if (open)
+    {
+        _g_pk_shape[_g_pk_nevents >> 3] |= 1 << (_g_pk_nevents & 7);
+        ++_g_pk_nnodes;
+    }
+    ++_g_pk_nevents;
+}
+
+// open a node with the given packed value
+static inline void packed_open(uint32_t v)
+{
+    packed_event(true);
+    pack_bits(_g_pk_values,&_g_pk_valbit,v,_g_vbits);
+    if (_g_pk_depth == _g_pk_palloc)
+    {
+        _g_pk_palloc = (_g_pk_palloc ? 2*_g_pk_palloc : 64);
+        _g_pk_path = realloc(_g_pk_path,_g_pk_palloc*sizeof(*_g_pk_path));
+    }
+    _g_pk_path[_g_pk_depth++] = v;
+    if (_g_pk_nevents == PACKED_BLOCK_EVENTS)
+        packed_flush();
+}
+
+// close a node's child list (the final close of the stream leaves depth 0)
+static inline void packed_close()
+{
+    packed_event(false);
+    if (_g_pk_depth)
+        --_g_pk_depth;
+    if (_g_pk_nevents == PACKED_BLOCK_EVENTS)
+        packed_flush();
+}
+#endif
+
+/*
+Format dispatching writers used by the recursion functions
+The byte format writes values as 1 or 2 bytes with 255 terminators, the
+packed format records them as events with bit packed values
+*/
+
+// 1 byte value (r/l digit, or an init loop root with no side byte)
+static inline void write_value1(uint32_t d)
+{
+#ifdef WRITE_TREE
+    if (_g_packed)
+        packed_open(d);
+    else
+        write_byte(d);
+#else
+    (void)d;
+#endif
+}
+
+// 2 byte value (lor side then digit, lar left then right digit)
+static inline void write_value2(uint32_t a, uint32_t b)
+{
+#ifdef WRITE_TREE
+    if (_g_packed)
+        packed_open((a << _g_wbits) | b);
+    else
+    {
+        write_byte(a);
+        write_byte(b);
+    }
+#else
+    (void)a;
+    (void)b;
+#endif
+}
+
+// end of a node's child list
+static inline void write_end()
+{
+#ifdef WRITE_TREE
+    if (_g_packed)
+        packed_close();
+    else
+        write_byte(255);
+#endif
+}
+
+// root marker bytes (the packed format has none)
+static inline void write_root_marker(bool byte2)
+{
+#ifdef WRITE_TREE
+    if (_g_packed)
+        return;
+    write_byte(255);
+    if (byte2)
+        write_byte(255);
+#else
+    (void)byte2;
+#endif
+}
+
 // for recursion
 // _g_base must never be modified
 // _g_depth must be set correctly before calling a recursive function
 // _g_value must be returned to its original value afterward (backtracking)
 // _g_powers must grow when necessary and _g_plen updated accordingly
+// recursion state is thread local so worker threads recurse independently
+#ifdef FIXED_BASE
+// compile-time constant base so digit loop bounds and base multiplies are
+// literals the compiler can unroll and strength reduce
+#define _g_base ((uint32_t)(FIXED_BASE))
+#else
 uint32_t _g_base; // number base, used as a constant, must be >= 2
-uint32_t _g_depth; // recursion depth
-uint32_t _g_maxdepth; // depth limit
-uint32_t _g_rlen; // root length (digits in specified base)
+#endif
+__thread uint32_t _g_depth; // recursion depth
+__thread uint32_t _g_maxdepth; // depth limit
+__thread uint32_t _g_rlen; // root length (digits in specified base)
 uint32_t _g_maxlength; // length limit (digits in specified base), constant
-mpz_t *_g_stack; // recursion stack
-uint32_t _g_slen; // length of _g_stack
-mpz_t *_g_powers; // powers of the base, _g_powers[i] = base^i
-uint32_t _g_plen; // length of _g_powers
+uint32_t _g_mult; // digits appended per recursion level (2 for lar, else 1)
+uint32_t _g_digit_bits64; // bits in base^64, for limb pre-reservation
+__thread mpz_t *_g_stack; // recursion stack
+__thread uint32_t _g_slen; // length of _g_stack
+__thread uint32_t _g_scap; // allocated capacity of the stack arrays
+__thread mpz_t *_g_powers; // powers of the base, _g_powers[i] = base^i
+__thread uint32_t _g_plen; // length of _g_powers
+
+// sibling candidate pass masks, one row per recursion level indexed by the
+// path append number, the batch test stage of a node fills its row before
+// any child is expanded (see the comment above the recursion functions)
+uint32_t _g_batch_width; // appends per node (base, 2*base or base*base)
+__thread unsigned char *_g_cmask;
+#define BATCH_CELL(l,c) ((uint64_t)(l)*_g_batch_width+(c))
+
+// 64 bit fast path, most candidates fit in 64 bits so GMP can be bypassed
+// _g_ustack[i] mirrors _g_stack[i] while the values fit in 64 bits, the mpz
+// entries are only set for primes (needed for stats, hash and nums file)
+// so composite candidates never touch GMP at all
+uint32_t _g_len64; // largest digit length where every value fits in 63 bits
+uint64_t *_g_upowers; // powers of the base below base^_g_len64
+__thread uint64_t *_g_ustack; // 64 bit mirror of _g_stack
+
+// residue cache, _g_spmods[i] mirrors _g_stack[i] modulo a primorial so every
+// digit append updates the residue with one multiply/add and trial division
+// by the primorial factors rejects most composites before any GMP work
+// the modulus must leave room to multiply by a digit (up to 254) in 64 bits
+#define PRIMORIAL_43 13082761331670030uL
+#define SPMOD PRIMORIAL_43
+// limit for proving primality with division by the primorial factors
+#define TDIV_LIMIT (47*47)
+typedef uint64_t spmod_t;
+__thread spmod_t *_g_spmods; // residue component of the recursion stack
+__thread spmod_t *_g_power_spmods; // powers of the base modulo SPMOD
 
 // for stats output
-// uses _g_slen to keep n digit min/max arrays the same length as _g_stack
-// _g_pmin[i] = min prime of all on recursion level i
-// _g_pmax[i] = max prime of all on recursion level i
-// _g_counts[i][0] = count of non-leaf nodes on recursion level i
-// _g_counts[i][1] = count of leaf nodes on recursion level i
-// primes on recursion level i = _g_counts[i][0] + _g_counts[i][1]
-#ifdef WRITE_STATS
-mpz_t **_g_pmin, **_g_pmax;
-uint64_t **_g_counts;
+// flat arrays indexed level major by recursion level and child count, so
+// each table is one contiguous block (for lar stats in a large base a row
+// of mallocs per level is millions of scattered allocations)
+// uses _g_slen to keep them the same length as _g_stack
+// _g_pmin[STATS_CELL(i,c)] = min prime on level i with c children
+// _g_pmax[STATS_CELL(i,c)] = max prime on level i with c children
+// _g_counts[STATS_CELL(i,c)] = count of nodes on level i with c children
+#ifdef WRITE_STATS
+__thread mpz_t *_g_pmin, *_g_pmax;
+__thread uint64_t *_g_counts;
 uint32_t _g_max_children;
+#define STATS_CELL(l,c) ((uint64_t)(l)*_g_max_children+(c))
+
+// per frame hash accumulators and child counts, arrays instead of locals in
+// the recursion functions so checkpoints can save the partial values
+// index 0 is used by the root loops in the primes_init_* functions
+__thread uint64_t *_g_fhash;
+__thread uint32_t *_g_fchild;
 #endif
 
 // returns a pointer to the mpz_t variable representing base^p
 // grows the array of base powers when necessary
+// also grows the _g_power_spmods array
 static inline mpz_t *get_power(uint32_t p)
 {
     if (p >= _g_plen)
     {
         _g_powers = realloc(_g_powers,sizeof(mpz_t)*(p+1));
+        _g_power_spmods = realloc(_g_power_spmods,sizeof(spmod_t)*(p+1));
         for (uint32_t i = _g_plen; i <= p; ++i)
         {
             mpz_init(_g_powers[i]);
             mpz_mul_ui(_g_powers[i],_g_powers[i-1],_g_base);
+            _g_power_spmods[i] = (_g_power_spmods[i-1]*_g_base) % SPMOD;
         }
         _g_plen = p+1;
     }
@@ -237,42 +629,67 @@ static inline mpz_t *get_power(uint32_t p)
 static inline void update_min_max(uint32_t cc)
 {
 #ifdef WRITE_STATS
+    mpz_t *pmin = _g_pmin + STATS_CELL(_g_depth,cc);
+    mpz_t *pmax = _g_pmax + STATS_CELL(_g_depth,cc);
     // also handles updating min for initial value 0
-    if (mpz_cmp_ui(_g_pmin[_g_depth][cc],0) == 0
-     || mpz_cmp(_g_pmin[_g_depth][cc],_g_stack[_g_depth]) > 0)
-        mpz_set(_g_pmin[_g_depth][cc],_g_stack[_g_depth]);
-    if (mpz_cmp(_g_pmax[_g_depth][cc],_g_stack[_g_depth]) < 0)
-        mpz_set(_g_pmax[_g_depth][cc],_g_stack[_g_depth]);
+    if (mpz_cmp_ui(*pmin,0) == 0
+     || mpz_cmp(*pmin,_g_stack[_g_depth]) > 0)
+        mpz_set(*pmin,_g_stack[_g_depth]);
+    if (mpz_cmp(*pmax,_g_stack[_g_depth]) < 0)
+        mpz_set(*pmax,_g_stack[_g_depth]);
 #endif
 }
 
+// bits to reserve for a recursion stack entry, the numbers on level j have
+// a predictable digit count so the limb space can be allocated in one shot
+// instead of GMP growing it as the recursion deepens
+static inline uint32_t level_bits(uint32_t j)
+{
+    uint64_t len = _g_rlen + (uint64_t)(j+1)*_g_mult;
+    return (len*_g_digit_bits64 >> 6) + 1;
+}
+
 // grows the stack to ensure space for _g_stack[i]
+// capacity grows geometrically so the flat stats tables are not copied by
+// realloc one level at a time, then new levels are initialized up to i
 static inline void ensure_stack_space(uint32_t i)
 {
-    if (i >= _g_slen)
+    if (i < _g_slen)
+        return;
+    if (i >= _g_scap)
     {
-        _g_stack = realloc(_g_stack,sizeof(*_g_stack)*(i+1));
+        uint32_t cap = 2*_g_scap > i+1 ? 2*_g_scap : i+1;
+        _g_stack = realloc(_g_stack,sizeof(*_g_stack)*cap);
+        _g_ustack = realloc(_g_ustack,sizeof(*_g_ustack)*cap);
+        _g_spmods = realloc(_g_spmods,sizeof(*_g_spmods)*cap);
+        _g_path = realloc(_g_path,sizeof(*_g_path)*cap);
+        // mask rows need no initialization, the batch test stage writes the
+        // exact range the expansion stage reads
+        _g_cmask = realloc(_g_cmask,BATCH_CELL(cap,0)*sizeof(*_g_cmask));
 #ifdef WRITE_STATS
-        _g_pmin = realloc(_g_pmin,sizeof(*_g_pmin)*(i+1));
-        _g_pmax = realloc(_g_pmax,sizeof(*_g_pmax)*(i+1));
-        _g_counts = realloc(_g_counts,sizeof(*_g_counts)*(i+1));
+        _g_pmin = realloc(_g_pmin,STATS_CELL(cap,0)*sizeof(*_g_pmin));
+        _g_pmax = realloc(_g_pmax,STATS_CELL(cap,0)*sizeof(*_g_pmax));
+        _g_counts = realloc(_g_counts,STATS_CELL(cap,0)*sizeof(*_g_counts));
+        _g_fhash = realloc(_g_fhash,sizeof(*_g_fhash)*cap);
+        _g_fchild = realloc(_g_fchild,sizeof(*_g_fchild)*cap);
 #endif
-        for (uint32_t j = _g_slen; j <= i; ++j)
-        {
-            mpz_init(_g_stack[j]);
+        _g_scap = cap;
+    }
+    for (uint32_t j = _g_slen; j <= i; ++j)
+    {
+        mpz_init2(_g_stack[j],level_bits(j));
 #ifdef WRITE_STATS
-            _g_pmin[j] = malloc(_g_max_children*sizeof(**_g_pmin));
-            _g_pmax[j] = malloc(_g_max_children*sizeof(**_g_pmax));
-            _g_counts[j] = calloc(_g_max_children,sizeof(**_g_counts));
-            for (uint32_t k = 0; k < _g_max_children; ++k)
-            {
-                mpz_init(_g_pmin[j][k]);
-                mpz_init(_g_pmax[j][k]);
-            }
-#endif
+        memset(_g_counts+STATS_CELL(j,0),0,
+            _g_max_children*sizeof(*_g_counts));
+        // min/max cells stay lazily sized, most child counts never occur
+        for (uint32_t k = 0; k < _g_max_children; ++k)
+        {
+            mpz_init(_g_pmin[STATS_CELL(j,k)]);
+            mpz_init(_g_pmax[STATS_CELL(j,k)]);
         }
-        _g_slen = i+1;
+#endif
     }
+    _g_slen = i+1;
 }
 
 // checks if a string is a number
@@ -292,30 +709,38 @@ void init_globals()
     _g_buffer = malloc(BUFFER_SIZE_BYTES);
     _g_buffer_index = 0;
 #endif
-#ifdef WRITE_STATS
     if (strcmp("lor",_g_prime_type) == 0)
-        _g_max_children = 2*_g_base;
+        _g_batch_width = 2*_g_base;
     else if (strcmp("lar",_g_prime_type) == 0)
-        _g_max_children = _g_base*_g_base;
+        _g_batch_width = _g_base*_g_base;
     else
-        _g_max_children = _g_base;
-    _g_pmin = malloc(sizeof(*_g_pmin));
-    _g_pmax = malloc(sizeof(*_g_pmax));
-    _g_counts = malloc(sizeof(*_g_counts));
-    _g_pmin[0] = malloc(_g_max_children*sizeof(**_g_pmin));
-    _g_pmax[0] = malloc(_g_max_children*sizeof(**_g_pmax));
-    _g_counts[0] = calloc(_g_max_children,sizeof(**_g_counts));
-    for (uint32_t k = 0; k < _g_max_children; ++k)
-    {
-        mpz_init(_g_pmin[0][k]);
-        mpz_init(_g_pmax[0][k]);
-    }
-#endif
-    _g_stack = malloc(sizeof(mpz_t));
-    mpz_init(_g_stack[0]);
-    _g_slen = 1;
+        _g_batch_width = _g_base;
+#ifdef WRITE_STATS
+    _g_max_children = _g_batch_width;
+    _g_pmin = NULL;
+    _g_pmax = NULL;
+    _g_counts = NULL;
+    _g_fhash = NULL;
+    _g_fchild = NULL;
+#endif
+    _g_stack = NULL;
+    _g_ustack = NULL;
+    _g_spmods = NULL;
+    _g_path = NULL;
+    _g_cmask = NULL;
+    _g_slen = 0;
+    _g_scap = 0;
+    ensure_stack_space(0);
+    _g_path[0] = 0;
+    _g_num_prev = -1;
+#ifdef WRITE_STATS
+    _g_fhash[0] = 0;
+    _g_fchild[0] = 0;
+#endif
     _g_powers = malloc(sizeof(mpz_t));
     mpz_init_set_ui(_g_powers[0],1);
+    _g_power_spmods = malloc(sizeof(spmod_t));
+    _g_power_spmods[0] = 1;
     _g_plen = 1;
 }
 
@@ -330,29 +755,42 @@ void clear_globals()
 #ifdef WRITE_STATS
         for (uint32_t k = 0; k < _g_max_children; ++k)
         {
-            mpz_clear(_g_pmin[i][k]);
-            mpz_clear(_g_pmax[i][k]);
+            mpz_clear(_g_pmin[STATS_CELL(i,k)]);
+            mpz_clear(_g_pmax[STATS_CELL(i,k)]);
         }
-        free(_g_pmin[i]);
-        free(_g_pmax[i]);
-        free(_g_counts[i]);
 #endif
     }
 #ifdef WRITE_STATS
     free(_g_pmin);
     free(_g_pmax);
     free(_g_counts);
+    free(_g_fhash);
+    free(_g_fchild);
 #endif
     free(_g_stack);
+    free(_g_ustack);
+    free(_g_spmods);
+    free(_g_path);
+    free(_g_cmask);
+    free(_g_num_buf);
+    _g_num_buf = NULL;
+    _g_num_buf_alloc = 0;
     for (uint32_t i = 0; i < _g_plen; ++i)
         mpz_clear(_g_powers[i]);
     free(_g_powers);
+    free(_g_power_spmods);
 }
 
 /*
 Truncatable primes recursion functions
 These write the subtree bytes and the end byte
 The caller is responsible for writing the value byte(s)
+Each node runs in two stages: first every sibling append is tested and the
+results stored in the level's pass mask (the tests only depend on the parent
+value so they batch together instead of each one waiting for the whole
+subtree under the previous sibling), then the passing children are expanded
+in order, rebuilding each child value from the parent with a multiply/add
+The output bytes and the stats hash are identical to the fused recursion
 */
 
 // macros for recursion usage
@@ -361,10 +799,214 @@ The caller is responsible for writing the value byte(s)
 #define POWER_CURR (*get_power(_g_rlen+_g_depth-1))
 #define CHECK_STACK ensure_stack_space(_g_depth)
 
+// residue cache macros, power macro requires get_power called for the index
+#define SPMOD_CURR (_g_spmods[_g_depth])
+#define SPMOD_PREV (_g_spmods[_g_depth-1])
+#define POWER_SPMOD_CURR (_g_power_spmods[_g_rlen+_g_depth-1])
+#define SPMOD_SEED(i) (_g_spmods[i] = mpz_fdiv_ui(_g_stack[i],SPMOD))
+
+// 64 bit fast path macros, mul is digits appended per level (2 for lar)
+#define USTACK_CURR (_g_ustack[_g_depth])
+#define USTACK_PREV (_g_ustack[_g_depth-1])
+#define FITS64(mul) (_g_rlen + (mul)*_g_depth <= _g_len64)
+
+// pass mask cell for append i on the current level, indexed through the
+// global on every use because recursion below can realloc the array
+#define CMASK(i) (_g_cmask[BATCH_CELL(_g_depth,i)])
+
 // primality test to use as a macro
 // with GMP 6.2.0 it will run only a BPSW test when reps < 25
 #define PRIME_TEST(n) mpz_probab_prime_p(n,0)
-#define PRIME_TEST_CURR PRIME_TEST(STACK_CURR)
+
+/*
+Shared prime certificate cache (-a cache_file)
+An open addressed table of 128 bit candidate hashes in a memory mapped file,
+shared by every process and thread pointed at the same file. A candidate
+proven prime by one worker becomes a table lookup for all of the others.
+Only primes are stored, a miss just means the BPSW test runs normally, so a
+reader racing a half written entry safely treats it as a miss and insertion
+needs only a compare and swap on the first entry half (no locks). The table
+never grows, inserts stop at a bounded probe chain when it fills up. A hash
+collision (about 1 in 2^128) would misreport a composite as prime.
+*/
+
+#ifndef CACHE_SLOTS
+#define CACHE_SLOTS POW2(22) // table entries (16 bytes each), power of 2
+#endif
+#define CACHE_PROBE_LIMIT 64
+#define CACHE_MAGIC 0x3145484341435054uL // "TPCACHE1" little endian
+
+char *_g_cache_filename;
+uint64_t *_g_cache; // mapped table entries (uint64 pairs), NULL if unused
+uint64_t _g_cache_slots;
+
+// splitmix64 style avalanche for the candidate hash lanes
+static inline uint64_t cache_mix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9uL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebuL;
+    return x ^ (x >> 31);
+}
+
+// 128 bit hash of the candidate from its limbs, independent of the base so
+// a cache file warms any run where the same numbers appear
+static inline void cache_hash(const mpz_t n, uint64_t *h1, uint64_t *h2)
+{
+    uint64_t a = 0x9e3779b97f4a7c15uL, b = 0xd1b54a32d192ed03uL;
+    mp_size_t i, size = mpz_size(n);
+    for (i = 0; i < size; ++i)
+    {
+        uint64_t limb = mpz_getlimbn(n,i);
+        a = cache_mix(a ^ limb);
+        b = cache_mix(b + limb);
+    }
+    a = cache_mix(a ^ size);
+    b = cache_mix(b ^ size);
+    *h1 = a ? a : 1; // 0 marks an empty slot half
+    *h2 = b ? b : 1;
+}
+
+// create the cache file if needed and map the table
+void cache_open()
+{
+    int fd = open(_g_cache_filename,O_RDWR|O_CREAT,0644);
+    if (fd == -1)
+    {
+        fprintf(stderr,"unable to open cache file\n");
+        exit(1);
+    }
+    uint64_t header[2];
+    off_t end = lseek(fd,0,SEEK_END);
+    if (end == 0) // new file, write the header and extend with empty slots
+    {
+        header[0] = CACHE_MAGIC;
+        header[1] = CACHE_SLOTS;
+        if (write(fd,header,sizeof(header)) != sizeof(header) || ftruncate(fd,
+                sizeof(header)+CACHE_SLOTS*2*sizeof(uint64_t)) != 0)
+        {
+            fprintf(stderr,"unable to initialize cache file\n");
+            exit(1);
+        }
+    }
+    else if (lseek(fd,0,SEEK_SET) == (off_t)-1
+     || read(fd,header,sizeof(header)) != sizeof(header)
+     || header[0] != CACHE_MAGIC
+     || header[1] == 0 || (header[1] & (header[1]-1)) != 0
+     || end != (off_t)(sizeof(header)+header[1]*2*sizeof(uint64_t)))
+    {
+        fprintf(stderr,"invalid cache file\n");
+        exit(1);
+    }
+    size_t size = sizeof(header) + header[1]*2*sizeof(uint64_t);
+    uint64_t *map = mmap(NULL,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr,"unable to map cache file\n");
+        exit(1);
+    }
+    _g_cache_slots = header[1];
+    _g_cache = map + 2;
+}
+
+// returns true if the candidate hash is present (proven prime earlier)
+static inline bool cache_lookup(uint64_t h1, uint64_t h2)
+{
+    uint64_t mask = _g_cache_slots - 1;
+    uint64_t i = h1 & mask;
+    for (uint32_t probe = 0; probe < CACHE_PROBE_LIMIT; ++probe)
+    {
+        uint64_t lo = __atomic_load_n(_g_cache+2*i,__ATOMIC_ACQUIRE);
+        if (lo == 0)
+            return false; // empty slot ends the probe chain
+        if (lo == h1
+         && __atomic_load_n(_g_cache+2*i+1,__ATOMIC_ACQUIRE) == h2)
+            return true;
+        i = (i+1) & mask;
+    }
+    return false;
+}
+
+// records a proven prime, drops the insert when the probe window is full
+static inline void cache_insert(uint64_t h1, uint64_t h2)
+{
+    uint64_t mask = _g_cache_slots - 1;
+    uint64_t i = h1 & mask;
+    for (uint32_t probe = 0; probe < CACHE_PROBE_LIMIT; ++probe)
+    {
+        uint64_t lo = __atomic_load_n(_g_cache+2*i,__ATOMIC_ACQUIRE);
+        if (lo == 0)
+        {
+            uint64_t expect = 0;
+            if (__atomic_compare_exchange_n(_g_cache+2*i,&expect,h1,false,
+                    __ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE))
+            {
+                __atomic_store_n(_g_cache+2*i+1,h2,__ATOMIC_RELEASE);
+                return;
+            }
+            lo = expect; // another worker claimed the slot first
+        }
+        if (lo == h1) // already stored (the second half may still lag)
+            return;
+        i = (i+1) & mask;
+    }
+}
+
+// BPSW test through the cache, direct when no cache file is mapped
+static inline bool cache_prime_test(const mpz_t n)
+{
+    if (!_g_cache)
+        return PRIME_TEST(n);
+    uint64_t h1, h2;
+    cache_hash(n,&h1,&h2);
+    if (cache_lookup(h1,h2))
+        return true;
+    if (!PRIME_TEST(n))
+        return false;
+    cache_insert(h1,h2);
+    return true;
+}
+
+// trial division by the primorial factors on the cached residue
+// a shared factor divides the candidate since every factor divides SPMOD
+static inline bool is_prime_tdiv(spmod_t spmod)
+{
+    return (spmod % 2)
+        && (spmod % 3)
+        && (spmod % 5)
+        && (spmod % 7)
+        && (spmod % 11)
+        && (spmod % 13)
+        && (spmod % 17)
+        && (spmod % 19)
+        && (spmod % 23)
+        && (spmod % 29)
+        && (spmod % 31)
+        && (spmod % 37)
+        && (spmod % 41)
+        && (spmod % 43);
+}
+
+// primality test using the cached residue to reject most composites before
+// the BPSW test, small candidates are resolved by the residue alone
+static inline bool prime_test(const mpz_t n, spmod_t spmod)
+{
+    if (mpz_fits_ushort_p(n))
+    {
+        if (spmod < 64) // test bit in 2^2 + 2^3 + ... + 2^61
+            return 2891462833508853932uL & (1uL << (spmod));
+        else if (spmod < TDIV_LIMIT)
+            return is_prime_tdiv(spmod);
+    }
+    return is_prime_tdiv(spmod) && cache_prime_test(n);
+}
+
+#define PRIME_TEST_CURR prog_count(prime_test(STACK_CURR,SPMOD_CURR))
+
+// primality test for the 64 bit fast path
+// deterministic SPRP tests, with the Montgomery kernels in functions.h these
+// beat the GMP BPSW test across the whole 63 bit range
+#define U_PRIME_TEST(u) prog_count(is_prime64(u))
 
 // macros for hashing the tree
 #ifdef WRITE_TREE
@@ -381,203 +1023,1326 @@ typedef uint64_t tp_hash_t;
 #define LONG_ENOUGH(mul) (_g_rlen + (mul)*_g_depth >= _g_minlength)
 static inline void write_num(uint32_t mul)
 {
-    if (LONG_ENOUGH(mul) && _g_num_file)
+    if (!(LONG_ENOUGH(mul) && _g_num_file))
+        return;
+    if (_g_nums_format == NUMS_TEXT)
     {
         mpz_out_str(_g_num_file,10,STACK_CURR);
         fprintf(_g_num_file,"\n");
+        return;
+    }
+    // delta record: pop count to reach the parent plus the append number,
+    // usable when the parent is in the file (it is, whenever it was long
+    // enough) and the delta context is unbroken
+    if (_g_nums_format == NUMS_DELTA && _g_num_prev >= 0 && _g_depth > 0
+     && _g_rlen + mul*(_g_depth-1) >= _g_minlength
+     && _g_num_prev - _g_depth + 1 < 0xffff)
+    {
+        uint16_t rec[2];
+        rec[0] = _g_num_prev - _g_depth + 1;
+        rec[1] = _g_path[_g_depth];
+        fwrite(rec,sizeof(*rec),2,_g_num_file);
+    }
+    else // full record: 0xffff tag, digit length, byte length, raw bytes
+    {
+        size_t blen = (mpz_sizeinbase(STACK_CURR,2)+7)/8;
+        if (blen > _g_num_buf_alloc)
+        {
+            _g_num_buf_alloc = 2*blen;
+            _g_num_buf = realloc(_g_num_buf,_g_num_buf_alloc);
+        }
+        mpz_export(_g_num_buf,&blen,-1,1,0,0,STACK_CURR);
+        uint16_t tag = 0xffff;
+        uint32_t lens[2] = {_g_rlen + mul*_g_depth,(uint32_t)blen};
+        fwrite(&tag,sizeof(tag),1,_g_num_file);
+        fwrite(lens,sizeof(*lens),2,_g_num_file);
+        fwrite(_g_num_buf,1,blen,_g_num_file);
+    }
+    _g_num_prev = _g_depth;
+}
+
+/*
+Threaded mode job management
+A job is a subtree root at the split length. Jobs are discovered in recursion
+order by a serial collection pass, computed by worker threads, then spliced
+back into the serial recursion over the top of the tree.
+*/
+
+// job for a worker thread, results stored for splicing
+typedef struct
+{
+    mpz_t root; // subtree root value
+    uint32_t rlen; // digit length of root
+    char *tree_bytes; // subtree output bytes (tree mode)
+    size_t tree_len;
+    char *num_bytes; // nums file output for the subtree
+    size_t num_len;
+    uint64_t hash; // subtree hash (stats mode)
+}
+TP_JOB;
+
+TP_JOB *_g_jobs;
+uint32_t _g_job_count, _g_job_alloc;
+uint32_t _g_job_next; // next job for a worker thread (guarded by job lock)
+__thread uint32_t _g_job_cursor; // next job to splice (main thread only)
+__thread bool _g_splice; // set for the final serial pass of threaded mode
+pthread_mutex_t _g_job_lock = PTHREAD_MUTEX_INITIALIZER;
+tp_hash_t (*_g_prime_fn)(); // recursion function for the prime type
+
+// record a subtree root found by the collection pass
+void add_job(const mpz_t root, uint32_t rlen)
+{
+    if (_g_job_count == _g_job_alloc)
+    {
+        _g_job_alloc = (_g_job_alloc ? 2*_g_job_alloc : 1024);
+        _g_jobs = realloc(_g_jobs,_g_job_alloc*sizeof(*_g_jobs));
+    }
+    TP_JOB *job = _g_jobs + _g_job_count++;
+    mpz_init_set(job->root,root);
+    job->rlen = rlen;
+    job->tree_bytes = NULL;
+    job->tree_len = 0;
+    job->num_bytes = NULL;
+    job->num_len = 0;
+    job->hash = 0;
+}
+
+// splice the next job result in place of a recursive call
+// the job order matches because the collection pass and the final serial pass
+// make identical recursion decisions
+static tp_hash_t splice_job()
+{
+    if (_g_job_cursor >= _g_job_count)
+    {
+        fprintf(stderr,"internal error: ran out of job results\n");
+        exit(1);
+    }
+    TP_JOB *job = _g_jobs + _g_job_cursor++;
+#ifdef WRITE_TREE
+    write_buffer(); // flush ordered bytes before the raw copy
+    if (job->tree_len
+     && write(1,job->tree_bytes,job->tree_len) != (ssize_t)job->tree_len)
+    {
+        fprintf(stderr,"unable to write output\n");
+        exit(1);
+    }
+#endif
+    if (_g_num_file && job->num_len)
+    {
+        fwrite(job->num_bytes,1,job->num_len,_g_num_file);
+        _g_num_prev = -1; // the job's records broke this thread's context
+    }
+    free(job->tree_bytes);
+    free(job->num_bytes);
+    job->tree_bytes = job->num_bytes = NULL;
+#ifdef WRITE_STATS
+    return job->hash;
+#endif
+}
+
+// replaces the plain recursive calls in the primes_* functions
+// in the final pass of threaded mode, nodes at the split length use the
+// subtree results computed by the worker threads
+#define RECURSE(fn,len) \
+    ((_g_splice && (len) >= _g_split) ? splice_job() : fn())
+
+/*
+Checkpoint/resume
+A checkpoint is taken at the entry of a tree node, the saved state is the
+digit path from the root to that node (as the append path numbers), the
+recursion phase, the output positions, and in stats mode the partial stats
+arrays and the per frame hash accumulators. On resume the recursion descends
+along the saved path without emitting output or testing primality (the path
+nodes are known primes and their bytes are already in the output), then
+continues normally from the checkpointed node.
+*/
+
+// write a checkpoint file, atomically via a .tmp file and rename
+void write_checkpoint()
+{
+    write_buffer(); // the output position must cover all buffered bytes
+    fflush(stdout);
+    off_t out_pos = lseek(1,0,SEEK_CUR);
+    if (out_pos == (off_t)-1)
+    {
+        fprintf(stderr,"unable to get stdout position for checkpoint\n");
+        exit(1);
+    }
+    int64_t num_pos = -1;
+    if (_g_num_file)
+    {
+        fflush(_g_num_file);
+        num_pos = ftell(_g_num_file);
+    }
+    char *tmpname = malloc(strlen(_g_ckpt_filename)+5);
+    sprintf(tmpname,"%s.tmp",_g_ckpt_filename);
+    FILE *f = fopen(tmpname,"w");
+    if (!f)
+    {
+        fprintf(stderr,"error opening checkpoint file\n");
+        exit(1);
+    }
+    fprintf(f,"# tp_checkpoint\n");
+    fprintf(f,"prime_type %s\n",_g_prime_type);
+    fprintf(f,"base %u\n",_g_base);
+    fprintf(f,"root ");
+    mpz_out_str(f,10,_g_root);
+    fprintf(f,"\nmax_length %u\n",_g_maxlength);
+    fprintf(f,"min_length %u\n",_g_minlength);
+    fprintf(f,"nums_format %u\n",_g_nums_format);
+#ifdef WRITE_TREE
+    fprintf(f,"mode tree\n");
+#else
+    fprintf(f,"mode stats\n");
+#endif
+    fprintf(f,"phase %c\n",_g_phase);
+    fprintf(f,"out_pos %ld\n",(long)out_pos);
+    fprintf(f,"num_pos %ld\n",(long)num_pos);
+    fprintf(f,"depth %u\n",_g_depth);
+    fprintf(f,"path");
+    for (uint32_t i = 0; i < _g_depth; ++i)
+        fprintf(f," %u",_g_path[i]);
+    fprintf(f,"\n");
+#ifdef WRITE_STATS
+    fprintf(f,"fhash");
+    for (uint32_t i = 0; i <= _g_depth; ++i)
+        fprintf(f," %lu",_g_fhash[i]);
+    fprintf(f,"\nfchild");
+    for (uint32_t i = 0; i <= _g_depth; ++i)
+        fprintf(f," %u",_g_fchild[i]);
+    fprintf(f,"\nslen %u\n",_g_slen);
+    for (uint32_t i = 0; i < _g_slen; ++i)
+        for (uint32_t k = 0; k < _g_max_children; ++k)
+        {
+            fprintf(f,"%lu ",_g_counts[STATS_CELL(i,k)]);
+            mpz_out_str(f,10,_g_pmin[STATS_CELL(i,k)]);
+            fprintf(f," ");
+            mpz_out_str(f,10,_g_pmax[STATS_CELL(i,k)]);
+            fprintf(f,"\n");
+        }
+#endif
+    fprintf(f,"end\n");
+    if (fclose(f) != 0 || rename(tmpname,_g_ckpt_filename) != 0)
+    {
+        fprintf(stderr,"error writing checkpoint file\n");
+        exit(1);
+    }
+    free(tmpname);
+}
+
+// periodic checkpoint check, called at tree node entry (serial mode only)
+static inline void ckpt_tick()
+{
+    if (!_g_ckpt_interval || --_g_ckpt_countdown)
+        return;
+    _g_ckpt_countdown = CKPT_CHECK_NODES;
+    if (time(NULL) < _g_ckpt_next)
+        return;
+    write_checkpoint();
+    _g_ckpt_next = time(NULL) + _g_ckpt_interval;
+}
+
+/*
+Hot path instrumentation (-d progress_secs and SIGUSR1)
+Plain unsynchronized counter increments on the recursion path, so long runs
+can be watched without slowing them down. Dumps go to stderr as one line so
+they interleave cleanly with checkpoint runs and can be grepped or parsed.
+In threaded mode the totals are approximate (increments race) and the digit
+path is the dumping thread's own.
+*/
+
+#define PROG_CHECK_NODES 16384
+#define PROG_LEVELS 256 // digit lengths tracked individually
+
+volatile uint64_t _g_prog_nodes; // nodes visited
+volatile uint64_t _g_prog_tests; // prime tests run
+volatile uint64_t _g_prog_passes; // prime tests passed
+volatile uint64_t _g_prog_lnodes[PROG_LEVELS]; // nodes per digit length
+volatile sig_atomic_t _g_prog_flag; // SIGUSR1 arrived, dump on next tick
+uint32_t _g_prog_interval; // seconds between dumps, 0 = SIGUSR1 only
+time_t _g_prog_next; // earliest time for the next interval dump
+uint64_t _g_prog_rate_nodes; // node count at the previous dump
+time_t _g_prog_rate_time; // time of the previous dump
+__thread uint32_t _g_prog_countdown = PROG_CHECK_NODES;
+
+void prog_signal(int sig)
+{
+    (void)sig;
+    _g_prog_flag = 1;
+}
+
+// count a prime test and its result on the way through
+static inline bool prog_count(bool pass)
+{
+    ++_g_prog_tests;
+    if (pass)
+        ++_g_prog_passes;
+    return pass;
+}
+
+// write the progress line to stderr
+void prog_dump()
+{
+    char line[8192];
+    int pos = 0;
+    time_t now = time(NULL);
+    uint64_t nodes = _g_prog_nodes;
+    uint64_t rate = 0;
+    if (now > _g_prog_rate_time) // nodes/sec since the previous dump
+        rate = (nodes - _g_prog_rate_nodes)/(now - _g_prog_rate_time);
+    _g_prog_rate_nodes = nodes;
+    _g_prog_rate_time = now;
+    pos += snprintf(line+pos,sizeof(line)-pos,
+        "# progress nodes=%lu tests=%lu passes=%lu nodes_per_sec=%lu path=",
+        nodes,_g_prog_tests,_g_prog_passes,rate);
+    for (uint32_t i = 0; i < _g_depth && pos < (int)sizeof(line)-32; ++i)
+        pos += snprintf(line+pos,sizeof(line)-pos,"%s%u",
+            i ? "." : "",_g_path[i]);
+    pos += snprintf(line+pos,sizeof(line)-pos," levels=");
+    bool first = true;
+    for (uint32_t i = 0; i < PROG_LEVELS && pos < (int)sizeof(line)-32; ++i)
+        if (_g_prog_lnodes[i])
+        {
+            pos += snprintf(line+pos,sizeof(line)-pos,"%s%u:%lu",
+                first ? "" : ",",i,_g_prog_lnodes[i]);
+            first = false;
+        }
+    fprintf(stderr,"%s\n",line);
+}
+
+// counts a visited node of the given digit length, called once per frame
+// alongside ckpt_tick, and handles the dump triggers
+static inline void prog_tick(uint32_t len)
+{
+    ++_g_prog_nodes;
+    ++_g_prog_lnodes[len < PROG_LEVELS ? len : PROG_LEVELS-1];
+    if (_g_prog_flag)
+    {
+        _g_prog_flag = 0;
+        prog_dump();
+    }
+    if (_g_prog_interval && --_g_prog_countdown == 0)
+    {
+        _g_prog_countdown = PROG_CHECK_NODES;
+        if (time(NULL) >= _g_prog_next)
+        {
+            prog_dump();
+            _g_prog_next = time(NULL) + _g_prog_interval;
+        }
+    }
+}
+
+// read a token and require it to match (checkpoint file structure)
+void ckpt_expect(FILE *f, const char *s)
+{
+    char buf[32];
+    if (fscanf(f,"%31s",buf) != 1 || strcmp(buf,s) != 0)
+    {
+        fprintf(stderr,"invalid checkpoint file\n");
+        exit(1);
     }
 }
 
-// right truncatable (A024770 for base 10)
-tp_hash_t primes_r()
+// read a token and require it to match the argument value
+void ckpt_match(FILE *f, const char *key, const char *value)
+{
+    char buf[64];
+    ckpt_expect(f,key);
+    if (fscanf(f,"%63s",buf) != 1 || strcmp(buf,value) != 0)
+    {
+        fprintf(stderr,"checkpoint %s does not match arguments\n",key);
+        exit(1);
+    }
+}
+
+// load a checkpoint file and prepare the outputs for resuming
+// must be called after init_globals (arrays) and before the recursion
+void load_checkpoint()
+{
+    FILE *f = fopen(_g_resume_filename,"r");
+    if (!f)
+    {
+        fprintf(stderr,"error opening checkpoint file\n");
+        exit(1);
+    }
+    char buf[64];
+    ckpt_expect(f,"#");
+    ckpt_expect(f,"tp_checkpoint");
+    ckpt_match(f,"prime_type",_g_prime_type);
+    sprintf(buf,"%u",_g_base);
+    ckpt_match(f,"base",buf);
+    ckpt_expect(f,"root");
+    mpz_t root;
+    mpz_init(root);
+    if (mpz_inp_str(root,f,10) == 0 || mpz_cmp(root,_g_root) != 0)
+    {
+        fprintf(stderr,"checkpoint root does not match arguments\n");
+        exit(1);
+    }
+    mpz_clear(root);
+    sprintf(buf,"%u",_g_maxlength);
+    ckpt_match(f,"max_length",buf);
+    sprintf(buf,"%u",_g_minlength);
+    ckpt_match(f,"min_length",buf);
+    sprintf(buf,"%u",_g_nums_format);
+    ckpt_match(f,"nums_format",buf);
+#ifdef WRITE_TREE
+    ckpt_match(f,"mode","tree");
+#else
+    ckpt_match(f,"mode","stats");
+#endif
+    long out_pos, num_pos;
+    ckpt_expect(f,"phase");
+    if (fscanf(f," %c",&_g_phase) != 1
+     || (_g_phase != 'r' && _g_phase != '1' && _g_phase != '2'))
+    {
+        fprintf(stderr,"invalid checkpoint file\n");
+        exit(1);
+    }
+    ckpt_expect(f,"out_pos");
+    if (fscanf(f,"%ld",&out_pos) != 1)
+    {
+        fprintf(stderr,"invalid checkpoint file\n");
+        exit(1);
+    }
+    ckpt_expect(f,"num_pos");
+    if (fscanf(f,"%ld",&num_pos) != 1)
+    {
+        fprintf(stderr,"invalid checkpoint file\n");
+        exit(1);
+    }
+    _g_num_pos = num_pos;
+    ckpt_expect(f,"depth");
+    if (fscanf(f,"%u",&_g_rdepth) != 1 || _g_rdepth < 1)
+    {
+        fprintf(stderr,"invalid checkpoint file\n");
+        exit(1);
+    }
+    ensure_stack_space(_g_rdepth);
+    ckpt_expect(f,"path");
+    for (uint32_t i = 0; i < _g_rdepth; ++i)
+        if (fscanf(f,"%u",_g_path+i) != 1)
+        {
+            fprintf(stderr,"invalid checkpoint file\n");
+            exit(1);
+        }
+#ifdef WRITE_STATS
+    ckpt_expect(f,"fhash");
+    for (uint32_t i = 0; i <= _g_rdepth; ++i)
+        if (fscanf(f,"%lu",_g_fhash+i) != 1)
+        {
+            fprintf(stderr,"invalid checkpoint file\n");
+            exit(1);
+        }
+    ckpt_expect(f,"fchild");
+    for (uint32_t i = 0; i <= _g_rdepth; ++i)
+        if (fscanf(f,"%u",_g_fchild+i) != 1)
+        {
+            fprintf(stderr,"invalid checkpoint file\n");
+            exit(1);
+        }
+    uint32_t slen;
+    ckpt_expect(f,"slen");
+    if (fscanf(f,"%u",&slen) != 1 || slen < 1)
+    {
+        fprintf(stderr,"invalid checkpoint file\n");
+        exit(1);
+    }
+    ensure_stack_space(slen-1);
+    for (uint32_t i = 0; i < slen; ++i)
+        for (uint32_t k = 0; k < _g_max_children; ++k)
+        {
+            if (fscanf(f,"%lu",&_g_counts[STATS_CELL(i,k)]) != 1
+             || mpz_inp_str(_g_pmin[STATS_CELL(i,k)],f,10) == 0
+             || mpz_inp_str(_g_pmax[STATS_CELL(i,k)],f,10) == 0)
+            {
+                fprintf(stderr,"invalid checkpoint file\n");
+                exit(1);
+            }
+        }
+#endif
+    ckpt_expect(f,"end");
+    fclose(f);
+    // truncate the output back to the recorded position
+    if (ftruncate(1,out_pos) != 0 || lseek(1,out_pos,SEEK_SET) == (off_t)-1)
+    {
+        fprintf(stderr,"resume requires stdout redirected to a file\n");
+        exit(1);
+    }
+    _g_resuming = true;
+}
+
+// right truncatable (A024770 for base 10)
+tp_hash_t primes_r()
+{
+    if (!_g_resuming)
+        write_num(1);
+    ++_g_depth;
+    CHECK_STACK;
+#ifdef WRITE_STATS
+    tp_hash_t child_hash;
+    if (!_g_resuming)
+    {
+        _g_fhash[_g_depth] = HASH_INIT;
+        _g_fchild[_g_depth] = 0;
+    }
+#endif
+    // dres = saved path append to descend into while resuming
+    uint32_t d0 = 1, dres = 0;
+    if (_g_resuming && _g_depth == _g_rdepth)
+        _g_resuming = false; // the checkpoint was at the entry of this node
+    if (_g_resuming)
+        d0 = dres = _g_path[_g_depth];
+    else
+    {
+        prog_tick(_g_rlen+_g_depth-1);
+        ckpt_tick();
+    }
+    if (_g_depth <= _g_maxdepth)
+    {
+        if (FITS64(1))
+        {
+            // batch test, left shift to create a 0 digit on the right
+            uint64_t u = USTACK_PREV*_g_base + (d0-1);
+            for (uint32_t d = d0; d < _g_base; ++d)
+            {
+                ++u; // increment right digit
+                CMASK(d) = d == dres || U_PRIME_TEST(u);
+            }
+            // expand passing children
+            for (uint32_t d = d0; d < _g_base; ++d)
+            {
+                if (!CMASK(d))
+                    continue;
+                u = USTACK_PREV*_g_base + d;
+                USTACK_CURR = u;
+                mpz_set_ui(STACK_CURR,u);
+                SPMOD_CURR = u % SPMOD;
+                if (d != dres)
+                    write_value1(d); // subtree
+                _g_path[_g_depth] = d;
+#ifdef WRITE_STATS
+                child_hash =
+#endif
+                RECURSE(primes_r,_g_rlen+_g_depth);
+#ifdef WRITE_STATS
+                ++_g_fchild[_g_depth];
+                _g_fhash[_g_depth] =
+                    HASH_UPDATE(_g_fhash[_g_depth],d,child_hash);
+#endif
+            }
+        }
+        else
+        {
+            // batch test, left shift to create a 0 digit on the right
+            mpz_mul_ui(STACK_CURR,STACK_PREV,_g_base);
+            mpz_add_ui(STACK_CURR,STACK_CURR,d0-1);
+            SPMOD_CURR = (SPMOD_PREV*_g_base + (d0-1)) % SPMOD;
+            for (uint32_t d = d0; d < _g_base; ++d)
+            {
+                // increment right digit
+                mpz_add_ui(STACK_CURR,STACK_CURR,1);
+                if (++SPMOD_CURR == SPMOD)
+                    SPMOD_CURR = 0;
+                CMASK(d) = d == dres || PRIME_TEST_CURR;
+            }
+            // expand passing children
+            for (uint32_t d = d0; d < _g_base; ++d)
+            {
+                if (!CMASK(d))
+                    continue;
+                mpz_mul_ui(STACK_CURR,STACK_PREV,_g_base);
+                mpz_add_ui(STACK_CURR,STACK_CURR,d);
+                SPMOD_CURR = (SPMOD_PREV*_g_base + d) % SPMOD;
+                if (d != dres)
+                    write_value1(d); // subtree
+                _g_path[_g_depth] = d;
+#ifdef WRITE_STATS
+                child_hash =
+#endif
+                RECURSE(primes_r,_g_rlen+_g_depth);
+#ifdef WRITE_STATS
+                ++_g_fchild[_g_depth];
+                _g_fhash[_g_depth] =
+                    HASH_UPDATE(_g_fhash[_g_depth],d,child_hash);
+#endif
+            }
+        }
+    }
+    --_g_depth;
+    write_end(); // end
+#ifdef WRITE_STATS
+    ++_g_counts[STATS_CELL(_g_depth,_g_fchild[_g_depth+1])];
+    update_min_max(_g_fchild[_g_depth+1]);
+    return _g_fhash[_g_depth+1];
+#endif
+}
+
+// left truncatable (A024785 for base 10)
+tp_hash_t primes_l()
+{
+    if (!_g_resuming)
+        write_num(1);
+    ++_g_depth;
+    CHECK_STACK;
+#ifdef WRITE_STATS
+    tp_hash_t child_hash;
+    if (!_g_resuming)
+    {
+        _g_fhash[_g_depth] = HASH_INIT;
+        _g_fchild[_g_depth] = 0;
+    }
+#endif
+    // dres = saved path append to descend into while resuming
+    uint32_t d0 = 1, dres = 0;
+    if (_g_resuming && _g_depth == _g_rdepth)
+        _g_resuming = false; // the checkpoint was at the entry of this node
+    if (_g_resuming)
+        d0 = dres = _g_path[_g_depth];
+    else
+    {
+        prog_tick(_g_rlen+_g_depth-1);
+        ckpt_tick();
+    }
+    if (_g_depth <= _g_maxdepth)
+    {
+        if (FITS64(1))
+        {
+            // batch test
+            uint64_t u = USTACK_PREV + (d0-1)*_g_upowers[_g_rlen+_g_depth-1];
+            for (uint32_t d = d0; d < _g_base; ++d)
+            {
+                // increment left digit
+                u += _g_upowers[_g_rlen+_g_depth-1];
+                CMASK(d) = d == dres || U_PRIME_TEST(u);
+            }
+            // expand passing children
+            for (uint32_t d = d0; d < _g_base; ++d)
+            {
+                if (!CMASK(d))
+                    continue;
+                u = USTACK_PREV + d*_g_upowers[_g_rlen+_g_depth-1];
+                USTACK_CURR = u;
+                mpz_set_ui(STACK_CURR,u);
+                SPMOD_CURR = u % SPMOD;
+                if (d != dres)
+                    write_value1(d); // subtree
+                _g_path[_g_depth] = d;
+#ifdef WRITE_STATS
+                child_hash =
+#endif
+                RECURSE(primes_l,_g_rlen+_g_depth);
+#ifdef WRITE_STATS
+                ++_g_fchild[_g_depth];
+                _g_fhash[_g_depth] =
+                    HASH_UPDATE(_g_fhash[_g_depth],d,child_hash);
+#endif
+            }
+        }
+        else
+        {
+            // batch test
+            mpz_set(STACK_CURR,STACK_PREV);
+            mpz_addmul_ui(STACK_CURR,POWER_CURR,d0-1);
+            SPMOD_CURR = (SPMOD_PREV + (d0-1)*POWER_SPMOD_CURR) % SPMOD;
+            for (uint32_t d = d0; d < _g_base; ++d)
+            {
+                // increment left digit
+                mpz_add(STACK_CURR,STACK_CURR,POWER_CURR);
+                SPMOD_CURR += POWER_SPMOD_CURR;
+                if (SPMOD_CURR >= SPMOD)
+                    SPMOD_CURR -= SPMOD;
+                CMASK(d) = d == dres || PRIME_TEST_CURR;
+            }
+            // expand passing children
+            for (uint32_t d = d0; d < _g_base; ++d)
+            {
+                if (!CMASK(d))
+                    continue;
+                mpz_set(STACK_CURR,STACK_PREV);
+                mpz_addmul_ui(STACK_CURR,POWER_CURR,d);
+                SPMOD_CURR = (SPMOD_PREV + d*POWER_SPMOD_CURR) % SPMOD;
+                if (d != dres)
+                    write_value1(d); // subtree
+                _g_path[_g_depth] = d;
+#ifdef WRITE_STATS
+                child_hash =
+#endif
+                RECURSE(primes_l,_g_rlen+_g_depth);
+#ifdef WRITE_STATS
+                ++_g_fchild[_g_depth];
+                _g_fhash[_g_depth] =
+                    HASH_UPDATE(_g_fhash[_g_depth],d,child_hash);
+#endif
+            }
+        }
+    }
+    --_g_depth;
+    write_end(); // end
+#ifdef WRITE_STATS
+    ++_g_counts[STATS_CELL(_g_depth,_g_fchild[_g_depth+1])];
+    update_min_max(_g_fchild[_g_depth+1]);
+    return _g_fhash[_g_depth+1];
+#endif
+}
+
+// left or right truncatable (A137812 for base 10)
+tp_hash_t primes_lor()
+{
+    if (!_g_resuming)
+        write_num(1);
+    ++_g_depth;
+    CHECK_STACK;
+#ifdef WRITE_STATS
+    tp_hash_t child_hash;
+    if (!_g_resuming)
+    {
+        _g_fhash[_g_depth] = HASH_INIT;
+        _g_fchild[_g_depth] = 0;
+    }
+#endif
+    // lres/rres = saved path append to descend into while resuming
+    // a path number >= base means the left appends are already complete
+    uint32_t l0 = 1, r0 = 1, lres = 0, rres = 0;
+    if (_g_resuming && _g_depth == _g_rdepth)
+        _g_resuming = false; // the checkpoint was at the entry of this node
+    if (_g_resuming)
+    {
+        if (_g_path[_g_depth] < _g_base)
+            l0 = lres = _g_path[_g_depth];
+        else
+        {
+            l0 = _g_base;
+            r0 = rres = _g_path[_g_depth] - _g_base;
+        }
+    }
+    else
+    {
+        prog_tick(_g_rlen+_g_depth-1);
+        ckpt_tick();
+    }
+    if (_g_depth <= _g_maxdepth)
+    {
+        // left appends mask at d, right appends at base+d (the path number)
+        if (FITS64(1))
+        {
+            // batch test, append left then append right
+            uint64_t u = USTACK_PREV + (l0-1)*_g_upowers[_g_rlen+_g_depth-1];
+            for (uint32_t d = l0; d < _g_base; ++d)
+            {
+                u += _g_upowers[_g_rlen+_g_depth-1];
+                CMASK(d) = d == lres || U_PRIME_TEST(u);
+            }
+            u = USTACK_PREV*_g_base + (r0-1);
+            for (uint32_t d = r0; d < _g_base; ++d)
+            {
+                ++u;
+                CMASK(_g_base+d) = d == rres || U_PRIME_TEST(u);
+            }
+            // expand passing children, append left
+            for (uint32_t d = l0; d < _g_base; ++d)
+            {
+                if (!CMASK(d))
+                    continue;
+                u = USTACK_PREV + d*_g_upowers[_g_rlen+_g_depth-1];
+                USTACK_CURR = u;
+                mpz_set_ui(STACK_CURR,u);
+                SPMOD_CURR = u % SPMOD;
+                if (d != lres)
+                    write_value2(0,d); // subtree
+                _g_path[_g_depth] = d;
+#ifdef WRITE_STATS
+                child_hash =
+#endif
+                RECURSE(primes_lor,_g_rlen+_g_depth);
+#ifdef WRITE_STATS
+                ++_g_fchild[_g_depth];
+                _g_fhash[_g_depth] =
+                    HASH_UPDATE(_g_fhash[_g_depth],d,child_hash);
+#endif
+            }
+            // expand passing children, append right
+            for (uint32_t d = r0; d < _g_base; ++d)
+            {
+                if (!CMASK(_g_base+d))
+                    continue;
+                u = USTACK_PREV*_g_base + d;
+                USTACK_CURR = u;
+                mpz_set_ui(STACK_CURR,u);
+                SPMOD_CURR = u % SPMOD;
+                if (d != rres)
+                    write_value2(1,d); // subtree
+                _g_path[_g_depth] = _g_base + d;
+#ifdef WRITE_STATS
+                child_hash =
+#endif
+                RECURSE(primes_lor,_g_rlen+_g_depth);
+#ifdef WRITE_STATS
+                ++_g_fchild[_g_depth];
+                _g_fhash[_g_depth] =
+                    HASH_UPDATE(_g_fhash[_g_depth],_g_base+d,child_hash);
+#endif
+            }
+        }
+        else
+        {
+            // batch test, append left then append right
+            mpz_set(STACK_CURR,STACK_PREV);
+            mpz_addmul_ui(STACK_CURR,POWER_CURR,l0-1);
+            SPMOD_CURR = (SPMOD_PREV + (l0-1)*POWER_SPMOD_CURR) % SPMOD;
+            for (uint32_t d = l0; d < _g_base; ++d)
+            {
+                mpz_add(STACK_CURR,STACK_CURR,POWER_CURR);
+                SPMOD_CURR += POWER_SPMOD_CURR;
+                if (SPMOD_CURR >= SPMOD)
+                    SPMOD_CURR -= SPMOD;
+                CMASK(d) = d == lres || PRIME_TEST_CURR;
+            }
+            mpz_mul_ui(STACK_CURR,STACK_PREV,_g_base);
+            mpz_add_ui(STACK_CURR,STACK_CURR,r0-1);
+            SPMOD_CURR = (SPMOD_PREV*_g_base + (r0-1)) % SPMOD;
+            for (uint32_t d = r0; d < _g_base; ++d)
+            {
+                mpz_add_ui(STACK_CURR,STACK_CURR,1);
+                if (++SPMOD_CURR == SPMOD)
+                    SPMOD_CURR = 0;
+                CMASK(_g_base+d) = d == rres || PRIME_TEST_CURR;
+            }
+            // expand passing children, append left
+            for (uint32_t d = l0; d < _g_base; ++d)
+            {
+                if (!CMASK(d))
+                    continue;
+                mpz_set(STACK_CURR,STACK_PREV);
+                mpz_addmul_ui(STACK_CURR,POWER_CURR,d);
+                SPMOD_CURR = (SPMOD_PREV + d*POWER_SPMOD_CURR) % SPMOD;
+                if (d != lres)
+                    write_value2(0,d); // subtree
+                _g_path[_g_depth] = d;
+#ifdef WRITE_STATS
+                child_hash =
+#endif
+                RECURSE(primes_lor,_g_rlen+_g_depth);
+#ifdef WRITE_STATS
+                ++_g_fchild[_g_depth];
+                _g_fhash[_g_depth] =
+                    HASH_UPDATE(_g_fhash[_g_depth],d,child_hash);
+#endif
+            }
+            // expand passing children, append right
+            for (uint32_t d = r0; d < _g_base; ++d)
+            {
+                if (!CMASK(_g_base+d))
+                    continue;
+                mpz_mul_ui(STACK_CURR,STACK_PREV,_g_base);
+                mpz_add_ui(STACK_CURR,STACK_CURR,d);
+                SPMOD_CURR = (SPMOD_PREV*_g_base + d) % SPMOD;
+                if (d != rres)
+                    write_value2(1,d); // subtree
+                _g_path[_g_depth] = _g_base + d;
+#ifdef WRITE_STATS
+                child_hash =
+#endif
+                RECURSE(primes_lor,_g_rlen+_g_depth);
+#ifdef WRITE_STATS
+                ++_g_fchild[_g_depth];
+                _g_fhash[_g_depth] =
+                    HASH_UPDATE(_g_fhash[_g_depth],_g_base+d,child_hash);
+#endif
+            }
+        }
+    }
+    --_g_depth;
+    write_end(); // end
+#ifdef WRITE_STATS
+    ++_g_counts[STATS_CELL(_g_depth,_g_fchild[_g_depth+1])];
+    update_min_max(_g_fchild[_g_depth+1]);
+    return _g_fhash[_g_depth+1];
+#endif
+}
+
+// 2 digits at a time so use 2*_g_depth instead of _g_depth
+#define LAR_POWER_INDEX (_g_rlen + (_g_depth << 1) - 1)
+#define LAR_POWER_SPMOD (_g_power_spmods[LAR_POWER_INDEX])
+
+// left and right truncatable (A077390 for base 10)
+tp_hash_t primes_lar()
+{
+    if (!_g_resuming)
+        write_num(2);
+    ++_g_depth;
+    CHECK_STACK;
+#ifdef WRITE_STATS
+    tp_hash_t child_hash;
+    if (!_g_resuming)
+    {
+        _g_fhash[_g_depth] = HASH_INIT;
+        _g_fchild[_g_depth] = 0;
+    }
+#endif
+    // pres = saved path append (dl*base+dr) to descend into while resuming
+    uint32_t dl0 = 1, drstart = 1, pres = 0;
+    if (_g_resuming && _g_depth == _g_rdepth)
+        _g_resuming = false; // the checkpoint was at the entry of this node
+    if (_g_resuming)
+    {
+        pres = _g_path[_g_depth];
+        dl0 = pres/_g_base;
+        drstart = pres%_g_base;
+    }
+    else
+    {
+        prog_tick(_g_rlen+((_g_depth-1)<<1));
+        ckpt_tick();
+    }
+    if ((_g_depth<<1) <= _g_maxdepth)
+    {
+        // mask is indexed by the path number dl*base+dr
+        uint32_t dr0;
+        if (FITS64(2))
+        {
+            // batch test, shift left (with the resume jump offsets built in)
+            uint64_t u = USTACK_PREV*_g_base
+                + (dl0-1)*_g_upowers[LAR_POWER_INDEX] + (drstart-1);
+            dr0 = drstart;
+            for (uint32_t dl = dl0; dl < _g_base; ++dl)
+            {
+                // increment left digit
+                u += _g_upowers[LAR_POWER_INDEX];
+                // right digit loop
+                for (uint32_t dr = dr0; dr < _g_base; ++dr)
+                {
+                    ++u;
+                    CMASK(dl*_g_base+dr) =
+                        dl*_g_base+dr == pres || U_PRIME_TEST(u);
+                }
+                // backtrack right digit increment
+                // (the resume offset in the initial value cancels here)
+                u -= _g_base-1;
+                dr0 = 1;
+            }
+            // expand passing children
+            dr0 = drstart;
+            for (uint32_t dl = dl0; dl < _g_base; ++dl)
+            {
+                for (uint32_t dr = dr0; dr < _g_base; ++dr)
+                {
+                    if (!CMASK(dl*_g_base+dr))
+                        continue;
+                    u = USTACK_PREV*_g_base
+                        + dl*_g_upowers[LAR_POWER_INDEX] + dr;
+                    USTACK_CURR = u;
+                    mpz_set_ui(STACK_CURR,u);
+                    SPMOD_CURR = u % SPMOD;
+                    if (dl*_g_base+dr != pres)
+                        write_value2(dl,dr); // subtree
+                    _g_path[_g_depth] = dl*_g_base+dr;
+#ifdef WRITE_STATS
+                    child_hash =
+#endif
+                    RECURSE(primes_lar,_g_rlen+(_g_depth<<1));
+#ifdef WRITE_STATS
+                    ++_g_fchild[_g_depth];
+                    _g_fhash[_g_depth] = HASH_UPDATE(_g_fhash[_g_depth],
+                        dl*_g_base+dr,child_hash);
+#endif
+                }
+                dr0 = 1;
+            }
+        }
+        else
+        {
+            // batch test, shift left (with the resume jump offsets built in)
+            mpz_mul_ui(STACK_CURR,STACK_PREV,_g_base);
+            mpz_addmul_ui(STACK_CURR,*get_power(LAR_POWER_INDEX),dl0-1);
+            mpz_add_ui(STACK_CURR,STACK_CURR,drstart-1);
+            SPMOD_CURR = (SPMOD_PREV*_g_base) % SPMOD;
+            SPMOD_CURR = (SPMOD_CURR + (dl0-1)*LAR_POWER_SPMOD) % SPMOD;
+            SPMOD_CURR = (SPMOD_CURR + (drstart-1)) % SPMOD;
+            dr0 = drstart;
+            for (uint32_t dl = dl0; dl < _g_base; ++dl)
+            {
+                // increment left digit
+                mpz_add(STACK_CURR,STACK_CURR,*get_power(LAR_POWER_INDEX));
+                SPMOD_CURR += LAR_POWER_SPMOD;
+                if (SPMOD_CURR >= SPMOD)
+                    SPMOD_CURR -= SPMOD;
+                // right digit loop
+                for (uint32_t dr = dr0; dr < _g_base; ++dr)
+                {
+                    mpz_add_ui(STACK_CURR,STACK_CURR,1);
+                    if (++SPMOD_CURR == SPMOD)
+                        SPMOD_CURR = 0;
+                    CMASK(dl*_g_base+dr) =
+                        dl*_g_base+dr == pres || PRIME_TEST_CURR;
+                }
+                // backtrack right digit increment
+                // (the resume offset in the initial value cancels here)
+                mpz_sub_ui(STACK_CURR,STACK_CURR,_g_base-1);
+                if (SPMOD_CURR < _g_base-1)
+                    SPMOD_CURR += SPMOD;
+                SPMOD_CURR -= _g_base-1;
+                dr0 = 1;
+            }
+            // expand passing children
+            dr0 = drstart;
+            for (uint32_t dl = dl0; dl < _g_base; ++dl)
+            {
+                for (uint32_t dr = dr0; dr < _g_base; ++dr)
+                {
+                    if (!CMASK(dl*_g_base+dr))
+                        continue;
+                    mpz_mul_ui(STACK_CURR,STACK_PREV,_g_base);
+                    mpz_addmul_ui(STACK_CURR,*get_power(LAR_POWER_INDEX),dl);
+                    mpz_add_ui(STACK_CURR,STACK_CURR,dr);
+                    SPMOD_CURR = (SPMOD_PREV*_g_base) % SPMOD;
+                    SPMOD_CURR = (SPMOD_CURR + dl*LAR_POWER_SPMOD) % SPMOD;
+                    SPMOD_CURR = (SPMOD_CURR + dr) % SPMOD;
+                    if (dl*_g_base+dr != pres)
+                        write_value2(dl,dr); // subtree
+                    _g_path[_g_depth] = dl*_g_base+dr;
+#ifdef WRITE_STATS
+                    child_hash =
+#endif
+                    RECURSE(primes_lar,_g_rlen+(_g_depth<<1));
+#ifdef WRITE_STATS
+                    ++_g_fchild[_g_depth];
+                    _g_fhash[_g_depth] = HASH_UPDATE(_g_fhash[_g_depth],
+                        dl*_g_base+dr,child_hash);
+#endif
+                }
+                dr0 = 1;
+            }
+        }
+    }
+    --_g_depth;
+    write_end(); // end
+#ifdef WRITE_STATS
+    ++_g_counts[STATS_CELL(_g_depth,_g_fchild[_g_depth+1])];
+    update_min_max(_g_fchild[_g_depth+1]);
+    return _g_fhash[_g_depth+1];
+#endif
+}
+
+/*
+Threaded mode phase 1: collect subtree roots at the split length
+These mirror the digit appends of the primes_* functions but produce no
+output, they only build the job list (in recursion order)
+*/
+
+void collect_r()
 {
-    write_num(1);
     ++_g_depth;
-#ifdef WRITE_STATS
-    uint32_t children = 0;
-    tp_hash_t hash = HASH_INIT, child_hash;
-#endif
     if (_g_depth <= _g_maxdepth)
     {
         CHECK_STACK;
-        // left shift to create a 0 digit on the right
         mpz_mul_ui(STACK_CURR,STACK_PREV,_g_base);
+        SPMOD_CURR = (SPMOD_PREV*_g_base) % SPMOD;
         for (uint32_t d = 1; d < _g_base; ++d)
         {
-            // increment right digit
             mpz_add_ui(STACK_CURR,STACK_CURR,1);
+            if (++SPMOD_CURR == SPMOD)
+                SPMOD_CURR = 0;
             if (PRIME_TEST_CURR)
             {
-                write_byte(d); // subtree
-#ifdef WRITE_STATS
-                child_hash =
-#endif
-                primes_r();
-#ifdef WRITE_STATS
-                ++children;
-                hash = HASH_UPDATE(hash,d,child_hash);
-#endif
+                if (_g_rlen + _g_depth >= _g_split)
+                    add_job(STACK_CURR,_g_rlen+_g_depth);
+                else
+                    collect_r();
             }
         }
     }
     --_g_depth;
-    write_byte(255); // end
-#ifdef WRITE_STATS
-    ++_g_counts[_g_depth][children];
-    update_min_max(children);
-    return hash;
-#endif
 }
 
-// left truncatable (A024785 for base 10)
-tp_hash_t primes_l()
+void collect_l()
 {
-    write_num(1);
     ++_g_depth;
-#ifdef WRITE_STATS
-    uint32_t children = 0;
-    tp_hash_t hash = HASH_INIT, child_hash;
-#endif
     if (_g_depth <= _g_maxdepth)
     {
         CHECK_STACK;
         mpz_set(STACK_CURR,STACK_PREV);
+        SPMOD_CURR = SPMOD_PREV;
         for (uint32_t d = 1; d < _g_base; ++d)
         {
-            // increment left digit
             mpz_add(STACK_CURR,STACK_CURR,POWER_CURR);
+            SPMOD_CURR += POWER_SPMOD_CURR;
+            if (SPMOD_CURR >= SPMOD)
+                SPMOD_CURR -= SPMOD;
             if (PRIME_TEST_CURR)
             {
-                write_byte(d); // subtree
-#ifdef WRITE_STATS
-                child_hash =
-#endif
-                primes_l();
-#ifdef WRITE_STATS
-                ++children;
-                hash = HASH_UPDATE(hash,d,child_hash);
-#endif
+                if (_g_rlen + _g_depth >= _g_split)
+                    add_job(STACK_CURR,_g_rlen+_g_depth);
+                else
+                    collect_l();
             }
         }
     }
     --_g_depth;
-    write_byte(255); // end
-#ifdef WRITE_STATS
-    ++_g_counts[_g_depth][children];
-    update_min_max(children);
-    return hash;
-#endif
 }
 
-// left or right truncatable (A137812 for base 10)
-tp_hash_t primes_lor()
+void collect_lor()
 {
-    write_num(1);
     ++_g_depth;
-#ifdef WRITE_STATS
-    uint32_t children = 0;
-    tp_hash_t hash = HASH_INIT, child_hash;
-#endif
     if (_g_depth <= _g_maxdepth)
     {
         CHECK_STACK;
         // append left
         mpz_set(STACK_CURR,STACK_PREV);
+        SPMOD_CURR = SPMOD_PREV;
         for (uint32_t d = 1; d < _g_base; ++d)
         {
             mpz_add(STACK_CURR,STACK_CURR,POWER_CURR);
+            SPMOD_CURR += POWER_SPMOD_CURR;
+            if (SPMOD_CURR >= SPMOD)
+                SPMOD_CURR -= SPMOD;
             if (PRIME_TEST_CURR)
             {
-                write_byte(0); // subtree
-                write_byte(d);
-#ifdef WRITE_STATS
-                child_hash =
-#endif
-                primes_lor();
-#ifdef WRITE_STATS
-                ++children;
-                hash = HASH_UPDATE(hash,d,child_hash);
-#endif
+                if (_g_rlen + _g_depth >= _g_split)
+                    add_job(STACK_CURR,_g_rlen+_g_depth);
+                else
+                    collect_lor();
             }
         }
         // append right
         mpz_mul_ui(STACK_CURR,STACK_PREV,_g_base);
+        SPMOD_CURR = (SPMOD_PREV*_g_base) % SPMOD;
         for (uint32_t d = 1; d < _g_base; ++d)
         {
             mpz_add_ui(STACK_CURR,STACK_CURR,1);
+            if (++SPMOD_CURR == SPMOD)
+                SPMOD_CURR = 0;
             if (PRIME_TEST_CURR)
             {
-                write_byte(1); // subtree
-                write_byte(d);
-#ifdef WRITE_STATS
-                child_hash =
-#endif
-                primes_lor();
-#ifdef WRITE_STATS
-                ++children;
-                hash = HASH_UPDATE(hash,_g_base+d,child_hash);
-#endif
+                if (_g_rlen + _g_depth >= _g_split)
+                    add_job(STACK_CURR,_g_rlen+_g_depth);
+                else
+                    collect_lor();
             }
         }
     }
     --_g_depth;
-    write_byte(255); // end
-#ifdef WRITE_STATS
-    ++_g_counts[_g_depth][children];
-    update_min_max(children);
-    return hash;
-#endif
 }
 
-// 2 digits at a time so use 2*_g_depth instead of _g_depth
-#define LAR_POWER_INDEX (_g_rlen + (_g_depth << 1) - 1)
-
-// left and right truncatable (A077390 for base 10)
-tp_hash_t primes_lar()
+void collect_lar()
 {
-    write_num(2);
     ++_g_depth;
-#ifdef WRITE_STATS
-    uint32_t children = 0;
-    tp_hash_t hash = HASH_INIT, child_hash;
-#endif
     if ((_g_depth<<1) <= _g_maxdepth)
     {
         CHECK_STACK;
         mpz_mul_ui(STACK_CURR,STACK_PREV,_g_base); // shift left
+        SPMOD_CURR = (SPMOD_PREV*_g_base) % SPMOD;
         for (uint32_t dl = 1; dl < _g_base; ++dl)
         {
-            // increment left digit
             mpz_add(STACK_CURR,STACK_CURR,*get_power(LAR_POWER_INDEX));
-            // right digit loop
+            SPMOD_CURR += LAR_POWER_SPMOD;
+            if (SPMOD_CURR >= SPMOD)
+                SPMOD_CURR -= SPMOD;
             for (uint32_t dr = 1; dr < _g_base; ++dr)
             {
                 mpz_add_ui(STACK_CURR,STACK_CURR,1);
+                if (++SPMOD_CURR == SPMOD)
+                    SPMOD_CURR = 0;
                 if (PRIME_TEST_CURR)
                 {
-                    write_byte(dl); // subtree
-                    write_byte(dr);
-#ifdef WRITE_STATS
-                    child_hash =
-#endif
-                    primes_lar();
-#ifdef WRITE_STATS
-                    ++children;
-                    hash = HASH_UPDATE(hash,dl*_g_base+dr,child_hash);
-#endif
+                    if (_g_rlen + (_g_depth<<1) >= _g_split)
+                        add_job(STACK_CURR,_g_rlen+(_g_depth<<1));
+                    else
+                        collect_lar();
                 }
             }
-            // backtrack right digit increment
             mpz_sub_ui(STACK_CURR,STACK_CURR,_g_base-1);
+            if (SPMOD_CURR < _g_base-1)
+                SPMOD_CURR += SPMOD;
+            SPMOD_CURR -= _g_base-1;
         }
     }
     --_g_depth;
-    write_byte(255); // end
+}
+
+// collect all jobs, mirrors the root setup of the primes_*_init functions
+void collect_jobs()
+{
+    void (*cfn)();
+    if (strcmp(_g_prime_type,"r") == 0)
+        cfn = collect_r;
+    else if (strcmp(_g_prime_type,"l") == 0)
+        cfn = collect_l;
+    else if (strcmp(_g_prime_type,"lor") == 0)
+        cfn = collect_lor;
+    else
+        cfn = collect_lar;
+    if (mpz_cmp_ui(_g_root,0) > 0)
+    {
+        mpz_set(_g_stack[0],_g_root);
+        SPMOD_SEED(0);
+        _g_depth = 0;
+        _g_rlen = 0;
+        mpz_t root;
+        mpz_init_set(root,_g_root);
+        while (mpz_cmp_ui(root,0) > 0) // count digits
+        {
+            ++_g_rlen;
+            mpz_div_ui(root,root,_g_base);
+        }
+        mpz_clear(root);
+        _g_maxdepth = _g_maxlength - _g_rlen;
+        cfn();
+        return;
+    }
+    if (_g_maxlength >= 1)
+        for (uint64_t root = 2; root < _g_base; ++root)
+        {
+            mpz_set_ui(_g_stack[0],root);
+            _g_spmods[0] = root;
+            _g_depth = 0;
+            _g_rlen = 1;
+            _g_maxdepth = _g_maxlength - 1;
+            if (PRIME_TEST(_g_stack[0]))
+                cfn();
+        }
+    if (cfn == collect_lar && _g_maxlength >= 2)
+        for (uint64_t rootl = 1; rootl < _g_base; ++rootl)
+            for (uint64_t rootr = 0; rootr < _g_base; ++rootr)
+            {
+                mpz_set_ui(_g_stack[0],rootl*_g_base+rootr);
+                _g_spmods[0] = rootl*_g_base+rootr;
+                _g_depth = 0;
+                _g_rlen = 2;
+                _g_maxdepth = _g_maxlength - 2;
+                if (PRIME_TEST(_g_stack[0]))
+                    cfn();
+            }
+}
+
+/*
+Threaded mode merged statistics
+Thread local stats arrays are indexed by recursion depth, the merged arrays
+are indexed by digit length so results from jobs with different root lengths
+combine correctly
+*/
+
+#ifdef WRITE_STATS
+pthread_mutex_t _g_merge_lock = PTHREAD_MUTEX_INITIALIZER;
+mpz_t *_g_mmin, *_g_mmax; // flat, same cell layout as the thread local arrays
+uint64_t *_g_mcounts;
+uint32_t _g_mlen; // number of digit lengths initialized
+uint32_t _g_mcap; // allocated capacity (digit lengths)
+
+// grows the merged arrays to ensure space for digit length len
+void ensure_merged_space(uint32_t len)
+{
+    if (len < _g_mlen)
+        return;
+    if (len >= _g_mcap)
+    {
+        uint32_t cap = 2*_g_mcap > len+1 ? 2*_g_mcap : len+1;
+        _g_mmin = realloc(_g_mmin,STATS_CELL(cap,0)*sizeof(*_g_mmin));
+        _g_mmax = realloc(_g_mmax,STATS_CELL(cap,0)*sizeof(*_g_mmax));
+        _g_mcounts = realloc(_g_mcounts,STATS_CELL(cap,0)*sizeof(*_g_mcounts));
+        _g_mcap = cap;
+    }
+    for (uint32_t j = _g_mlen; j <= len; ++j)
+    {
+        memset(_g_mcounts+STATS_CELL(j,0),0,
+            _g_max_children*sizeof(*_g_mcounts));
+        for (uint32_t k = 0; k < _g_max_children; ++k)
+        {
+            mpz_init(_g_mmin[STATS_CELL(j,k)]);
+            mpz_init(_g_mmax[STATS_CELL(j,k)]);
+        }
+    }
+    _g_mlen = len+1;
+}
+
+// fold this thread's stats arrays into the merged arrays and reset them
+// caller must hold the merge lock (except after the workers are joined)
+void fold_local_stats()
+{
+    for (uint32_t i = 0; i < _g_slen; ++i)
+    {
+        uint32_t len = _g_rlen + i*_g_mult;
+        ensure_merged_space(len);
+        uint64_t *counts = _g_counts + STATS_CELL(i,0);
+        mpz_t *pmin = _g_pmin + STATS_CELL(i,0);
+        mpz_t *pmax = _g_pmax + STATS_CELL(i,0);
+        uint64_t *mcounts = _g_mcounts + STATS_CELL(len,0);
+        mpz_t *mmin = _g_mmin + STATS_CELL(len,0);
+        mpz_t *mmax = _g_mmax + STATS_CELL(len,0);
+        for (uint32_t k = 0; k < _g_max_children; ++k)
+        {
+            mcounts[k] += counts[k];
+            counts[k] = 0;
+            if (mpz_cmp_ui(pmin[k],0) != 0
+             && (mpz_cmp_ui(mmin[k],0) == 0
+                 || mpz_cmp(mmin[k],pmin[k]) > 0))
+                mpz_set(mmin[k],pmin[k]);
+            if (mpz_cmp(mmax[k],pmax[k]) < 0)
+                mpz_set(mmax[k],pmax[k]);
+            mpz_set_ui(pmin[k],0);
+            mpz_set_ui(pmax[k],0);
+        }
+    }
+}
+#endif
+
+/*
+Threaded mode phase 2: worker threads
+*/
+
+// worker thread, takes jobs from the shared queue until none remain
+void *worker_main(void *arg)
+{
+    (void)arg;
+    init_globals(); // thread local recursion state
+    for (;;)
+    {
+        pthread_mutex_lock(&_g_job_lock);
+        uint32_t i = _g_job_next++;
+        pthread_mutex_unlock(&_g_job_lock);
+        if (i >= _g_job_count)
+            break;
+        TP_JOB *job = _g_jobs + i;
+#ifdef WRITE_TREE
+        _g_out_mem = true;
+        _g_mem_len = 0;
+#endif
+        if (_g_num_filename)
+        {
+            _g_num_file = open_memstream(&job->num_bytes,&job->num_len);
+            _g_num_prev = -1; // each job starts a fresh delta context
+        }
+        mpz_set(_g_stack[0],job->root);
+        SPMOD_SEED(0);
+        _g_depth = 0;
+        _g_rlen = job->rlen;
+        _g_maxdepth = _g_maxlength - _g_rlen;
+        if (_g_rlen <= _g_len64) // 64 bit mirror of the root
+            _g_ustack[0] = mpz_get_ui(_g_stack[0]);
+#ifdef WRITE_STATS
+        job->hash =
+#endif
+        _g_prime_fn(); // subtrees and end
+#ifdef WRITE_TREE
+        write_buffer(); // flush remaining bytes into the memory output
+        job->tree_bytes = _g_mem_buf;
+        job->tree_len = _g_mem_len;
+        _g_mem_buf = NULL; // ownership moves to the job
+        _g_mem_len = _g_mem_cap = 0;
+#endif
+        if (_g_num_file)
+        {
+            fclose(_g_num_file);
+            _g_num_file = NULL;
+        }
 #ifdef WRITE_STATS
-    ++_g_counts[_g_depth][children];
-    update_min_max(children);
-    return hash;
+        pthread_mutex_lock(&_g_merge_lock);
+        fold_local_stats();
+        pthread_mutex_unlock(&_g_merge_lock);
 #endif
+    }
+    clear_globals();
+    return NULL;
 }
 
 /*
@@ -589,10 +2354,11 @@ Recursion setup functions
 // returns hash for the entire tree
 tp_hash_t primes_init_root(tp_hash_t (*fptr)(), bool byte2)
 {
-    write_byte(255); // root value
-    if (byte2) // 2nd byte for root value
-        write_byte(255);
+    _g_phase = 'r';
+    if (!_g_resuming)
+        write_root_marker(byte2); // root value
     mpz_set(_g_stack[0],_g_root);
+    SPMOD_SEED(0);
     _g_depth = 0;
     _g_rlen = 0;
     mpz_t root;
@@ -604,6 +2370,8 @@ tp_hash_t primes_init_root(tp_hash_t (*fptr)(), bool byte2)
     }
     mpz_clear(root);
     _g_maxdepth = _g_maxlength - _g_rlen;
+    if (_g_rlen <= _g_len64) // 64 bit mirror of the root
+        _g_ustack[0] = mpz_get_ui(_g_stack[0]);
 #ifdef WRITE_STATS
     return
 #endif
@@ -617,37 +2385,51 @@ tp_hash_t primes_init_root(tp_hash_t (*fptr)(), bool byte2)
 // updates the hash value with the subtrees and returns it
 tp_hash_t primes_init_1digit(tp_hash_t (*fptr)(), int byte2, tp_hash_t *h0)
 {
+    _g_phase = '1';
 #ifdef WRITE_STATS
-    tp_hash_t h = *h0, c;
+    tp_hash_t c;
+    if (!_g_resuming)
+        _g_fhash[0] = *h0;
 #endif
     if (_g_maxlength < 1)
         return
 #ifdef WRITE_STATS
-        h
+        _g_fhash[0]
 #endif
         ;
-    for (uint64_t root = 2; root < _g_base; ++root)
+    // when resuming, restart at the saved root and descend into its subtree
+    uint64_t root0 = 2, rootres = 0;
+    if (_g_resuming)
+        root0 = rootres = _g_path[0];
+    for (uint64_t root = root0; root < _g_base; ++root)
     {
         mpz_set_ui(_g_stack[0],root);
+        _g_ustack[0] = root;
+        _g_spmods[0] = root;
         _g_depth = 0;
         _g_rlen = 1;
         _g_maxdepth = _g_maxlength - 1;
-        if (PRIME_TEST(_g_stack[0]))
+        if (root == rootres || PRIME_TEST(_g_stack[0]))
         {
-            if (byte2 != -1)
-                write_byte(byte2);
-            write_byte(root); // root
+            if (root != rootres)
+            {
+                if (byte2 != -1)
+                    write_value2(byte2,root); // root
+                else
+                    write_value1(root); // root
+            }
+            _g_path[0] = root;
 #ifdef WRITE_STATS
             c =
 #endif
             fptr(); // subtrees and end
 #ifdef WRITE_STATS
-            h = HASH_UPDATE(h,root,c);
+            _g_fhash[0] = HASH_UPDATE(_g_fhash[0],root,c);
 #endif
         }
     }
 #ifdef WRITE_STATS
-    return h;
+    return _g_fhash[0];
 #endif
 }
 
@@ -656,37 +2438,55 @@ tp_hash_t primes_init_1digit(tp_hash_t (*fptr)(), int byte2, tp_hash_t *h0)
 // updates the hash value with the subtrees and returns it
 tp_hash_t primes_init_2digit(tp_hash_t (*fptr)(), tp_hash_t *h0)
 {
+    _g_phase = '2';
 #ifdef WRITE_STATS
-    tp_hash_t h = *h0, c;
+    tp_hash_t c;
+    if (!_g_resuming)
+        _g_fhash[0] = *h0;
 #endif
     if (_g_maxlength < 2)
         return
 #ifdef WRITE_STATS
-        h
+        _g_fhash[0]
 #endif
         ;
-    for (uint64_t rootl = 1; rootl < _g_base; ++rootl)
-        for (uint64_t rootr = 0; rootr < _g_base; ++rootr)
+    // when resuming, restart at the saved root and descend into its subtree
+    uint64_t rootl0 = 1, rootrstart = 0, rootres = 0;
+    if (_g_resuming)
+    {
+        rootres = _g_path[0];
+        rootl0 = rootres/_g_base;
+        rootrstart = rootres%_g_base;
+    }
+    for (uint64_t rootl = rootl0; rootl < _g_base; ++rootl)
+    {
+        for (uint64_t rootr = rootrstart; rootr < _g_base; ++rootr)
         {
             mpz_set_ui(_g_stack[0],rootl*_g_base+rootr);
+            _g_ustack[0] = rootl*_g_base+rootr;
+            _g_spmods[0] = rootl*_g_base+rootr;
             _g_depth = 0;
             _g_rlen = 2;
             _g_maxdepth = _g_maxlength - 2;
-            if (PRIME_TEST(_g_stack[0]))
+            if (rootl*_g_base+rootr == rootres || PRIME_TEST(_g_stack[0]))
             {
-                write_byte(rootl); // root
-                write_byte(rootr);
+                if (rootl*_g_base+rootr != rootres)
+                    write_value2(rootl,rootr); // root
+                _g_path[0] = rootl*_g_base+rootr;
 #ifdef WRITE_STATS
                 c =
 #endif
                 fptr(); // subtrees and end
 #ifdef WRITE_STATS
-                h = HASH_UPDATE(h,rootl*_g_base+rootr,c);
+                _g_fhash[0] = HASH_UPDATE(_g_fhash[0],
+                    rootl*_g_base+rootr,c);
 #endif
             }
         }
+        rootrstart = 0;
+    }
 #ifdef WRITE_STATS
-    return h;
+    return _g_fhash[0];
 #endif
 }
 
@@ -718,39 +2518,54 @@ void write_stats(uint32_t mult, bool header)
     mpz_t min_all,max_all;
     mpz_init(min_all);
     mpz_init(max_all);
-    for (uint32_t i = 0; i < _g_slen; ++i)
+    // in threaded mode, fold this thread's stats and print the merged arrays
+    // (indexed by digit length), otherwise print the thread local arrays
+    uint32_t rows = _g_slen;
+    if (_g_threads > 1)
+    {
+        fold_local_stats();
+        rows = (_g_mlen > _g_rlen) ? (_g_mlen - _g_rlen + mult - 1)/mult : 0;
+    }
+    for (uint32_t i = 0; i < rows; ++i)
     {
+        uint32_t label = _g_rlen+i*mult;
+        uint64_t *counts = (_g_threads > 1)
+            ? _g_mcounts + STATS_CELL(label,0) : _g_counts + STATS_CELL(i,0);
+        mpz_t *pmin = (_g_threads > 1)
+            ? _g_mmin + STATS_CELL(label,0) : _g_pmin + STATS_CELL(i,0);
+        mpz_t *pmax = (_g_threads > 1)
+            ? _g_mmax + STATS_CELL(label,0) : _g_pmax + STATS_CELL(i,0);
         count_all = 0;
         mpz_set_ui(min_all,0);
         mpz_set_ui(max_all,0);
         for (uint32_t k = 0; k < _g_max_children; ++k)
         {
-            count_all += _g_counts[i][k];
+            count_all += counts[k];
             if (mpz_cmp_ui(min_all,0) == 0
-             || (mpz_cmp(min_all,_g_pmin[i][k]) > 0
-                 && mpz_cmp_ui(_g_pmin[i][k],0) != 0))
-                mpz_set(min_all,_g_pmin[i][k]);
-            if (mpz_cmp(max_all,_g_pmax[i][k]) < 0)
-                mpz_set(max_all,_g_pmax[i][k]);
+             || (mpz_cmp(min_all,pmin[k]) > 0
+                 && mpz_cmp_ui(pmin[k],0) != 0))
+                mpz_set(min_all,pmin[k]);
+            if (mpz_cmp(max_all,pmax[k]) < 0)
+                mpz_set(max_all,pmax[k]);
         }
         if (count_all == 0) // skip rows with no primes
             continue;
-        printf("%u,%lu",_g_rlen+i*mult,count_all);
+        printf("%u,%lu",label,count_all);
         for (uint32_t k = 0; k < _g_max_children; ++k)
-            printf(",%lu",_g_counts[i][k]);
+            printf(",%lu",counts[k]);
         printf("\n,");
         mpz_out_str(NULL,10,min_all);
         for (uint32_t k = 0; k < _g_max_children; ++k)
         {
             printf(",");
-            mpz_out_str(NULL,10,_g_pmin[i][k]);
+            mpz_out_str(NULL,10,pmin[k]);
         }
         printf("\n,");
         mpz_out_str(NULL,10,max_all);
         for (uint32_t k = 0; k < _g_max_children; ++k)
         {
             printf(",");
-            mpz_out_str(NULL,10,_g_pmax[i][k]);
+            mpz_out_str(NULL,10,pmax[k]);
         }
         printf("\n");
     }
@@ -797,12 +2612,13 @@ void primes_r_init()
     }
     else
     {
-        write_byte(255); // root value
+        if (!_g_resuming)
+            write_root_marker(false); // root value
 #ifdef WRITE_STATS
         hash =
 #endif
         primes_init_1digit(primes_r,-1,HASH_ADDR);
-        write_byte(255); // end
+        write_end(); // end
     }
     write_stats(1,true);
     write_hash(HASH_ADDR);
@@ -828,12 +2644,13 @@ void primes_l_init()
     }
     else
     {
-        write_byte(255); // root value
+        if (!_g_resuming)
+            write_root_marker(false); // root value
 #ifdef WRITE_STATS
         hash =
 #endif
         primes_init_1digit(primes_l,-1,HASH_ADDR);
-        write_byte(255); // end
+        write_end(); // end
     }
     write_stats(1,true);
     write_hash(HASH_ADDR);
@@ -859,13 +2676,13 @@ void primes_lor_init()
     }
     else
     {
-        write_byte(255); // root value
-        write_byte(255);
+        if (!_g_resuming)
+            write_root_marker(true); // root value
 #ifdef WRITE_STATS
         hash =
 #endif
         primes_init_1digit(primes_lor,0,HASH_ADDR);
-        write_byte(255); // end
+        write_end(); // end
     }
     write_stats(1,true);
     write_hash(HASH_ADDR);
@@ -892,25 +2709,76 @@ void primes_lar_init()
     }
     else
     {
-        write_byte(255); // root value
-        write_byte(255);
+        if (!_g_resuming)
+            write_root_marker(true); // root value
+        if (!_g_resuming || _g_phase == '1') // skipped when resuming phase 2
+        {
 #ifdef WRITE_STATS
-        hash =
+            hash =
+#endif
+            primes_init_1digit(primes_lar,0,HASH_ADDR);
+            write_stats(2,true); // odd lengths
+#ifdef WRITE_STATS
+            clear_globals();
+            init_globals();
 #endif
-        primes_init_1digit(primes_lar,0,HASH_ADDR);
-        write_stats(2,true); // odd lengths
+        }
 #ifdef WRITE_STATS
-        clear_globals();
-        init_globals();
         hash =
 #endif
         primes_init_2digit(primes_lar,HASH_ADDR);
         write_stats(2,false); // even lengths
-        write_byte(255); // end
+        write_end(); // end
     }
     write_hash(HASH_ADDR);
 }
 
+// serial recursion (also the final pass of threaded mode)
+void run_tree()
+{
+    if (strcmp(_g_prime_type,"r") == 0)
+        primes_r_init();
+    else if (strcmp(_g_prime_type,"l") == 0)
+        primes_l_init();
+    else if (strcmp(_g_prime_type,"lor") == 0)
+        primes_lor_init();
+    else
+        primes_lar_init();
+}
+
+// threaded mode, see the -t option description at the top of this file
+void run_threaded()
+{
+    collect_jobs(); // phase 1
+    uint32_t nthreads = _g_threads;
+    if (nthreads > _g_job_count)
+        nthreads = _g_job_count;
+    if (nthreads) // phase 2
+    {
+        pthread_t *threads = malloc(nthreads*sizeof(*threads));
+        for (uint32_t i = 0; i < nthreads; ++i)
+            if (pthread_create(threads+i,NULL,worker_main,NULL) != 0)
+            {
+                fprintf(stderr,"unable to create thread\n");
+                exit(1);
+            }
+        for (uint32_t i = 0; i < nthreads; ++i)
+            pthread_join(threads[i],NULL);
+        free(threads);
+    }
+    // phase 3, serial recursion over the top of the tree with splicing
+    _g_splice = true;
+    run_tree();
+    if (_g_job_cursor != _g_job_count)
+    {
+        fprintf(stderr,"internal error: unspliced job results\n");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < _g_job_count; ++i)
+        mpz_clear(_g_jobs[i].root);
+    free(_g_jobs);
+}
+
 /*
 Main function
 */
@@ -918,12 +2786,24 @@ Main function
 int main(int argc, char **argv)
 {
     // set default values
+#ifndef FIXED_BASE
     _g_base = 10;
+#endif
     _g_maxlength = -1;
     _g_minlength = -1;
+    _g_threads = 1;
+    _g_split = 0;
     _g_num_file = NULL;
     _g_num_filename = NULL;
+    _g_nums_format = NUMS_TEXT;
     _g_prime_type = NULL;
+    _g_ckpt_filename = NULL;
+    _g_resume_filename = NULL;
+    _g_ckpt_interval = 0;
+    _g_prog_interval = 0;
+    _g_cache_filename = NULL;
+    _g_cache = NULL;
+    _g_num_pos = -1;
     mpz_init(_g_root);
     if (argc < 2)
     {
@@ -937,13 +2817,56 @@ int main(int argc, char **argv)
     {
         switch (o)
         {
+        case 'a': // cache file
+            _g_cache_filename = optarg;
+            break;
         case 'b': // base
             if (!is_number(optarg))
             {
                 fprintf(stderr,"base must be a number\n");
                 return 0;
             }
+#ifdef FIXED_BASE
+            if ((uint32_t)atoi(optarg) != _g_base)
+            {
+                fprintf(stderr,"this build has the base fixed at %u\n",
+                    _g_base);
+                return 0;
+            }
+#else
             _g_base = atoi(optarg);
+#endif
+            break;
+        case 'c': // checkpoint file
+            _g_ckpt_filename = optarg;
+            break;
+        case 'd': // progress interval
+            if (!is_number(optarg))
+            {
+                fprintf(stderr,"progress interval must be a number\n");
+                return 0;
+            }
+            _g_prog_interval = atoi(optarg);
+            break;
+        case 'e': // resume file
+            _g_resume_filename = optarg;
+            break;
+        case 'f': // output format
+            if (strcmp(optarg,"packed") == 0)
+                _g_packed = true;
+            else if (strcmp(optarg,"bytes") != 0)
+            {
+                fprintf(stderr,"invalid format: %s\n",optarg);
+                return 0;
+            }
+            break;
+        case 'i': // checkpoint interval
+            if (!is_number(optarg))
+            {
+                fprintf(stderr,"checkpoint interval must be a number\n");
+                return 0;
+            }
+            _g_ckpt_interval = atoi(optarg);
             break;
         case 'l': // max length
             if (!is_number(optarg))
@@ -964,6 +2887,19 @@ int main(int argc, char **argv)
         case 'n': // num file
             _g_num_filename = optarg;
             break;
+        case 'u': // nums file format
+            if (strcmp(optarg,"text") == 0)
+                _g_nums_format = NUMS_TEXT;
+            else if (strcmp(optarg,"binary") == 0)
+                _g_nums_format = NUMS_BINARY;
+            else if (strcmp(optarg,"delta") == 0)
+                _g_nums_format = NUMS_DELTA;
+            else
+            {
+                fprintf(stderr,"invalid nums format: %s\n",optarg);
+                return 0;
+            }
+            break;
         case 'p': // prime type
             _g_prime_type = optarg;
             break;
@@ -975,6 +2911,22 @@ int main(int argc, char **argv)
                 return 0;
             }
             break;
+        case 's': // split length
+            if (!is_number(optarg))
+            {
+                fprintf(stderr,"split length must be a number\n");
+                return 0;
+            }
+            _g_split = atoi(optarg);
+            break;
+        case 't': // threads
+            if (!is_number(optarg))
+            {
+                fprintf(stderr,"threads must be a number\n");
+                return 0;
+            }
+            _g_threads = atoi(optarg);
+            break;
         default:
             fprintf(stderr,"error parsing arguments\n");
             fprintf(stderr,"truncprimes <-p prime_type> "
@@ -992,9 +2944,136 @@ int main(int argc, char **argv)
         fprintf(stderr,"must specify prime type\n");
         return 0;
     }
+    if (strcmp(_g_prime_type,"r") == 0)
+        _g_prime_fn = primes_r;
+    else if (strcmp(_g_prime_type,"l") == 0)
+        _g_prime_fn = primes_l;
+    else if (strcmp(_g_prime_type,"lor") == 0)
+        _g_prime_fn = primes_lor;
+    else if (strcmp(_g_prime_type,"lar") == 0)
+        _g_prime_fn = primes_lar;
+    else
+    {
+        fprintf(stderr,"invalid prime type: %s\n",_g_prime_type);
+        return 0;
+    }
+    _g_mult = (strcmp(_g_prime_type,"lar") == 0) ? 2 : 1;
+    if (_g_threads > 1)
+    {
+        // count root digits to default and validate the split length
+        uint32_t rlen = 0;
+        mpz_t root;
+        mpz_init_set(root,_g_root);
+        while (mpz_cmp_ui(root,0) > 0)
+        {
+            ++rlen;
+            mpz_div_ui(root,root,_g_base);
+        }
+        mpz_clear(root);
+        if (_g_split == 0)
+            _g_split = (rlen ? rlen : 1) + 3;
+        if (_g_split < 3 || _g_split <= rlen)
+        {
+            fprintf(stderr,"split length must be >= 3 "
+                            "and greater than the root length\n");
+            return 0;
+        }
+    }
+    if (_g_packed)
+    {
+#ifdef WRITE_STATS
+        fprintf(stderr,"packed format only applies to tree output\n");
+        return 0;
+#else
+        if (_g_threads > 1)
+        {
+            fprintf(stderr,"packed format requires serial mode\n");
+            return 0;
+        }
+        if (_g_ckpt_filename || _g_resume_filename)
+        {
+            fprintf(stderr,"packed format does not support "
+                            "checkpoint/resume\n");
+            return 0;
+        }
+        _g_wbits = 1;
+        while (POW2(_g_wbits) < _g_base)
+            ++_g_wbits;
+        if (strcmp(_g_prime_type,"lor") == 0)
+            _g_vbits = _g_wbits + 1;
+        else if (strcmp(_g_prime_type,"lar") == 0)
+            _g_vbits = 2*_g_wbits;
+        else
+            _g_vbits = _g_wbits;
+        _g_pk_values = calloc((uint64_t)PACKED_BLOCK_EVENTS*_g_vbits/8+1,1);
+#endif
+    }
+    if (_g_ckpt_filename || _g_resume_filename)
+    {
+        if (_g_threads > 1)
+        {
+            fprintf(stderr,"checkpoint/resume requires serial mode\n");
+            return 0;
+        }
+        if (_g_ckpt_filename && lseek(1,0,SEEK_CUR) == (off_t)-1)
+        {
+            fprintf(stderr,"checkpoint mode requires stdout "
+                            "redirected to a file\n");
+            return 0;
+        }
+        if (_g_ckpt_filename && _g_ckpt_interval == 0)
+            _g_ckpt_interval = 600;
+        _g_ckpt_next = time(NULL) + _g_ckpt_interval;
+        _g_ckpt_countdown = CKPT_CHECK_NODES;
+    }
+    else if (_g_ckpt_interval)
+    {
+        fprintf(stderr,"checkpoint interval requires a checkpoint file\n");
+        return 0;
+    }
+    // progress dumps on SIGUSR1, SA_RESTART so a dump does not interrupt
+    // the output writes with EINTR
+    struct sigaction sa;
+    memset(&sa,0,sizeof(sa));
+    sa.sa_handler = prog_signal;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1,&sa,NULL);
+    _g_prog_next = time(NULL) + _g_prog_interval;
+    _g_prog_rate_time = time(NULL);
+    // largest digit length where every value fits in 63 bits (fast path)
+    // is_prime64 is limited to 63 bits like the mod_mult/Montgomery kernels
+    _g_len64 = 0;
+    uint64_t upow = 1;
+    while (upow <= (POW2(63)-1)/_g_base)
+    {
+        upow *= _g_base;
+        ++_g_len64;
+    }
+    _g_upowers = malloc(_g_len64*sizeof(*_g_upowers));
+    _g_upowers[0] = 1;
+    for (uint32_t i = 1; i < _g_len64; ++i)
+        _g_upowers[i] = _g_upowers[i-1]*_g_base;
+    // bits in base^64, scales digit counts to limb reservations
+    mpz_t bpow;
+    mpz_init(bpow);
+    mpz_ui_pow_ui(bpow,_g_base,64);
+    _g_digit_bits64 = mpz_sizeinbase(bpow,2);
+    mpz_clear(bpow);
+    if (_g_cache_filename)
+        cache_open();
+    init_globals();
+    if (_g_resume_filename)
+    {
+        load_checkpoint(); // also truncates stdout to the saved position
+        if ((_g_num_filename != NULL) != (_g_num_pos >= 0))
+        {
+            fprintf(stderr,"checkpoint nums file does not match arguments\n");
+            return 0;
+        }
+    }
     if (_g_num_filename)
     {
-        _g_num_file = fopen(_g_num_filename,"w");
+        _g_num_file = fopen(_g_num_filename,_g_resume_filename ? "r+" : "w");
         if (!_g_num_file)
         {
             fprintf(stderr,"error opening nums file\n");
@@ -1005,23 +3084,50 @@ int main(int argc, char **argv)
             fprintf(stderr,"error setting nums file buffer\n");
             return 1;
         }
+        // continue the nums file from the saved position
+        if (_g_resume_filename
+         && (ftruncate(fileno(_g_num_file),_g_num_pos) != 0
+             || fseek(_g_num_file,_g_num_pos,SEEK_SET) != 0))
+        {
+            fprintf(stderr,"error truncating nums file for resume\n");
+            return 1;
+        }
+        // binary modes start with a self describing header (a resumed file
+        // already has one, and the fresh delta context forces the first
+        // record after a resume to be a full record)
+        if (_g_nums_format != NUMS_TEXT && !_g_resume_filename)
+        {
+            uint64_t magic = NUMS_MAGIC;
+            uint32_t head[4];
+            head[0] = strcmp(_g_prime_type,"lar") == 0 ? 3
+                    : strcmp(_g_prime_type,"lor") == 0 ? 2
+                    : strcmp(_g_prime_type,"l") == 0 ? 1 : 0;
+            head[1] = _g_base;
+            head[2] = _g_minlength;
+            head[3] = 0;
+            fwrite(&magic,sizeof(magic),1,_g_num_file);
+            fwrite(head,sizeof(*head),4,_g_num_file);
+        }
     }
-    init_globals();
-    if (strcmp(_g_prime_type,"r") == 0)
-        primes_r_init();
-    else if (strcmp(_g_prime_type,"l") == 0)
-        primes_l_init();
-    else if (strcmp(_g_prime_type,"lor") == 0)
-        primes_lor_init();
-    else if (strcmp(_g_prime_type,"lar") == 0)
-        primes_lar_init();
+    if (_g_threads > 1)
+        run_threaded();
     else
-        fprintf(stderr,"invalid prime type: %s\n",_g_prime_type);
+        run_tree();
     // flush buffer and exit
+#ifdef WRITE_TREE
+    if (_g_packed)
+    {
+        packed_flush(); // final partial block
+        free(_g_pk_values);
+        free(_g_pk_path);
+        free(_g_pk_hpath);
+    }
+#endif
     write_buffer();
     if (_g_num_file)
         fclose(_g_num_file);
     mpz_clear(_g_root);
     clear_globals();
+    free(_g_upowers);
     return 0;
 }
@@ -65,38 +65,40 @@ char *arg_output;
 mpz_t arg_root;
 bool stats_output;
 uint32_t (*TP_next)(TP_STATE*,char*,TP_VALUE*);
+uint32_t (*TP_next_batch)(TP_STATE*,char*,uint32_t*,TP_VALUE*,uint32_t);
+
+// nodes extracted per generator call on the tree output path
+#define TP_BATCH 4096
 
 // global variables for stats
-// index with length, then number of children
-mpz_t **s_min, **s_max;
-uint64_t **s_count;
-uint32_t s_length, s_maxchildren;
+// flat arrays indexed with length then number of children (length major) so
+// each table is one contiguous block instead of a row of mallocs per length
+mpz_t *s_min, *s_max;
+uint64_t *s_count;
+uint32_t s_length, s_capacity, s_maxchildren;
+#define STATS_CELL(l,c) ((uint64_t)(l)*s_maxchildren+(c))
 
 void resize_stats(uint32_t length)
 {
     assert(length > s_length);
-    if (s_length == 0)
-    {
-        s_min = malloc(length*sizeof(*s_min));
-        s_max = malloc(length*sizeof(*s_max));
-        s_count = malloc(length*sizeof(*s_count));
-    }
-    else
+    if (length > s_capacity)
     {
-        s_min = realloc(s_min,length*sizeof(*s_min));
-        s_max = realloc(s_max,length*sizeof(*s_max));
-        s_count = realloc(s_count,length*sizeof(*s_count));
+        // grow capacity geometrically, realloc copies the whole flat tables
+        uint32_t cap = 2*s_capacity > length ? 2*s_capacity : length;
+        s_min = realloc(s_min,STATS_CELL(cap,0)*sizeof(*s_min));
+        s_max = realloc(s_max,STATS_CELL(cap,0)*sizeof(*s_max));
+        s_count = realloc(s_count,STATS_CELL(cap,0)*sizeof(*s_count));
+        s_capacity = cap;
     }
     while (s_length < length)
     {
-        s_min[s_length] = malloc(s_maxchildren*sizeof(**s_min));
-        s_max[s_length] = malloc(s_maxchildren*sizeof(**s_max));
+        memset(s_count+STATS_CELL(s_length,0),0,
+            s_maxchildren*sizeof(*s_count));
         for (uint32_t i = 0; i < s_maxchildren; ++i)
         {
-            mpz_init(s_min[s_length][i]);
-            mpz_init(s_max[s_length][i]);
+            mpz_init(s_min[STATS_CELL(s_length,i)]);
+            mpz_init(s_max[STATS_CELL(s_length,i)]);
         }
-        s_count[s_length] = calloc(s_maxchildren,sizeof(**s_count));
         ++s_length;
     }
 }
@@ -106,20 +108,19 @@ void clear_stats()
     if (!s_length)
         return;
     for (uint32_t i = 0; i < s_length; ++i)
-    {
         for (uint32_t j = 0; j < s_maxchildren; ++j)
         {
-            mpz_clear(s_min[i][j]);
-            mpz_clear(s_max[i][j]);
+            mpz_clear(s_min[STATS_CELL(i,j)]);
+            mpz_clear(s_max[STATS_CELL(i,j)]);
         }
-        free(s_min[i]);
-        free(s_max[i]);
-        free(s_count[i]);
-    }
     free(s_min);
     free(s_max);
     free(s_count);
+    s_min = NULL;
+    s_max = NULL;
+    s_count = NULL;
     s_length = 0;
+    s_capacity = 0;
 }
 
 // for bytes output, writes the tree for the given root
@@ -128,13 +129,14 @@ void process_root(const mpz_t root, const char *rootbytes)
 {
     TP_STATE state;
     TP_VALUE value;
-    char bytes[2];
+    char bytes[2*TP_BATCH];
+    uint32_t lens[TP_BATCH];
     uint32_t ret;
     TP_init(&state,arg_base,root,arg_maxlength,rootbytes,
         stats_output ? TP_POST_ORDER : TP_BYTES_ONLY);
-    while ((ret = TP_next(&state,bytes,&value)))
+    if (stats_output)
     {
-        if (stats_output)
+        while ((ret = TP_next(&state,bytes,&value)))
         {
             if (value.len)
             {
@@ -144,9 +146,11 @@ void process_root(const mpz_t root, const char *rootbytes)
             fprintf(stderr,"stats not implemented\n");
             exit(1);
         }
-        else
-            write_bytes(bytes,ret);
     }
+    else // batch extraction keeps the generator in its tight loop
+        while ((ret = TP_next_batch(&state,bytes,lens,NULL,TP_BATCH)))
+            for (uint32_t k = 0; k < ret; ++k)
+                write_bytes(bytes+2*k,lens[k]);
     TP_clear(&state);
 }
 
@@ -212,15 +216,15 @@ int main(int argc, char **argv)
         fprintf(stderr,"must specify output type\n");
         return 0;
     }
-    // set function to use
+    // set functions to use
     if (!strcmp(arg_primetype,"r"))
-        TP_next = TP_next_r;
+        TP_next = TP_next_r, TP_next_batch = TP_next_batch_r;
     else if (!strcmp(arg_primetype,"l"))
-        TP_next = TP_next_l;
+        TP_next = TP_next_l, TP_next_batch = TP_next_batch_l;
     else if (!strcmp(arg_primetype,"lor"))
-        TP_next = TP_next_lor;
+        TP_next = TP_next_lor, TP_next_batch = TP_next_batch_lor;
     else if (!strcmp(arg_primetype,"lar"))
-        TP_next = TP_next_lar;
+        TP_next = TP_next_lar, TP_next_batch = TP_next_batch_lar;
     else
     {
         fprintf(stderr,"invalid prime type %s\n",arg_primetype);
@@ -75,7 +75,7 @@ cat ./$DIR/job_roots.txt \
         --joblog ./$DIR/jobs.log \
         --resume-failed \
         --bar \
-        ./tp_tree -p $PRIME_TYPE -b $BASE -r {} '>' ./$DIR/root_{}.bin \
+        ./tp_tree -p $PRIME_TYPE -b $BASE -a ./$DIR/prime.cache -r {} '>' ./$DIR/root_{}.bin \
     >> ./$DIR/parallel.stdout
 #        ./truncprimes -p $PRIME_TYPE -b $BASE -r {} '|' xz '>' ./$DIR/root_{}.bin.xz \
 